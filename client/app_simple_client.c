@@ -35,10 +35,10 @@
 #define WAITTIME 5
 
 
-//这个函数通过在客户和服务器之间创建TCP连接来启动重叠网络层. 它返回TCP套接字描述符, STCP将使用该描述符发送段. 如果TCP连接失败, 返回-1.
+//这个函数等待本地SIP进程的路由收敛并连接到它的端口SIP_PORT. 超过SIP_READY_TIMEOUT秒没有就绪时返回-1. 连接成功, 返回TCP套接字描述符, STCP将使用该描述符发送段.
 int connectToSIP()
 {
-	return tcp_client_conn_a("127.0.0.1", SIP_PORT);
+	return sip_waitready(SIP_READY_TIMEOUT);
 }
 
 //这个函数断开到本地SIP进程的TCP连接. 
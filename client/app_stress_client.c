@@ -33,10 +33,10 @@
 //在发送文件后, 等待5秒, 然后关闭连接.
 #define WAITTIME 30
 
-//这个函数连接到本地SIP进程的端口SIP_PORT. 如果TCP连接失败, 返回-1. 连接成功, 返回TCP套接字描述符, STCP将使用该描述符发送段.
+//这个函数等待本地SIP进程的路由收敛并连接到它的端口SIP_PORT. 超过SIP_READY_TIMEOUT秒没有就绪时返回-1. 连接成功, 返回TCP套接字描述符, STCP将使用该描述符发送段.
 int connectToSIP() 
 {
-	return tcp_client_conn_a("127.0.0.1", SIP_PORT);
+	return sip_waitready(SIP_READY_TIMEOUT);
 }
 
 //这个函数断开到本地SIP进程的TCP连接. 
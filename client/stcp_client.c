@@ -22,6 +22,15 @@ int sip_conn;										// SIP进程的TCP连接
 pthread_mutex_t tcbTable_mutex;
 
 
+// 当前时间, 单位为微秒
+static unsigned long long now_usec()
+{
+	struct timeval currentTime;
+	gettimeofday(&currentTime, NULL);
+	return currentTime.tv_sec * 1000000ULL + currentTime.tv_usec;
+}
+
+
 client_tcb_t* getTcb(int sockfd) 
 {
 	if (tcbTable[sockfd] != NULL)
@@ -84,6 +93,8 @@ int stcp_client_sock(unsigned int client_port)
 	int sockfd = newTcb(client_port);
 	if (sockfd < 0)
 		return -1;
+	// 在SIP进程注册端口, 同一个节点上可以有多个STCP进程
+	sip_bindport(sip_conn, client_port, 1);
 
 	client_tcb_t* tcb = getTcb(sockfd);
 
@@ -97,6 +108,7 @@ int stcp_client_sock(unsigned int client_port)
 	tcb->sendBufunSent = NULL;
 	tcb->sendBufTail = NULL;
 	tcb->unAck_segNum = 0;
+	tcb->busyUntil = 0;
 	// 为发送缓冲区创建互斥量
 	pthread_mutex_t* sendBuf_mutex;
 	sendBuf_mutex = (pthread_mutex_t*) malloc(sizeof(pthread_mutex_t));
@@ -116,6 +128,11 @@ int stcp_client_connect(int sockfd, int nodeID, unsigned int server_port)
 	client_tcb_t* clientTcb = getTcb(sockfd);
 	if (!clientTcb)
 		return -1;
+	// STCP连接只是单播的, 发往组播组使用stcp_client_sendgroup()
+	if (nodeID >= MCAST_BASE && nodeID < MCAST_BASE + MCAST_MAX_GROUPS) {
+		printf("CLIENT: CAN'T CONNECT TO GROUP ADDRESS %d\n", nodeID);
+		return -1;
+	}
 
 	switch (clientTcb->state) {
 		case CLOSED:
@@ -214,6 +231,29 @@ int stcp_client_send(int sockfd, void* data, unsigned int length)
 }
 
 
+// 向组播组发送数据
+//
+// 组播是不可靠的数据报服务, 不需要连接: 数据作为一个MDATA段发往组地址, 由SIP进程复制给组的所有其他成员,
+// 段的源端口是这个套接字的端口. 不确认也不重传.
+//
+int stcp_client_sendgroup(int sockfd, int group, unsigned int server_port, void* data, unsigned int length)
+{
+	// 通过sockfd获得tcb
+	client_tcb_t* clientTcb = getTcb(sockfd);
+	if (!clientTcb || group < 0 || group >= MCAST_MAX_GROUPS || length > MCAST_MAX_DATA)
+		return -1;
+
+	seg_t seg;
+	bzero(&seg, sizeof(seg));
+	seg.header.type = MDATA;
+	seg.header.src_port = clientTcb->client_portNum;
+	seg.header.dest_port = server_port;
+	seg.header.length = length;
+	memcpy(seg.data, data, length);
+	return sip_sendseg(sip_conn, MCAST_BASE + group, &seg) < 0 ? -1 : 1;
+}
+
+
 int stcp_client_disconnect(int sockfd) 
 {
 	// 通过sockfd获得tcb
@@ -283,6 +323,7 @@ int stcp_client_close(int sockfd)
 	
 	switch (clientTcb->state) {
 		case CLOSED:
+			sip_bindport(sip_conn, clientTcb->client_portNum, 0);
 			free(clientTcb->bufMutex);
 			free(tcbTable[sockfd]);
 			tcbTable[sockfd] = NULL;
@@ -342,6 +383,12 @@ void *seghandler(void* arg)
 					sendBuf_recvAck(clientTcb, segBuf.header.ack_num);
 					// 发送在发送缓冲区中的新段
 					sendBuf_send(clientTcb);
+				} else if (segBuf.header.type == BUSY 
+						&& segBuf.header.src_port == clientTcb->server_portNum
+						&& clientTcb->server_nodeID == src_nodeID) {
+					// 下一跳拥塞, 被丢弃的段由超时重传, 在此之前暂停发送
+					clientTcb->busyUntil = now_usec() + BUSY_BACKOFF / 1000;
+					printf("CLIENT: NEXT HOP IS BUSY (SEQ: %d), BACK OFF\n", segBuf.header.ack_num);
 				}
 				else
 					printf("CLIENT: IN CONNECTED, NO DATAACK SEG RECEIVED\n");
@@ -375,6 +422,10 @@ void* sendBuf_timer(void* clienttcb)
 		if (clientTcb->unAck_segNum == 0) {
 			pthread_exit(NULL);
 		}
+		else if (clientTcb->busyUntil > now_usec()) {
+			// 下一跳拥塞, 暂不重传
+			continue;
+		}
 		else if (clientTcb->sendBufHead->sentTime > 0 && clientTcb->sendBufHead->sentTime < currentTime.tv_sec * 1e6 + currentTime.tv_usec - DATA_TIMEOUT) {
 			sendBuf_timeout(clientTcb);
 		}
@@ -410,6 +461,11 @@ void sendBuf_send(client_tcb_t* clientTcb)
 {
 	pthread_mutex_lock(clientTcb->bufMutex);
 
+	// 下一跳拥塞时不发送新段
+	if (clientTcb->busyUntil > now_usec()) {
+		pthread_mutex_unlock(clientTcb->bufMutex);
+		return;
+	}
 	while (clientTcb->unAck_segNum < GBN_WINDOW && clientTcb->sendBufunSent != NULL) {
 		sip_sendseg(sip_conn, clientTcb->server_nodeID, (seg_t*)clientTcb->sendBufunSent);
 		struct timeval currentTime;
@@ -37,6 +37,7 @@ typedef struct client_tcb {
 	segBuf_t* sendBufunSent;        	//发送缓冲区中的第一个未发送段
 	segBuf_t* sendBufTail;          	//发送缓冲区尾
 	unsigned int unAck_segNum;      	//已发送但未收到确认段的数量
+	unsigned long long busyUntil;   	//收到SIP进程的BUSY段后, 在这个时间(微秒)之前不发送和重传段
 } client_tcb_t;
 
 
@@ -94,6 +95,24 @@ int stcp_client_connect(int sockfd, int nodeID, unsigned int server_port);
  */
 int stcp_client_send(int sockfd, void* data, unsigned int length);
 
+
+/**
+ * @brief 	客户端STCP层的组播发送函数
+ * @details	这个函数把length字节的数据作为一个MDATA段发往组播组group中所有其他成员的端口server_port. 
+ * 			组播是不可靠的数据报服务: 不需要先连接, 套接字可以处于任何状态, 段的源端口是套接字的端口,
+ * 			数据不确认也不重传, 每次调用的数据在接收方是一个独立的数据报. length不能超过MCAST_MAX_DATA.
+ * 			STCP连接只是单播的, 不能用stcp_client_connect()连接组地址.
+ * 			段交给本地SIP进程后返回1, 否则返回-1.
+ * 
+ * @param sockfd 
+ * @param group 
+ * @param server_port 
+ * @param data 
+ * @param length 
+ * @return int 
+ */
+int stcp_client_sendgroup(int sockfd, int group, unsigned int server_port, void* data, unsigned int length);
+
 /**
  * @brief 	客户端STCP层的disconnect函数
  * @details	这个函数用于断开到服务器的连接. 它以套接字ID作为输入参数. 套接字ID用于找到TCB表中的条目.
@@ -164,6 +183,7 @@ void sendBuf_timeout(client_tcb_t* clientTcb);
 
 /**
  * @brief 从第一个未被发送的段开始发送，直到已发送但未被确认的段数量到达 GBN_WINDOW 或是缓冲区未发送段全部发送为止
+ * 		  如果最近收到了BUSY段, 在BUSY_BACKOFF时间内不发送
  * 
  * @param clientTcb 
  */
@@ -12,8 +12,10 @@
 /* STCP参数 */
 //这是STCP可以支持的最大连接数. 你的TCB表应包含MAX_TRANSPORT_CONNECTIONS个条目.
 #define MAX_TRANSPORT_CONNECTIONS 10
-//最大段长度: 1500 - sizeof(seg header) - sizeof(ip header)
-#define MAX_SEG_LEN  1464
+//端口号的范围是0到STCP_MAX_PORT-1
+#define STCP_MAX_PORT 65536
+//最大段长度: MAX_PKT_LEN - sizeof(seg header)
+#define MAX_SEG_LEN  1432
 // #define MAX_SEG_LEN 50
 //数据包丢失率为10%
 #define PKT_LOSS_RATE 0.1
@@ -37,6 +39,8 @@
 #define RECEIVE_BUF_SIZE 1000000
 //数据段超时值, 单位为纳秒
 #define DATA_TIMEOUT 500000
+//收到SIP进程的BUSY段后暂停发送新段的时间, 单位为纳秒
+#define BUSY_BACKOFF 50000000
 //GBN窗口大小
 #define GBN_WINDOW 10
 
@@ -46,22 +50,118 @@
 #define CONNECTION_PORT 6000
 //这个端口号由SON进程打开, 并由SIP进程连接
 #define SON_PORT 6500
-//最大SIP报文数据长度: 1500 - sizeof(sip header)
-#define MAX_PKT_LEN 1488 
+//最大SIP报文数据长度: SON_UDP_MTU - IP和UDP首部(28字节) - 报文帧开销(PKT_FRAME_OVERHEAD, 16字节),
+//这样UDP链路上最大的报文帧也放得进一个不分片的IP数据报
+#define MAX_PKT_LEN 1456
+//邻居链路出口合并小帧的时间预算, 单位为微秒. 缓冲区中第一个帧最多等待这么久就被发送, 为0时不合并
+#define SON_COALESCE_USEC 200
+//长度超过这个值的帧不再等待合并, 连同缓冲区中已有的帧立即发送
+#define SON_COALESCE_MAXFRAME 256
+//每个邻居的出口合并缓冲区大小, 应能容纳SON_LINK_CREDITS个最大长度的报文帧
+#define SON_EGRESS_BUF_SIZE 65536
+//SON进程给SIP进程的每个下一跳的信用数, 即SIP进程最多可以有这么多个发往该下一跳的报文未被SON进程写出
+#define SON_LINK_CREDITS 32
+//SON进程和SIP进程之间每个方向的报文帧队列中最多的帧数. 读者跟不上时, 队列达到上限后新的数据报文被丢弃并计数,
+//控制报文(信用, 链路断开和路由报文)总是入队
+#define PKTQUEUE_MAX_FRAMES 1024
+//为1时本节点在邻居连接建立时提议使用LZ4压缩链路上的报文数据, 只有链路两端都提议时才压缩
+#define SON_COMPRESS 1
+//只压缩数据长度不小于这个值的报文
+#define SON_COMPRESS_THRESHOLD 256
+//邻居连接建立时等待压缩协商消息的时间, 单位为秒
+#define SON_HELLO_TIMEOUT 5
+//SON进程每隔这么多毫秒在空闲的邻居链路上发送一个HELLO报文
+#define SON_KEEPALIVE_INTERVAL 1000
+//邻居在这么多毫秒内没有发来任何帧(报文或HELLO)时, 认为它已经失效, 关闭链路并通知SIP进程
+#define SON_DEAD_INTERVAL 4000
+//为1时邻居链路使用UDP而不是TCP, 由STCP负责可靠传输. 可以用SON进程的命令行参数tcp/udp覆盖
+#define SON_LINK_UDP 0
+//TCP链路上数据长度不小于这个值的未压缩报文用splice()直接从邻居连接转发给SIP进程, 不复制到用户空间. 为0时不使用splice()
+#define SON_SPLICE_MIN 512
+//每个TCP邻居链路的splice管道数, 管道都在等待SIP连接的写线程时, 报文数据被复制到用户空间
+#define SON_SPLICE_PIPES 4
+//UDP链路的MTU, 一个报文帧作为一个数据报加上IP和UDP首部后不超过它
+#define SON_UDP_MTU 1500
+//IP和UDP首部的长度
+#define SON_UDP_HDR_LEN 28
+//UDP链路上sendmmsg()/recvmmsg()一次最多发送/接收的数据报数
+#define SON_UDP_BATCH 32
+//UDP链路套接字的接收缓冲区大小
+#define SON_UDP_RCVBUF 1048576
 
 
 /* SIP参数 */
-//重叠网络支持的最大节点数  
-#define MAX_NODE_NUM 5
-//最大路由表槽数 
+//最小路由表槽数, 节点多时路由表的槽数随节点数增长
 #define MAX_ROUTINGTABLE_SLOTS 10
+//到一个目的节点最多使用的等价路径数
+#define MAX_ECMP_PATHS 8
 //无穷大的链路代价值, 如果两个节点断开连接了, 它们之间的链路代价值就是INFINITE_COST
 #define INFINITE_COST 999
 //SIP进程打开这个端口并等待来自STCP进程的连接
 #define SIP_PORT 6600
 //这是广播节点ID. 
 #define BROADCAST_NODEID 9999
-//路由更新广播间隔, 以秒为单位
-#define ROUTEUPDATE_INTERVAL 300
+//组播组地址: 目的节点ID为MCAST_BASE+g的段发往组播组g
+#define MCAST_BASE 10000
+//组播组数, 组号从0到MCAST_MAX_GROUPS-1
+#define MCAST_MAX_GROUPS 64
+//组播数据段的最大数据长度. 组播报文中段之前还有组号和成员位图, 这个长度给位图留出(MAX_SEG_LEN - MCAST_MAX_DATA - 4) * 8个节点的空间
+#define MCAST_MAX_DATA 1024
+//每个服务器套接字缓存的组播数据的字节数, 应用程序来不及读取时新到达的组播数据被丢弃
+#define MCAST_RECVBUF_SIZE 65536
+//SIP数据报文的初始跳数限制, 路由收敛期间的暂时环路中的报文最多被转发这么多次
+#define SIP_TTL 32
+//没有触发更新时的路由更新广播间隔, 以秒为单位
+#define ROUTEUPDATE_INTERVAL 30
+//超过这个时间(秒)没有收到邻居的路由更新, 经过它的路由失效. 应是ROUTEUPDATE_INTERVAL的数倍, 以容忍丢失的路由更新
+#define ROUTE_TIMEOUT 90
+//为1时距离矢量路由使用毒性逆转: 经过一个邻居的路由以INFINITE_COST通告给这个邻居
+#define SIP_POISON_REVERSE 1
+//路由更新抑制计时器: 两次路由更新广播之间的最小间隔, 以毫秒为单位
+#define ROUTEUPDATE_HOLDDOWN 200
+//没有确认的路由更新的初始重传间隔(毫秒), 每次重传后加倍, 最多ROUTEUPDATE_INTERVAL秒
+#define ROUTEUPDATE_RETRANSMIT 1000
+//控制线程合并这段时间(毫秒)内到达的路由报文, 一起重新计算路由
+#define SIP_CONTROL_WINDOW 20
+//控制报文队列中最多的报文数, 队列满时到达的路由报文被丢弃
+#define SIP_CONTROL_QUEUE 4096
+//SIP进程的转发线程数, 可以用命令行参数workers=N覆盖, 最多SIP_MAX_WORKERS个
+#define SIP_WORKERS 2
+#define SIP_MAX_WORKERS 32
+//每个转发线程的报文环形缓冲区大小, 必须是2的幂
+#define SIP_WORKER_QUEUE 256
+//一个SIP进程同时接受的最多STCP进程数
+#define SIP_MAX_APPS 16
+//SIP进程为每个STCP进程缓存的还没有写出的段数. STCP进程读得太慢, 缓存满时发给它的段被丢弃并计数, 转发线程不会被阻塞
+#define SIP_APP_QUEUE 64
+//到所有节点都有路由, 并且路由在这段时间(毫秒)内没有改变时, 认为路由收敛了, SIP进程开始接受STCP进程的连接
+#define SIP_STABLE_WINDOW 200
+//STCP进程最多等待这段时间(秒)让本地SIP进程就绪, 每SIP_READY_POLL毫秒尝试连接一次
+#define SIP_READY_TIMEOUT 60
+#define SIP_READY_POLL 50
+//还没有路由的报文暂存在SIP进程中, 路由出现后继续转发. 每个目的节点最多暂存SIP_HOLD_PKTS个报文, 每个报文最多暂存SIP_HOLD_TIME毫秒
+#define SIP_HOLD_PKTS 16
+#define SIP_HOLD_TIME 1000
+//SIP进程周期性地把路由保存到这个快照文件(相对于sip进程的工作目录), 重启时从快照热启动
+#define SIP_SNAPSHOT_FILE "sip.snapshot"
+//路由改变后最多经过这么多秒保存一次快照
+#define SIP_SNAPSHOT_INTERVAL 10
+//超过这个时间(秒)的快照不再加载: 其中的路由即使没有重启也已经超时了
+#define SIP_SNAPSHOT_MAXAGE ROUTE_TIMEOUT
+//SIP使用的路由协议: 0为距离矢量, 1为链路状态. sip进程的命令行参数dv/ls可以覆盖这个值
+#define SIP_LINKSTATE 0
+
+
+/* io_uring参数 */
+//为1时SON进程和SIP进程用io_uring接收报文, 内核不支持时退回到阻塞接收. 可以用命令行参数uring/threads覆盖
+#define IO_URING 0
+//io_uring报文缓冲池中的缓冲区个数, 必须是2的幂
+#define URING_BUFS 256
+//报文缓冲池中每个缓冲区的字节数, 应能容纳一个最大长度的报文帧
+#define URING_BUF_SIZE 2048
+//一次从io_uring收取的最多完成事件数
+#define URING_BATCH 64
+//io_uring提交队列的条目数
+#define URING_ENTRIES 64
 
 #endif
\ No newline at end of file
@@ -0,0 +1,183 @@
+/**
+ * @file    common/lz4.c
+ * @brief   这个文件实现LZ4块格式的压缩和解压缩函数
+ * @date    2023-03-04
+ */
+
+
+#include <string.h>
+#include "lz4.h"
+
+//最短匹配长度
+#define LZ4_MINMATCH 4
+//哈希表大小为 1 << LZ4_HASHLOG
+#define LZ4_HASHLOG 12
+//块的最后LZ4_LASTLITERALS字节必须是字面量
+#define LZ4_LASTLITERALS 5
+//最后一个匹配必须在块结束前LZ4_MFLIMIT字节之前开始
+#define LZ4_MFLIMIT 12
+//匹配偏移量的最大值
+#define LZ4_MAXOFFSET 65535
+
+
+static unsigned int lz4_read32(const unsigned char* p)
+{
+	unsigned int v;
+	memcpy(&v, p, 4);
+	return v;
+}
+
+static unsigned int lz4_hash(unsigned int v)
+{
+	return (v * 2654435761U) >> (32 - LZ4_HASHLOG);
+}
+
+// 写出长度字段中超过15的部分, 每个字节表示最多255
+static unsigned char* lz4_writelen(unsigned char* op, int len)
+{
+	while (len >= 255) {
+		*op++ = 255;
+		len -= 255;
+	}
+	*op++ = (unsigned char)len;
+	return op;
+}
+
+
+int lz4_compress(const char* src, int srcLen, char* dst, int dstCap)
+{
+	const unsigned char* base = (const unsigned char*)src;
+	const unsigned char* ip = base;
+	const unsigned char* anchor = base;
+	const unsigned char* iend = base + srcLen;
+	const unsigned char* mflimit = iend - LZ4_MFLIMIT;
+	const unsigned char* matchlimit = iend - LZ4_LASTLITERALS;
+	unsigned char* op = (unsigned char*)dst;
+	unsigned char* oend = op + dstCap;
+	int table[1 << LZ4_HASHLOG];
+
+	if (srcLen < 0 || srcLen > LZ4_MAXOFFSET)
+		return 0;
+	memset(table, -1, sizeof(table));
+
+	while (srcLen >= LZ4_MFLIMIT && ip < mflimit) {
+		unsigned int h = lz4_hash(lz4_read32(ip));
+		int ref = table[h];
+		table[h] = ip - base;
+		if (ref < 0 || ip - (base + ref) > LZ4_MAXOFFSET || lz4_read32(base + ref) != lz4_read32(ip)) {
+			ip++;
+			continue;
+		}
+
+		// 向前扩展匹配
+		const unsigned char* match = base + ref;
+		while (ip > anchor && match > base && ip[-1] == match[-1]) {
+			ip--;
+			match--;
+		}
+		// 向后扩展匹配
+		const unsigned char* p = ip + LZ4_MINMATCH;
+		const unsigned char* m = match + LZ4_MINMATCH;
+		while (p < matchlimit && *p == *m) {
+			p++;
+			m++;
+		}
+
+		int litLen = ip - anchor;
+		int matchLen = p - ip - LZ4_MINMATCH;
+		if (op + 1 + litLen + litLen / 255 + 1 + 2 + matchLen / 255 + 1 + LZ4_LASTLITERALS + 1 > oend)
+			return 0;
+
+		// 一个序列: 标记字节, 字面量, 偏移量, 匹配长度
+		unsigned char* token = op++;
+		if (litLen >= 15) {
+			*token = 15 << 4;
+			op = lz4_writelen(op, litLen - 15);
+		} else {
+			*token = litLen << 4;
+		}
+		memcpy(op, anchor, litLen);
+		op += litLen;
+		unsigned int offset = ip - match;
+		*op++ = offset & 0xff;
+		*op++ = offset >> 8;
+		if (matchLen >= 15) {
+			*token |= 15;
+			op = lz4_writelen(op, matchLen - 15);
+		} else {
+			*token |= matchLen;
+		}
+		ip = p;
+		anchor = ip;
+	}
+
+	// 最后的字面量
+	int litLen = iend - anchor;
+	if (op + 1 + litLen + litLen / 255 + 1 > oend)
+		return 0;
+	if (litLen >= 15) {
+		*op++ = 15 << 4;
+		op = lz4_writelen(op, litLen - 15);
+	} else {
+		*op++ = litLen << 4;
+	}
+	memcpy(op, anchor, litLen);
+	op += litLen;
+	return op - (unsigned char*)dst;
+}
+
+
+int lz4_decompress(const char* src, int srcLen, char* dst, int dstCap)
+{
+	const unsigned char* ip = (const unsigned char*)src;
+	const unsigned char* iend = ip + srcLen;
+	unsigned char* op = (unsigned char*)dst;
+	unsigned char* oend = op + dstCap;
+
+	while (ip < iend) {
+		unsigned int token = *ip++;
+		unsigned int b;
+
+		int litLen = token >> 4;
+		if (litLen == 15) {
+			do {
+				if (ip >= iend)
+					return -1;
+				b = *ip++;
+				litLen += b;
+			} while (b == 255);
+		}
+		if (litLen > iend - ip || litLen > oend - op)
+			return -1;
+		memcpy(op, ip, litLen);
+		op += litLen;
+		ip += litLen;
+		// 最后一个序列只有字面量
+		if (ip >= iend)
+			break;
+
+		if (iend - ip < 2)
+			return -1;
+		int offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		if (offset == 0 || offset > op - (unsigned char*)dst)
+			return -1;
+		int matchLen = token & 15;
+		if (matchLen == 15) {
+			do {
+				if (ip >= iend)
+					return -1;
+				b = *ip++;
+				matchLen += b;
+			} while (b == 255);
+		}
+		matchLen += LZ4_MINMATCH;
+		if (matchLen > oend - op)
+			return -1;
+		// 匹配可能与输出重叠, 逐字节复制
+		const unsigned char* match = op - offset;
+		while (matchLen--)
+			*op++ = *match++;
+	}
+	return op - (unsigned char*)dst;
+}
@@ -0,0 +1,38 @@
+/**
+ * @file    common/lz4.h
+ * @brief   这个文件声明LZ4块格式的压缩和解压缩函数
+ * @date    2023-03-04
+ */
+
+
+#ifndef LZ4_H
+#define LZ4_H
+
+
+/**
+ * @brief   这个函数将src中的srcLen字节按LZ4块格式压缩到dst中.
+ *          srcLen不能超过65535字节.
+ *          返回压缩后的字节数. 如果压缩结果放不进dstCap字节, 返回0.
+ * 
+ * @param src 
+ * @param srcLen 
+ * @param dst 
+ * @param dstCap 
+ * @return int 
+ */
+int lz4_compress(const char* src, int srcLen, char* dst, int dstCap);
+
+
+/**
+ * @brief   这个函数将src中srcLen字节的LZ4块解压缩到dst中.
+ *          返回解压缩后的字节数. 如果数据损坏或解压结果超过dstCap字节, 返回-1.
+ * 
+ * @param src 
+ * @param srcLen 
+ * @param dst 
+ * @param dstCap 
+ * @return int 
+ */
+int lz4_decompress(const char* src, int srcLen, char* dst, int dstCap);
+
+#endif
@@ -5,38 +5,188 @@
  */
 
 
+#define _GNU_SOURCE
 #include "pkt.h"
 #include <stdio.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <sys/socket.h>
 #include <string.h>
 
 const char* BEGIN_FLAG = "!&";
 const char* END_FLAG = "!#";
-const char* PKT_TYPE[3] = {"", "ROUTE_UPDATE", "SIP"};
+const char* PKT_TYPE[10] = {"", "ROUTE_UPDATE", "SIP", "CREDIT", "LSA", "ROUTE_ACK", "LINK_DOWN", "GROUP_REPORT", "MCAST", "HELLO"};
 
-// son_sendpkt()由SIP进程调用, 其作用是要求SON进程将报文发送到重叠网络中. 
-// SON进程和SIP进程通过一个本地TCP连接互连.
-int son_sendpkt(int nextNodeID, sip_pkt_t* pkt, int son_conn)
+
+// 返回报文类型的名称, 忽略链路上使用的标志位
+static const char* pkttype(sip_pkt_t* pkt)
+{
+	unsigned int type = pkt->header.type & ~PKT_COMPRESSED;
+	return type < sizeof(PKT_TYPE) / sizeof(PKT_TYPE[0]) ? PKT_TYPE[type] : "UNKNOWN";
+}
+
+
+// 从conn中接收len字节, 直到接收完或者连接出错
+static int recvn(int conn, void* buf, int len)
+{
+	int n, got = 0;
+	while (got < len) {
+		if ((n = recv(conn, (char*)buf + got, len - got, 0)) <= 0)
+			return n;
+		got += n;
+	}
+	return got;
+}
+
+// 从conn中每次接收2字节, 直到它们是分隔符flag. 成功返回2, 连接关闭返回0, 出错返回-1
+static int recvflag(int conn, const char* flag)
+{
+	char sign[2];
+	int n;
+	while ((n = recvn(conn, sign, 2)) == 2) {
+		if (memcmp(sign, flag, 2) == 0)
+			break;
+	}
+	return n;
+}
+
+// 将buf中的len字节全部发送到conn
+static int sendn(int conn, const void* buf, int len)
 {
-	if (send(son_conn, BEGIN_FLAG, 2, 0) <= 0) {
-        printf("SON_CONN[%d] ERROR: [SIP] CAN'T [SEND] [BEGIN]\n", son_conn);
+	int n, sent = 0;
+	while (sent < len) {
+		if ((n = send(conn, (const char*)buf + sent, len - sent, 0)) <= 0)
+			return n;
+		sent += n;
+	}
+	return sent;
+}
+
+// 接收报文首部和首部中length指定长度的数据
+static int recvpktbody(int conn, sip_pkt_t* pkt)
+{
+	int n;
+	if ((n = recvn(conn, &pkt->header, sizeof(sip_hdr_t))) <= 0)
+		return -1;
+	if (pkt->header.length > MAX_PKT_LEN)
+		return -1;
+	if ((n = recvn(conn, pkt->data, pkt->header.length)) < 0)
 		return -1;
+	return 1;
+}
+
+
+// 把v编码为变长整数写入p, 返回写入的字节数
+static int putvarint(unsigned char* p, unsigned int v)
+{
+	int n = 0;
+	while (v >= 0x80) {
+		p[n++] = (unsigned char)(v | 0x80);
+		v >>= 7;
+	}
+	p[n++] = (unsigned char)v;
+	return n;
+}
+
+// 从p开始的最多len字节中解码一个变长整数, 返回读取的字节数, 数据不完整或过长时返回-1
+static int getvarint(const unsigned char* p, int len, unsigned int* v)
+{
+	unsigned int x = 0;
+	for (int n = 0; n < len && n < 5; n++) {
+		x |= (unsigned int)(p[n] & 0x7f) << (7 * n);
+		if (!(p[n] & 0x80)) {
+			*v = x;
+			return n + 1;
+		}
+	}
+	return -1;
+}
+
+
+int pkt_rtencode(pkt_routeupdate_t* pkt_rp, routeupdate_entry_t* entries, int entryNum)
+{
+	int len = 0, n = 0;
+	unsigned int prev = 0;
+	while (n < entryNum && len + ROUTEUPDATE_MAX_ENTRY_LEN <= ROUTEUPDATE_MAX_DATA) {
+		// 节点ID之差用zigzag编码, 这样条目不按节点ID排序时也很短
+		int d = (int)(entries[n].nodeID - prev);
+		len += putvarint(pkt_rp->data + len, ((unsigned int)d << 1) ^ (unsigned int)(d >> 31));
+		len += putvarint(pkt_rp->data + len, entries[n].cost);
+		prev = entries[n++].nodeID;
 	}
-	if (send(son_conn, &nextNodeID, 4, 0) <= 0) {
-        printf("SON_CONN[%d] ERROR: [SIP] CAN'T [SEND] [NEXT NODEID]\n", son_conn);
+	pkt_rp->entryNum = n;
+	return len;
+}
+
+
+int pkt_rtdecode(pkt_routeupdate_t* pkt_rp, int length, routeupdate_entry_t* entries)
+{
+	int len = length - (int)ROUTEUPDATE_LEN(0), pos = 0, k;
+	unsigned int prev = 0, z, cost;
+	if (len < 0)
 		return -1;
+	for (int i = 0; i < pkt_rp->entryNum; i++) {
+		if ((k = getvarint(pkt_rp->data + pos, len - pos, &z)) < 0)
+			return -1;
+		pos += k;
+		if ((k = getvarint(pkt_rp->data + pos, len - pos, &cost)) < 0)
+			return -1;
+		pos += k;
+		prev += (z >> 1) ^ -(z & 1);
+		entries[i].nodeID = prev;
+		entries[i].cost = cost;
 	}
-	if (send(son_conn, pkt, sizeof(sip_pkt_t), 0) <= 0) {
-		printf("SON_CONN[%d] ERROR: [SIP] CAN'T [SEND] [PACKET]\n", son_conn);
+	return pkt_rp->entryNum;
+}
+
+
+const char* pkt_typename(sip_pkt_t* pkt)
+{
+	return pkttype(pkt);
+}
+
+
+int pkt_frame(sip_pkt_t* pkt, char* buf)
+{
+	if (pkt->header.length > MAX_PKT_LEN)
+		return -1;
+	int len = sizeof(sip_hdr_t) + pkt->header.length;
+	memcpy(buf, BEGIN_FLAG, 2);
+	memcpy(buf + 2, pkt, len);
+	memcpy(buf + 2 + len, END_FLAG, 2);
+	return len + 4;
+}
+
+int pkt_framenext(int nextNodeID, sip_pkt_t* pkt, char* buf)
+{
+	if (pkt->header.length > MAX_PKT_LEN)
+		return -1;
+	int len = sizeof(sip_hdr_t) + pkt->header.length;
+	memcpy(buf, BEGIN_FLAG, 2);
+	memcpy(buf + 2, &nextNodeID, 4);
+	memcpy(buf + 6, pkt, len);
+	memcpy(buf + 6 + len, END_FLAG, 2);
+	return len + 8;
+}
+
+// son_sendpkt()由SIP进程调用, 其作用是要求SON进程将报文发送到重叠网络中. 
+// SON进程和SIP进程通过一个本地TCP连接互连.
+int son_sendpkt(int nextNodeID, sip_pkt_t* pkt, int son_conn)
+{
+	// 按'!& nextNodeID 报文 !#'的顺序组帧, 一次发送
+	char buf[PKT_FRAME_OVERHEAD + 4 + MAX_PKT_LEN];
+	int len;
+	if ((len = pkt_framenext(nextNodeID, pkt, buf)) < 0) {
+		printf("SON_CONN[%d] ERROR: [SIP] INVALID [PACKET] LENGTH %d\n", son_conn, pkt->header.length);
 		return -1;
 	}
-	if (send(son_conn, END_FLAG, 2, 0) <= 0) {
-        printf("SON_CONN[%d] ERROR: [SIP] CAN'T [SEND] [END]\n", son_conn);
+	if (sendn(son_conn, buf, len) <= 0) {
+		printf("SON_CONN[%d] ERROR: [SIP] CAN'T [SEND] [PACKET]\n", son_conn);
 		return -1;
 	}
 	printf("PKT[%s] SON_CONN[%d] SEND: %d BYTES [SRC: %2d | DST: %2d]\n", 
-		PKT_TYPE[pkt->header.type], son_conn, 
+		pkttype(pkt), son_conn, 
 		pkt->header.length, pkt->header.src_nodeID, pkt->header.dest_nodeID);
 	return 1;
 }
@@ -46,13 +196,9 @@ int son_sendpkt(int nextNodeID, sip_pkt_t* pkt, int son_conn)
 int son_recvpkt(sip_pkt_t* pkt, int son_conn)
 {
 	int n;
-	char sign[3] = {0, 0, 0};
 
     // 确保以!&开始
-	while ((n = recv(son_conn, &sign, 2, 0)) == 2) {
-		if (strcmp(sign, BEGIN_FLAG) == 0) 
-			break;
-	}
+	n = recvflag(son_conn, BEGIN_FLAG);
 
 	if (n == 0)
 		return 0;
@@ -62,16 +208,13 @@ int son_recvpkt(sip_pkt_t* pkt, int son_conn)
 	}
 
     // 接收pkt
-	if ((n = recv(son_conn, pkt, sizeof(sip_pkt_t), 0)) <= 0) {
+	if (recvpktbody(son_conn, pkt) < 0) {
 		printf("SON_CONN[%d] ERROR: [SIP] CAN'T [RECV] [PACKET]\n", son_conn);
 		return -1;
 	}
 
 	// 确保以!#结尾
-	while ((n = recv(son_conn, &sign, 2, 0)) == 2) {
-		if (strcmp(sign, END_FLAG) == 0) 
-			break;
-	}
+	n = recvflag(son_conn, END_FLAG);
 
 	if (n <= 0) {
 		printf("SON_CONN[%d] ERROR: [SIP] CAN'T [RECV] [END]\n", son_conn);
@@ -79,7 +222,7 @@ int son_recvpkt(sip_pkt_t* pkt, int son_conn)
 	}
 	
     printf("PKT[%s] SON_CONN[%d] RECV: %d BYTES [SRC: %2d | DST: %2d]\n", 
-		PKT_TYPE[pkt->header.type], son_conn,
+		pkttype(pkt), son_conn,
 		pkt->header.length, pkt->header.src_nodeID, pkt->header.dest_nodeID);
     return 1;
 }
@@ -90,13 +233,9 @@ int son_recvpkt(sip_pkt_t* pkt, int son_conn)
 int getpktToSend(sip_pkt_t* pkt, int* nextNode,int sip_conn)
 {
 	int n;
-	char sign[3] = {0, 0, 0};
 
     // 确保以!&开始
-	while ((n = recv(sip_conn, &sign, 2, 0)) == 2) {
-		if (strcmp(sign, BEGIN_FLAG) == 0) 
-			break;
-	}
+	n = recvflag(sip_conn, BEGIN_FLAG);
 
 	if (n == 0)
 		return 0;
@@ -106,22 +245,19 @@ int getpktToSend(sip_pkt_t* pkt, int* nextNode,int sip_conn)
 	}
 
     // 接收nextNode
-	if ((n = recv(sip_conn, nextNode, 4, 0)) <= 0) {
+	if ((n = recvn(sip_conn, nextNode, 4)) <= 0) {
 		printf("SIP_CONN[%d] ERROR: [SON] CAN'T [RECV] [NEXT NODEID]\n", sip_conn);
 		return -1;
 	}
 
     // 接收pkt
-	if ((n = recv(sip_conn, pkt, sizeof(sip_pkt_t), 0)) <= 0) {
+	if (recvpktbody(sip_conn, pkt) < 0) {
 		printf("SIP_CONN[%d] ERROR: [SON] CAN'T [RECV] [PACKET]\n", sip_conn);
 		return -1;
 	}
 	
 	// 确保以!#结尾
-	while ((n = recv(sip_conn, &sign, 2, 0)) == 2) {
-		if (strcmp(sign, END_FLAG) == 0) 
-			break;
-	}
+	n = recvflag(sip_conn, END_FLAG);
 
 	if (n <= 0) {
 		printf("SIP_CONN[%d] ERROR: [SON] CAN'T [RECV] [END]\n", sip_conn);
@@ -129,7 +265,7 @@ int getpktToSend(sip_pkt_t* pkt, int* nextNode,int sip_conn)
 	}
 	
     printf("PKT[%s] SIP_CONN[%d] RECV: %d BYTES [SRC: %2d | DST: %2d]\n", 
-		PKT_TYPE[pkt->header.type], sip_conn,
+		pkttype(pkt), sip_conn,
 		pkt->header.length, pkt->header.src_nodeID, pkt->header.dest_nodeID);
     return 1;
 }
@@ -139,20 +275,18 @@ int getpktToSend(sip_pkt_t* pkt, int* nextNode,int sip_conn)
 // 参数sip_conn是SIP进程和SON进程之间的TCP连接的套接字描述符. 
 int forwardpktToSIP(sip_pkt_t* pkt, int sip_conn)
 {
-	if (send(sip_conn, BEGIN_FLAG, 2, 0) <= 0) {
-        printf("SIP_CONN[%d] ERROR: [SON] CAN'T [SEND] [BEGIN]\n", sip_conn);
+	char buf[PKT_FRAME_OVERHEAD + MAX_PKT_LEN];
+	int len;
+	if ((len = pkt_frame(pkt, buf)) < 0) {
+		printf("SIP_CONN[%d] ERROR: [SON] INVALID [PACKET] LENGTH %d\n", sip_conn, pkt->header.length);
 		return -1;
 	}
-	if (send(sip_conn, pkt, sizeof(sip_pkt_t), 0) <= 0) {
+	if (sendn(sip_conn, buf, len) <= 0) {
 		printf("SIP_CONN[%d] ERROR: [SON] CAN'T [SEND] [PACKET]\n", sip_conn);
 		return -1;
 	}
-	if (send(sip_conn, END_FLAG, 2, 0) <= 0) {
-        printf("SIP_CONN[%d] ERROR: [SON] CAN'T [SEND] [END]\n", sip_conn);
-		return -1;
-	}
 	printf("PKT[%s] SIP_CONN[%d] SEND: %d BYTES [SRC: %2d | DST: %2d]\n", 
-		PKT_TYPE[pkt->header.type], sip_conn,
+		pkttype(pkt), sip_conn,
 		pkt->header.length, pkt->header.src_nodeID, pkt->header.dest_nodeID);
 	return 1;
 }
@@ -161,40 +295,40 @@ int forwardpktToSIP(sip_pkt_t* pkt, int sip_conn)
 // 参数conn是到下一跳节点的TCP连接的套接字描述符.
 int sendpkt(sip_pkt_t* pkt, int conn)
 {
-	if (send(conn, BEGIN_FLAG, 2, 0) <= 0) {
-        printf("NEXT_CONN[%d] ERROR: [SON] CAN'T [SEND] [BEGIN]\n", conn);
+	char buf[PKT_FRAME_OVERHEAD + MAX_PKT_LEN];
+	int len;
+	if ((len = pkt_frame(pkt, buf)) < 0) {
+		printf("NEXT_CONN[%d] ERROR: [SON] INVALID [PACKET] LENGTH %d\n", conn, pkt->header.length);
 		return -1;
 	}
-	if (send(conn, pkt, sizeof(sip_pkt_t), 0) <= 0) {
+	if (sendn(conn, buf, len) <= 0) {
 		printf("NEXT_CONN[%d] ERROR: [SON] CAN'T [SEND] [PACKET]\n", conn);
 		return -1;
 	}
-	if (send(conn, END_FLAG, 2, 0) <= 0) {
-        printf("NEXT_CONN[%d] ERROR: [SON] CAN'T [SEND] [END]\n", conn);
-		return -1;
-	}
 	printf("PKT[%s] NEXT_CONN[%d] SEND: %d BYTES [SRC: %2d | DST: %2d]\n", 
-		PKT_TYPE[pkt->header.type], conn,
+		pkttype(pkt), conn,
 		pkt->header.length, pkt->header.src_nodeID, pkt->header.dest_nodeID);
 	return 1;
 }
 
-// recvpkt()函数由SON进程调用, 其作用是接收来自重叠网络中其邻居的报文.
-// 参数conn是到其邻居的TCP连接的套接字描述符,报文通过SON进程和其邻居之间的TCP连接发送
-int recvpkt(sip_pkt_t* pkt, int conn)
+// 将已组好帧的数据一次性发送到conn, 用于SON进程合并发送多个帧.
+int sendframes(const char* buf, int len, int conn)
+{
+	if (sendn(conn, buf, len) <= 0) {
+		printf("NEXT_CONN[%d] ERROR: [SON] CAN'T [SEND] [FRAMES]\n", conn);
+		return -1;
+	}
+	return 1;
+}
+
+// recvpkthdr()函数由SON进程调用, 接收来自邻居的报文帧的开始分隔符和报文首部.
+int recvpkthdr(sip_pkt_t* pkt, int conn)
 {
 	int n;
-	char sign[3] = {0, 0, 0};
 
     // 确保以!&开始
-	while ((n = recv(conn, &sign, 2, 0)) == 2) {
-		if (strcmp(sign, BEGIN_FLAG) == 0) 
-			break;
-	}
+	n = recvflag(conn, BEGIN_FLAG);
 
-		if (conn == 6) {
-			printf("PKT[%s], BEGIN_SIGN[%s]\n", PKT_TYPE[pkt->header.type], sign);
-		}
 	if (n == 0)
 		return 0;
 	if (n < 0) {
@@ -202,24 +336,25 @@ int recvpkt(sip_pkt_t* pkt, int conn)
 		return -1;
 	}
 
-    // 接收pkt
-	if ((n = recv(conn, pkt, sizeof(sip_pkt_t), 0)) <= 0) {
-		printf("CNEXT_CONN[%d] ERROR: [SON] CAN'T [RECV] [PACKET]\n", conn);
+	if (recvn(conn, &pkt->header, sizeof(sip_hdr_t)) <= 0 || pkt->header.length > MAX_PKT_LEN) {
+		printf("NEXT_CONN[%d] ERROR: [SON] CAN'T [RECV] [HEADER]\n", conn);
+		return -1;
+	}
+	return 1;
+}
+
+// recvpktdata()函数由SON进程调用, 在recvpkthdr()之后接收报文数据和结束分隔符.
+int recvpktdata(sip_pkt_t* pkt, int conn)
+{
+	int n;
+
+	if (recvn(conn, pkt->data, pkt->header.length) < 0) {
+		printf("NEXT_CONN[%d] ERROR: [SON] CAN'T [RECV] [PACKET]\n", conn);
 		return -1;
 	}
-		if (conn == 6) {
-			printf("PKT[%s]\n", PKT_TYPE[pkt->header.type]);
-		}
 	
 	// 确保以!#结尾
-	while ((n = recv(conn, &sign, 2, 0)) == 2) {
-		if (strcmp(sign, END_FLAG) == 0) 
-			break;
-	}
-		
-	if (conn == 6) {
-		printf("PKT[%s], END_SIGN[%s]\n", PKT_TYPE[pkt->header.type], sign);
-	}
+	n = recvflag(conn, END_FLAG);
 
 	if (n <= 0) {
 		printf("NEXT_CONN[%d] ERROR: [SON] CAN'T [RECV] [END]\n", conn);
@@ -227,7 +362,194 @@ int recvpkt(sip_pkt_t* pkt, int conn)
 	}
 	
     printf("PKT[%s] NEXT_CONN[%d] RECV: %d BYTES [SRC: %2d | DST: %2d]\n", 
-		PKT_TYPE[pkt->header.type], conn, 
+		pkttype(pkt), conn, 
 		pkt->header.length, pkt->header.src_nodeID, pkt->header.dest_nodeID);
     return 1;
-}
\ No newline at end of file
+}
+
+// recvpkt()函数由SON进程调用, 其作用是接收来自重叠网络中其邻居的报文.
+// 参数conn是到其邻居的TCP连接的套接字描述符,报文通过SON进程和其邻居之间的TCP连接发送
+int recvpkt(sip_pkt_t* pkt, int conn)
+{
+	int n;
+	if ((n = recvpkthdr(pkt, conn)) <= 0)
+		return n;
+	return recvpktdata(pkt, conn);
+}
+
+// 把conn上报文数据和结束分隔符共length+2字节移入管道pipefd, 数据不复制到用户空间.
+int splicepkt(sip_pkt_t* pkt, int conn, int pipefd[2])
+{
+	int n, len = pkt->header.length + 2, got = 0;
+	while (got < len) {
+		if ((n = splice(conn, NULL, pipefd[1], NULL, len - got, SPLICE_F_MOVE)) <= 0) {
+			if (n < 0 && errno == EINTR)
+				continue;
+			printf("NEXT_CONN[%d] ERROR: [SON] CAN'T [SPLICE] [PACKET]\n", conn);
+			return -1;
+		}
+		got += n;
+	}
+    printf("PKT[%s] NEXT_CONN[%d] SPLICE: %d BYTES [SRC: %2d | DST: %2d]\n", 
+		pkttype(pkt), conn, 
+		pkt->header.length, pkt->header.src_nodeID, pkt->header.dest_nodeID);
+	return 1;
+}
+
+// 最大的报文帧加上IP和UDP首部不能超过MTU, 否则数据报会被IP分片, 丢失任何一片都会丢失整个报文
+_Static_assert(PKT_FRAME_OVERHEAD + MAX_PKT_LEN + SON_UDP_HDR_LEN <= SON_UDP_MTU, "UDP link frames exceed SON_UDP_MTU");
+
+// UDP链路上每个数据报是一个报文帧. 这个函数把buf中已组好帧的多个报文逐个作为数据报, 
+// 每次用sendmmsg()发送最多SON_UDP_BATCH个.
+int sendframes_dgram(const char* buf, int len, int conn)
+{
+	struct mmsghdr msgs[SON_UDP_BATCH];
+	struct iovec iov[SON_UDP_BATCH];
+	int off = 0;
+	while (off < len) {
+		int n = 0;
+		for (; off < len && n < SON_UDP_BATCH; n++) {
+			sip_hdr_t hdr;
+			memcpy(&hdr, buf + off + 2, sizeof(sip_hdr_t));
+			iov[n].iov_base = (char*)buf + off;
+			iov[n].iov_len = PKT_FRAME_OVERHEAD + hdr.length;
+			memset(&msgs[n], 0, sizeof(struct mmsghdr));
+			msgs[n].msg_hdr.msg_iov = &iov[n];
+			msgs[n].msg_hdr.msg_iovlen = 1;
+			off += iov[n].iov_len;
+		}
+		int sent = 0;
+		while (sent < n) {
+			int r = sendmmsg(conn, msgs + sent, n - sent, 0);
+			if (r >= 0) {
+				sent += r;
+			} else if (errno == ECONNREFUSED || errno == ENOBUFS || errno == EAGAIN) {
+				// 对端还没有启动或发送缓冲区满, 这个数据报丢失, 由STCP重传
+				sent++;
+			} else if (errno != EINTR) {
+				printf("NEXT_CONN[%d] ERROR: [SON] CAN'T [SENDMMSG] [FRAMES]\n", conn);
+				return -1;
+			}
+		}
+	}
+	return 1;
+}
+
+// 这个函数用recvmmsg()从UDP链路接收最多max个数据报, 每个数据报是一个报文帧.
+// 不完整的帧被丢弃. 返回接收到的报文数.
+int recvpkts_dgram(sip_pkt_t* pkts, int max, int conn)
+{
+	char bufs[SON_UDP_BATCH][PKT_FRAME_OVERHEAD + MAX_PKT_LEN];
+	struct mmsghdr msgs[SON_UDP_BATCH];
+	struct iovec iov[SON_UDP_BATCH];
+	if (max > SON_UDP_BATCH)
+		max = SON_UDP_BATCH;
+	for (int i = 0; i < max; i++) {
+		iov[i].iov_base = bufs[i];
+		iov[i].iov_len = sizeof(bufs[i]);
+		memset(&msgs[i], 0, sizeof(struct mmsghdr));
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	int n = recvmmsg(conn, msgs, max, MSG_WAITFORONE, NULL);
+	if (n < 0) {
+		// 对端还没有启动时, 之前发送的数据报会引起ECONNREFUSED
+		if (errno == ECONNREFUSED || errno == EINTR)
+			return 0;
+		printf("NEXT_CONN[%d] ERROR: [SON] CAN'T [RECVMMSG] [FRAMES]\n", conn);
+		return -1;
+	}
+
+	int cnt = 0;
+	for (int i = 0; i < n; i++) {
+		int len = msgs[i].msg_len;
+		sip_pkt_t* pkt = &pkts[cnt];
+		if (len < PKT_FRAME_OVERHEAD || memcmp(bufs[i], BEGIN_FLAG, 2) != 0)
+			continue;
+		memcpy(&pkt->header, bufs[i] + 2, sizeof(sip_hdr_t));
+		if (pkt->header.length != len - PKT_FRAME_OVERHEAD || memcmp(bufs[i] + len - 2, END_FLAG, 2) != 0)
+			continue;
+		memcpy(pkt->data, bufs[i] + 2 + sizeof(sip_hdr_t), pkt->header.length);
+		printf("PKT[%s] NEXT_CONN[%d] RECV: %d BYTES [SRC: %2d | DST: %2d]\n", 
+			pkttype(pkt), conn, 
+			pkt->header.length, pkt->header.src_nodeID, pkt->header.dest_nodeID);
+		cnt++;
+	}
+	return cnt;
+}
+
+
+void pktstream_init(pktstream_t* s, int conn, const char* name)
+{
+	s->conn = conn;
+	s->name = name;
+	s->start = 0;
+	s->len = 0;
+}
+
+int pktstream_push(pktstream_t* s, const char* data, int len)
+{
+	// 把未处理的数据移到缓冲区开头
+	if (s->start > 0) {
+		memmove(s->buf, s->buf + s->start, s->len - s->start);
+		s->len -= s->start;
+		s->start = 0;
+	}
+	int n = (int)sizeof(s->buf) - s->len;
+	if (n > len)
+		n = len;
+	memcpy(s->buf + s->len, data, n);
+	s->len += n;
+	return n;
+}
+
+// 从帧流中取出下一个完整的帧. nextNode不为NULL时帧是'!& nextNodeID 报文 !#', 否则是'!& 报文 !#'
+static int streamnext(pktstream_t* s, sip_pkt_t* pkt, int* nextNode)
+{
+	int off = nextNode ? 6 : 2;
+	while (s->len - s->start >= 2) {
+		char* p = s->buf + s->start;
+		int avail = s->len - s->start;
+		// 确保以!&开始, 丢弃之前的数据
+		if (memcmp(p, BEGIN_FLAG, 2) != 0) {
+			s->start++;
+			continue;
+		}
+		if (avail < off - 2 + (int)PKT_FRAME_OVERHEAD)
+			return 0;
+		memcpy(&pkt->header, p + off, sizeof(sip_hdr_t));
+		if (pkt->header.length > MAX_PKT_LEN) {
+			s->start += 2;
+			continue;
+		}
+		int flen = off - 2 + PKT_FRAME_OVERHEAD + pkt->header.length;
+		if (avail < flen)
+			return 0;
+		// 确保以!#结尾
+		if (memcmp(p + flen - 2, END_FLAG, 2) != 0) {
+			printf("%s[%d] ERROR: CAN'T [RECV] [END]\n", s->name, s->conn);
+			s->start += 2;
+			continue;
+		}
+		if (nextNode)
+			memcpy(nextNode, p + 2, 4);
+		memcpy(pkt->data, p + off + sizeof(sip_hdr_t), pkt->header.length);
+		s->start += flen;
+		printf("PKT[%s] %s[%d] RECV: %d BYTES [SRC: %2d | DST: %2d]\n", 
+			pkttype(pkt), s->name, s->conn, 
+			pkt->header.length, pkt->header.src_nodeID, pkt->header.dest_nodeID);
+		return 1;
+	}
+	return 0;
+}
+
+int pktstream_next(pktstream_t* s, sip_pkt_t* pkt)
+{
+	return streamnext(s, pkt, NULL);
+}
+
+int pktstream_nextsend(pktstream_t* s, sip_pkt_t* pkt, int* nextNode)
+{
+	return streamnext(s, pkt, nextNode);
+}
@@ -8,18 +8,30 @@
 #ifndef PKT_H
 #define PKT_H
 
+#include <stddef.h>
 #include "constants.h"
 
 //报文类型定义, 用于报文首部中的type字段
 #define	ROUTE_UPDATE 1
 #define SIP 2	
+#define CREDIT 3
+#define LSA 4
+#define ROUTE_ACK 5
+#define LINK_DOWN 6
+#define GROUP_REPORT 7
+#define MCAST 8
+//SON进程在空闲的邻居链路上周期性发送的保活报文, 只在邻居链路上传输, 不交给SIP进程
+#define HELLO 9
+//报文类型中的标志位, 表示报文数据在邻居链路上被压缩了. 这个标志只在SON进程之间使用
+#define PKT_COMPRESSED 0x80
 
 //SIP报文格式定义
 typedef struct sipheader {
     int src_nodeID;		          //源节点ID
     int dest_nodeID;		          //目标节点ID
     unsigned short int length;	  //报文中数据的长度
-    unsigned short int type;	      //报文类型 
+    unsigned char type;	          //报文类型 
+    unsigned char ttl;	          //跳数限制: 每经过一个转发节点减1, 减到0时报文被丢弃. 只发给邻居或本地进程的报文为1
 } sip_hdr_t;
 
 typedef struct packet {
@@ -27,8 +39,17 @@ typedef struct packet {
     char data[MAX_PKT_LEN];
 } sip_pkt_t;
 
+/* 报文在TCP连接上以'!& 首部 数据 !#'的形式组帧, 只发送首部中length指定长度的数据,
+  因此一个报文帧占用 PKT_FRAME_OVERHEAD + length 字节 */
+#define PKT_FRAME_OVERHEAD (4 + sizeof(sip_hdr_t))
+
 /* 路由更新报文定义
-  对于路由更新报文来说, 路由更新信息存储在报文的data字段中 */
+  对于路由更新报文来说, 路由更新信息存储在报文的data字段中.
+  路由更新通常是增量的: 只包含与邻居最近确认的版本(base)相比改变了的条目, 邻居收齐后用ROUTE_ACK报文确认.
+  邻居(重新)连接或者版本不匹配时发送完整的距离矢量.
+  条目用变长整数编码: 节点ID编码为与前一个条目的节点ID之差(zigzag编码), 代价直接编码, 每个字节低7位是数据, 最高位表示后面还有字节.
+  一次路由更新的条目可能放不进一个报文, 这时它被分成多个分片, 每个分片是一个路由更新报文,
+  接收方按序号和分片号重组. */
 
 //一条路由更新条目
 typedef struct routeupdate_entry {
@@ -36,12 +57,97 @@ typedef struct routeupdate_entry {
     unsigned int cost;	    //从源节点(报文首部中的src_nodeID)到目标节点的链路代价
 } routeupdate_entry_t;
 
+//路由更新报文首部之后的编码数据的最大字节数
+#define ROUTEUPDATE_MAX_DATA (MAX_PKT_LEN - 4 * sizeof(unsigned int))
+//一个变长整数编码的条目最多占用的字节数
+#define ROUTEUPDATE_MAX_ENTRY_LEN 10
+//路由更新报文flags中的标志位: 这是完整的距离矢量, 不是增量
+#define ROUTEUPDATE_FULL 0x1
+
 //路由更新报文格式
 typedef struct pktrt{
-    unsigned int entryNum;	//这个路由更新报文中包含的条目数
-    routeupdate_entry_t entry[MAX_NODE_NUM];
+    unsigned int seq;           //路由更新的序号(版本), 一次路由更新的所有分片序号相同
+    unsigned int base;          //增量的基准版本: 邻居最近确认的版本. 完整的距离矢量中没有意义
+    unsigned short fragIdx;     //这个分片的序号, 从0开始
+    unsigned short fragNum;     //这次路由更新的分片数
+    unsigned short entryNum;	//这个分片中包含的条目数
+    unsigned short flags;       //ROUTEUPDATE_FULL等标志位
+    unsigned char data[ROUTEUPDATE_MAX_DATA];   //变长整数编码的条目
 } pkt_routeupdate_t;
 
+//编码数据为len字节的路由更新报文的数据长度
+#define ROUTEUPDATE_LEN(len) (offsetof(pkt_routeupdate_t, data) + (len))
+
+//路由更新确认报文格式
+typedef struct pktrtack {
+    unsigned int seq;           //收齐并使用了的路由更新的序号
+    unsigned int resync;        //为1表示版本不匹配, 请求发送方下一次发送完整的距离矢量
+} pkt_routeack_t;
+
+
+/* 链路状态通告(LSA)报文定义
+  使用链路状态路由时, 每个节点把它到各个邻居的直接链路代价作为一条LSA广播给邻居,
+  收到更新的LSA的节点再把它广播出去(泛洪), 最终每个节点都有所有节点的LSA.
+  一条LSA只描述一个节点的邻居, 总是能放进一个报文. */
+
+//一条LSA最多包含的链路数, 即一个节点最多的邻居数
+#define LSA_MAX_LINKS ((MAX_PKT_LEN - 3 * sizeof(unsigned int)) / sizeof(routeupdate_entry_t))
+
+typedef struct pktlsa {
+    unsigned int nodeID;    //生成这条LSA的节点ID
+    unsigned int seq;       //序号, 节点每次重新生成LSA时加1, 序号大的LSA更新
+    unsigned int linkNum;   //这条LSA中包含的链路数
+    routeupdate_entry_t link[LSA_MAX_LINKS];    //到各个邻居的直接链路代价
+} pkt_lsa_t;
+
+//包含n条链路的LSA报文的数据长度
+#define LSA_LEN(n) (offsetof(pkt_lsa_t, link) + (n) * sizeof(routeupdate_entry_t))
+
+
+/* 信用报文定义
+  SON进程每写出若干个发往某个邻居的帧, 就通过信用报文把同样数量的信用返还给SIP进程.
+  SIP进程只有在还有某个下一跳的信用时才把报文交给SON进程发往该下一跳. */
+typedef struct pktcredit {
+    int nodeID;     //邻居(下一跳)的节点ID
+    int credits;    //返还的信用数
+} pkt_credit_t;
+
+
+/* 链路断开报文定义
+  SON进程发现到某个邻居的链路断开时, 通过链路断开报文通知SIP进程,
+  SIP进程立即把经过这个邻居的路由切换到备份下一跳, 然后重新计算路由. */
+typedef struct pktlinkdown {
+    int nodeID;     //链路断开的邻居的节点ID
+} pkt_linkdown_t;
+
+
+/* 组成员报告定义
+  每个节点把自己加入的所有组播组放在组成员报告中泛洪给所有节点, 加入或离开组时以及周期性地发送.
+  序号更大的报告替换同一个节点之前的报告, 所以离开组不需要单独的报文. */
+typedef struct pktgroupreport {
+    int nodeID;                                 //发出报告的节点ID
+    unsigned int seq;                           //报告的序号
+    unsigned short groupNum;                    //这个节点加入的组数
+    unsigned short group[MCAST_MAX_GROUPS];     //这个节点加入的组号
+} pkt_groupreport_t;
+
+//包含n个组的组成员报告的数据长度
+#define GROUPREPORT_LEN(n) (offsetof(pkt_groupreport_t, group) + (n) * sizeof(unsigned short))
+
+
+/* 组播报文定义
+  组播报文的数据是组号, 目的成员位图和一个STCP段. 位图的第i位对应重叠网络中节点ID第i小的节点.
+  每个节点把位图中的成员按单播路由的下一跳分组, 每个下一跳只发送一个副本, 副本的位图只包含经过这个下一跳的成员,
+  所以报文沿着单播路由组成的树传输, 只在分支点复制, 每条链路上只传输一个副本. */
+typedef struct pktmcast {
+    unsigned short group;                   //组号
+    unsigned short mapLen;                  //成员位图的字节数
+    unsigned char data[MAX_PKT_LEN - 4];    //mapLen字节的成员位图, 之后是STCP段
+} pkt_mcast_t;
+
+//成员位图为mapLen字节, 段长度为segLen的组播报文的数据长度
+#define MCAST_LEN(mapLen, segLen) (offsetof(pkt_mcast_t, data) + (mapLen) + (segLen))
+
 
 /* 数据结构sendpkt_arg_t用在函数son_sendpkt()中. 
   son_sendpkt()由SIP进程调用, 其作用是要求SON进程将报文发送到重叠网络中.
@@ -55,6 +161,90 @@ typedef struct sendpktargument {
 } sendpkt_arg_t;
 
 
+/* 报文帧流定义
+  使用io_uring接收时, 一次接收的数据可能包含多个报文帧, 也可能只有一个帧的一部分.
+  接收到的字节按顺序追加到帧流中, 再从中逐个取出完整的报文帧. */
+typedef struct pktstream {
+    int conn;                  //连接的套接字描述符, 用于打印
+    const char* name;          //连接的名称, 如"NEXT_CONN", 用于打印
+    int start;                 //buf中未处理的数据的起点
+    int len;                   //buf中数据的终点
+    char buf[2 * (PKT_FRAME_OVERHEAD + 4 + MAX_PKT_LEN)];
+} pktstream_t;
+
+
+/**
+ * @brief   将报文组帧为'!& 首部 数据 !#'并写入buf.
+ * @details buf至少应有 PKT_FRAME_OVERHEAD + MAX_PKT_LEN 字节.
+ *          返回帧的字节数, 如果报文长度非法, 返回-1.
+ * 
+ * @param pkt 
+ * @param buf 
+ * @return int 
+ */
+int pkt_frame(sip_pkt_t* pkt, char* buf);
+
+
+/**
+ * @brief   将报文及其下一跳组帧为'!& nextNodeID 首部 数据 !#'并写入buf, 这是SIP进程发给SON进程的帧.
+ * @details buf至少应有 PKT_FRAME_OVERHEAD + 4 + MAX_PKT_LEN 字节.
+ *          返回帧的字节数, 如果报文长度非法, 返回-1.
+ * 
+ * @param nextNodeID 
+ * @param pkt 
+ * @param buf 
+ * @return int 
+ */
+int pkt_framenext(int nextNodeID, sip_pkt_t* pkt, char* buf);
+
+
+/**
+ * @brief   这个函数把entries中从第一个开始的条目编码到路由更新报文pkt_rp中, 直到编码完或者报文放不下.
+ *          设置pkt_rp的entryNum, 返回编码的字节数, 编码的条目数是pkt_rp->entryNum.
+ * 
+ * @param pkt_rp 
+ * @param entries 
+ * @param entryNum 
+ * @return int 
+ */
+int pkt_rtencode(pkt_routeupdate_t* pkt_rp, routeupdate_entry_t* entries, int entryNum);
+
+
+/**
+ * @brief   这个函数解码数据长度为length的路由更新报文pkt_rp中的条目, 写入entries.
+ *          entries至少应有pkt_rp->entryNum个元素. 返回条目数, 报文不完整或编码非法时返回-1.
+ * 
+ * @param pkt_rp 
+ * @param length 
+ * @param entries 
+ * @return int 
+ */
+int pkt_rtdecode(pkt_routeupdate_t* pkt_rp, int length, routeupdate_entry_t* entries);
+
+
+/**
+ * @brief   这个函数比较路由更新, LSA或者组成员报告的序号, a比b新时返回1, 否则返回0.
+ *          序号回绕时仍然正确.
+ * 
+ * @param a 
+ * @param b 
+ * @return int 
+ */
+static inline int pkt_seqnewer(unsigned int a, unsigned int b)
+{
+    return (int)(a - b) > 0;
+}
+
+
+/**
+ * @brief   返回报文类型的名称, 用于打印.
+ * 
+ * @param pkt 
+ * @return const char* 
+ */
+const char* pkt_typename(sip_pkt_t* pkt);
+
+
 /**
  * @brief 
  * @details son_sendpkt()由SIP进程调用, 其作用是要求SON进程将报文发送到重叠网络中. 
@@ -145,6 +335,50 @@ int forwardpktToSIP(sip_pkt_t* pkt, int sip_conn);
 int sendpkt(sip_pkt_t* pkt, int conn);
 
 
+/**
+ * @brief   
+ * @details sendframes()函数由SON进程调用, 其作用是将多个已由pkt_frame()组好帧的报文
+ *          通过一次写操作发送给下一跳. 
+ *          如果全部发送成功, 返回1, 否则返回-1.
+ * 
+ * @param buf 
+ * @param len 
+ * @param conn 
+ * @return int 
+ */
+int sendframes(const char* buf, int len, int conn);
+
+
+/**
+ * @brief   
+ * @details sendframes_dgram()函数是sendframes()在UDP链路上的版本. 
+ *          buf中每个已组好帧的报文作为一个数据报发送, 使用sendmmsg()批量发送.
+ *          因为对端未启动或缓冲区满而丢失的数据报被忽略, 由STCP负责重传.
+ *          如果发送出错, 返回-1, 否则返回1.
+ * 
+ * @param buf 
+ * @param len 
+ * @param conn 
+ * @return int 
+ */
+int sendframes_dgram(const char* buf, int len, int conn);
+
+
+/**
+ * @brief   
+ * @details recvpkts_dgram()函数是recvpkt()在UDP链路上的版本.
+ *          它使用recvmmsg()一次接收最多max(不超过SON_UDP_BATCH)个数据报, 每个数据报是一个报文帧, 
+ *          不完整的帧被丢弃. 至少接收到一个数据报后返回.
+ *          返回接收到的完整报文数, 可能为0. 如果接收出错, 返回-1.
+ * 
+ * @param pkts 
+ * @param max 
+ * @param conn 
+ * @return int 
+ */
+int recvpkts_dgram(sip_pkt_t* pkts, int max, int conn);
+
+
 /**
  * @brief 
  * @details recvpkt()函数由SON进程调用, 其作用是接收来自重叠网络中其邻居的报文.
@@ -163,4 +397,83 @@ int sendpkt(sip_pkt_t* pkt, int conn);
  */
 int recvpkt(sip_pkt_t* pkt, int conn);
 
+
+/**
+ * @brief   
+ * @details recvpkthdr()和recvpktdata()把recvpkt()分成两步: recvpkthdr()接收开始分隔符!&和报文首部,
+ *          SON进程可以根据首部决定用recvpktdata()接收报文数据和结束分隔符!#,
+ *          还是用splicepkt()把它们留在内核中直接转发.
+ *          recvpkthdr()在成功时返回1, 连接关闭时返回0, 否则返回-1; recvpktdata()成功时返回1, 否则返回-1.
+ * 
+ * @param pkt 
+ * @param conn 
+ * @return int 
+ */
+int recvpkthdr(sip_pkt_t* pkt, int conn);
+int recvpktdata(sip_pkt_t* pkt, int conn);
+
+
+/**
+ * @brief   
+ * @details splicepkt()函数在recvpkthdr()之后由SON进程调用, 它用splice()把conn上的报文数据和结束分隔符
+ *          移入管道pipefd, 这些字节不被复制到用户空间. 管道中的数据由SIP连接的写线程转发(见pktqueue.h).
+ *          结束分隔符不被检查, 由SIP进程接收时检查.
+ *          成功时返回1, 否则返回-1.
+ * 
+ * @param pkt 
+ * @param conn 
+ * @param pipefd 
+ * @return int 
+ */
+int splicepkt(sip_pkt_t* pkt, int conn, int pipefd[2]);
+
+
+/**
+ * @brief   这个函数初始化连接conn的报文帧流.
+ * 
+ * @param s 
+ * @param conn 
+ * @param name 
+ */
+void pktstream_init(pktstream_t* s, int conn, const char* name);
+
+
+/**
+ * @brief   
+ * @details 这个函数把连接上接收到的len字节追加到帧流中. 
+ *          帧流的空间有限, 返回实际追加的字节数, 调用者应先用pktstream_next()取出报文, 再追加剩余的字节.
+ * 
+ * @param s 
+ * @param data 
+ * @param len 
+ * @return int 
+ */
+int pktstream_push(pktstream_t* s, const char* data, int len);
+
+
+/**
+ * @brief   
+ * @details 这个函数从帧流中取出下一个完整的'!& 报文 !#'帧. 分隔符不匹配或长度非法的数据被丢弃.
+ *          取出一个报文时返回1, 帧流中没有完整的帧时返回0.
+ * 
+ * @param s 
+ * @param pkt 
+ * @return int 
+ */
+int pktstream_next(pktstream_t* s, sip_pkt_t* pkt);
+
+
+/**
+ * @brief   
+ * @details 这个函数是pktstream_next()在SIP进程发给SON进程的连接上的版本, 
+ *          它取出下一个完整的'!& nextNodeID 报文 !#'帧(见pkt_framenext()), 下一跳的节点ID写入nextNode.
+ *          取出一个报文时返回1, 帧流中没有完整的帧时返回0.
+ * 
+ * @param s 
+ * @param pkt 
+ * @param nextNode 
+ * @return int 
+ */
+int pktstream_nextsend(pktstream_t* s, sip_pkt_t* pkt, int* nextNode);
+
 #endif
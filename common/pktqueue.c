@@ -0,0 +1,311 @@
+/**
+ * @file    common/pktqueue.c
+ * @brief   这个文件实现SON进程和SIP进程之间本地连接的单写者报文帧队列
+ * @date    2023-03-10
+ */
+
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <assert.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include "pktqueue.h"
+
+//写线程一次写操作最多写出的帧数
+#define PKTQUEUE_BATCH 64
+
+
+// 追加一个节点. 多个生产者可以同时调用
+static void push(pktqueue_t* q, pktnode_t* node)
+{
+	atomic_store(&node->next, NULL);
+	pktnode_t* prev = atomic_exchange(&q->tail, node);
+	atomic_store(&prev->next, node);
+}
+
+// 取出队首的节点, 只由写线程调用. 队列为空或者有生产者正在追加时返回NULL
+static pktnode_t* pop(pktqueue_t* q)
+{
+	pktnode_t* head = q->head;
+	pktnode_t* next = atomic_load(&head->next);
+	if (head == q->stub) {
+		if (next == NULL)
+			return NULL;
+		q->head = next;
+		head = next;
+		next = atomic_load(&head->next);
+	}
+	if (next) {
+		q->head = next;
+		return head;
+	}
+	if (head != atomic_load(&q->tail))
+		return NULL;
+	// head是最后一个节点, 放回占位节点后才能取出它
+	push(q, q->stub);
+	next = atomic_load(&head->next);
+	if (next) {
+		q->head = next;
+		return head;
+	}
+	return NULL;
+}
+
+// 队列中是否有节点(包括正在追加的节点)
+static int pending(pktqueue_t* q)
+{
+	return q->head != q->stub || atomic_load(&q->tail) != q->stub;
+}
+
+// 写出失败: 如果连接没有被换掉, 标记为断开
+static void fail(pktqueue_t* q, int conn)
+{
+	if (atomic_load(&q->conn) == conn)
+		atomic_store(&q->broken, 1);
+}
+
+// 写出iov中的n个帧, 处理部分写出
+static int writev_all(int conn, struct iovec* iov, int n, int more)
+{
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = n;
+	while (msg.msg_iovlen > 0) {
+		ssize_t sent = sendmsg(conn, &msg, MSG_NOSIGNAL | (more ? MSG_MORE : 0));
+		if (sent < 0 && errno == EINTR)
+			continue;
+		if (sent <= 0)
+			return -1;
+		while (msg.msg_iovlen > 0 && (size_t)sent >= msg.msg_iov->iov_len) {
+			sent -= msg.msg_iov->iov_len;
+			msg.msg_iov++;
+			msg.msg_iovlen--;
+		}
+		if (msg.msg_iovlen > 0) {
+			msg.msg_iov->iov_base = (char*)msg.msg_iov->iov_base + sent;
+			msg.msg_iov->iov_len -= sent;
+		}
+	}
+	return 1;
+}
+
+// 从管道中把len字节移到连接上
+static int splice_all(int pipefd, int conn, int len)
+{
+	int n;
+	while (len > 0) {
+		if ((n = splice(pipefd, NULL, conn, NULL, len, SPLICE_F_MOVE)) <= 0) {
+			if (n < 0 && errno == EINTR)
+				continue;
+			return -1;
+		}
+		len -= n;
+	}
+	return 1;
+}
+
+// 写线程: 每次取出最多PKTQUEUE_BATCH个帧, 用一次写操作写出
+static void* pktqueue_daemon(void* arg)
+{
+	pktqueue_t* q = (pktqueue_t*)arg;
+	pktnode_t* nodes[PKTQUEUE_BATCH];
+	struct iovec iov[PKTQUEUE_BATCH];
+	while (1) {
+		int n = 0;
+		pktnode_t* node;
+		while (n < PKTQUEUE_BATCH && (node = pop(q)) != NULL) {
+			nodes[n++] = node;
+			// 需要splice的帧结束这一批
+			if (node->spliceLen > 0)
+				break;
+		}
+		if (n == 0) {
+			if (atomic_load(&q->stop))
+				break;
+			if (pending(q)) {
+				// 生产者正在追加
+				sched_yield();
+				continue;
+			}
+			pthread_mutex_lock(&q->mutex);
+			atomic_store(&q->waiting, 1);
+			if (!pending(q) && !atomic_load(&q->stop))
+				pthread_cond_wait(&q->ready, &q->mutex);
+			atomic_store(&q->waiting, 0);
+			pthread_mutex_unlock(&q->mutex);
+			continue;
+		}
+
+		int conn = atomic_load(&q->conn);
+		int ok = conn > 0 && !atomic_load(&q->broken);
+		pktnode_t* last = nodes[n - 1];
+		if (ok) {
+			for (int i = 0; i < n; i++) {
+				iov[i].iov_base = nodes[i]->data;
+				iov[i].iov_len = nodes[i]->len;
+			}
+			// 后面还有管道中的数据时, 首部不单独成为一个TCP段
+			if (writev_all(conn, iov, n, last->spliceLen > 0) < 0) {
+				printf("%s[%d] ERROR: CAN'T [SEND] [FRAMES]\n", q->name, conn);
+				fail(q, conn);
+				ok = 0;
+			} else if (last->spliceLen > 0 && splice_all(last->pipe->fd[0], conn, last->spliceLen) < 0) {
+				printf("%s[%d] ERROR: CAN'T [SPLICE] [PACKET]\n", q->name, conn);
+				fail(q, conn);
+				ok = 0;
+			}
+			q->frames += n;
+			q->writes++;
+		}
+		if (last->spliceLen > 0)
+			atomic_store(&last->pipe->busy, ok ? 0 : -1);
+		for (int i = 0; i < n; i++)
+			free(nodes[i]);
+		atomic_fetch_sub(&q->depth, n);
+	}
+	return NULL;
+}
+
+// 分配一个可以容纳len字节的节点
+static pktnode_t* alloc(int len)
+{
+	pktnode_t* node = (pktnode_t*)malloc(sizeof(pktnode_t) + len);
+	assert(node != NULL);
+	node->len = len;
+	node->spliceLen = 0;
+	node->pipe = NULL;
+	return node;
+}
+
+// 把报文pkt的帧node放入队列, 必要时唤醒写线程. 队列达到上限时丢弃数据报文, 返回0
+static int enqueue(pktqueue_t* q, pktnode_t* node, sip_pkt_t* pkt)
+{
+	if (atomic_load(&q->conn) <= 0 || atomic_load(&q->broken)) {
+		free(node);
+		return -1;
+	}
+	int type = pkt->header.type & ~PKT_COMPRESSED;
+	if ((type == SIP || type == MCAST) && atomic_load(&q->depth) >= PKTQUEUE_MAX_FRAMES) {
+		atomic_fetch_add(&q->dropped, 1);
+		free(node);
+		printf("PKT[%s] %s[%d] QUEUE IS FULL, DROP: %d BYTES [SRC: %2d | DST: %2d]\n", 
+			pkt_typename(pkt), q->name, atomic_load(&q->conn),
+			pkt->header.length, pkt->header.src_nodeID, pkt->header.dest_nodeID);
+		return 0;
+	}
+	atomic_fetch_add(&q->depth, 1);
+	push(q, node);
+	if (atomic_load(&q->waiting)) {
+		pthread_mutex_lock(&q->mutex);
+		pthread_cond_signal(&q->ready);
+		pthread_mutex_unlock(&q->mutex);
+	}
+	return 1;
+}
+
+
+pktqueue_t* pktqueue_create(int conn, const char* name)
+{
+	pktqueue_t* q = (pktqueue_t*)malloc(sizeof(pktqueue_t));
+	assert(q != NULL);
+	atomic_init(&q->conn, conn);
+	atomic_init(&q->broken, 0);
+	q->stub = alloc(0);
+	atomic_init(&q->stub->next, NULL);
+	atomic_init(&q->tail, q->stub);
+	q->head = q->stub;
+	atomic_init(&q->depth, 0);
+	atomic_init(&q->dropped, 0);
+	atomic_init(&q->waiting, 0);
+	atomic_init(&q->stop, 0);
+	q->frames = 0;
+	q->writes = 0;
+	q->name = name;
+	pthread_mutex_init(&q->mutex, NULL);
+	pthread_cond_init(&q->ready, NULL);
+	pthread_create(&q->thread, NULL, pktqueue_daemon, (void*)q);
+	return q;
+}
+
+void pktqueue_destroy(pktqueue_t* q)
+{
+	if (!q)
+		return;
+	// 丢弃剩余的帧, 写线程不会再写连接
+	atomic_store(&q->conn, -1);
+	pthread_mutex_lock(&q->mutex);
+	atomic_store(&q->stop, 1);
+	pthread_cond_signal(&q->ready);
+	pthread_mutex_unlock(&q->mutex);
+	pthread_join(q->thread, NULL);
+	free(q->stub);
+	pthread_mutex_destroy(&q->mutex);
+	pthread_cond_destroy(&q->ready);
+	free(q);
+}
+
+void pktqueue_setconn(pktqueue_t* q, int conn)
+{
+	atomic_store(&q->conn, conn);
+	atomic_store(&q->broken, 0);
+}
+
+int pktqueue_sendpkt(pktqueue_t* q, sip_pkt_t* pkt)
+{
+	if (pkt->header.length > MAX_PKT_LEN)
+		return -1;
+	pktnode_t* node = alloc(PKT_FRAME_OVERHEAD + pkt->header.length);
+	pkt_frame(pkt, node->data);
+	int n;
+	if ((n = enqueue(q, node, pkt)) <= 0)
+		return n;
+	printf("PKT[%s] %s[%d] SEND: %d BYTES [SRC: %2d | DST: %2d]\n", 
+		pkt_typename(pkt), q->name, atomic_load(&q->conn),
+		pkt->header.length, pkt->header.src_nodeID, pkt->header.dest_nodeID);
+	return 1;
+}
+
+int pktqueue_sendnext(pktqueue_t* q, int nextNodeID, sip_pkt_t* pkt)
+{
+	if (pkt->header.length > MAX_PKT_LEN)
+		return -1;
+	pktnode_t* node = alloc(PKT_FRAME_OVERHEAD + 4 + pkt->header.length);
+	pkt_framenext(nextNodeID, pkt, node->data);
+	int n;
+	if ((n = enqueue(q, node, pkt)) <= 0)
+		return n;
+	printf("PKT[%s] %s[%d] SEND: %d BYTES [SRC: %2d | DST: %2d]\n", 
+		pkt_typename(pkt), q->name, atomic_load(&q->conn),
+		pkt->header.length, pkt->header.src_nodeID, pkt->header.dest_nodeID);
+	return 1;
+}
+
+int pktqueue_splice(pktqueue_t* q, sip_pkt_t* pkt, splicepipe_t* pipe)
+{
+	pktnode_t* node = alloc(2 + sizeof(sip_hdr_t));
+	memcpy(node->data, "!&", 2);
+	memcpy(node->data + 2, &pkt->header, sizeof(sip_hdr_t));
+	node->spliceLen = pkt->header.length + 2;
+	node->pipe = pipe;
+	int n;
+	if ((n = enqueue(q, node, pkt)) <= 0)
+		return n;
+	printf("PKT[%s] %s[%d] SEND: %d BYTES [SRC: %2d | DST: %2d]\n", 
+		pkt_typename(pkt), q->name, atomic_load(&q->conn),
+		pkt->header.length, pkt->header.src_nodeID, pkt->header.dest_nodeID);
+	return 1;
+}
+
+void pktqueue_print(pktqueue_t* q)
+{
+	printf("%s WRITER [FRAMES: %lu | WRITES: %lu | FRAMES/WRITE: %.2f | DROPPED: %lu]\n",
+		q->name, q->frames, q->writes,
+		q->writes ? (double)q->frames / q->writes : 0.0, atomic_load(&q->dropped));
+}
@@ -0,0 +1,127 @@
+/**
+ * @file    common/pktqueue.h
+ * @brief   这个文件定义SON进程和SIP进程之间本地连接的单写者报文帧队列
+ * @date    2023-03-10
+ */
+
+
+#ifndef PKTQUEUE_H
+#define PKTQUEUE_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include "pkt.h"
+
+//SON进程到SIP进程的连接(sip_conn)和SIP进程到SON进程的连接(son_conn)都有多个线程要写.
+//每个连接由一个写线程独占, 其他线程把组好的帧放入一个无锁的多生产者单消费者(MPSC)队列, 
+//写线程每次取出队列中的多个帧, 用一次sendmsg()写出. 入队不会阻塞, 也不会交错写出半个帧.
+//队列中最多有PKTQUEUE_MAX_FRAMES个帧, 读者跟不上时新的数据报文被丢弃并计数, 控制报文总是入队,
+//这样读者变慢时内存不会无限增长, 信用等控制报文也不会丢失.
+
+//splice管道. SON进程把邻居连接上的报文数据移入管道, 写线程在发送首部之后把管道中的数据移到连接上.
+typedef struct splicepipe {
+	int fd[2];          //管道的读端和写端
+	atomic_int busy;    //0: 空闲; 1: 写线程还没有取走管道中的数据; -1: 写出失败, 管道中有残留数据, 需要重建
+} splicepipe_t;
+
+//队列中的一个帧
+typedef struct pktnode {
+	struct pktnode* _Atomic next;
+	int len;                  //data中的字节数
+	int spliceLen;            //写出data后还要从pipe中移出的字节数
+	splicepipe_t* pipe;       //spliceLen不为0时数据所在的管道
+	char data[];
+} pktnode_t;
+
+typedef struct pktqueue {
+	atomic_int conn;              //写线程写出的连接, 小于等于0时丢弃队列中的帧
+	atomic_int broken;            //写出失败后为1, 直到pktqueue_setconn()设置新的连接
+	pktnode_t* _Atomic tail;      //生产者在队尾追加
+	pktnode_t* head;              //写线程从队首取出
+	pktnode_t* stub;              //队列为空时的占位节点
+	atomic_int depth;             //队列中还没有被写线程处理的帧数
+	atomic_ulong dropped;         //因为队列达到上限而丢弃的数据报文数
+	atomic_int waiting;           //写线程等待新的帧时为1
+	atomic_int stop;              //为1时写线程退出
+	unsigned long frames;         //写线程写出的帧数
+	unsigned long writes;         //写线程执行的写操作次数
+	pthread_mutex_t mutex;        //只用于唤醒写线程
+	pthread_cond_t ready;
+	pthread_t thread;
+	const char* name;             //连接的名称, 用于打印
+} pktqueue_t;
+
+
+/**
+ * @brief   这个函数创建一个连接conn的报文帧队列, 并启动写线程. conn可以为-1, 之后用pktqueue_setconn()设置.
+ * 
+ * @param conn 
+ * @param name 
+ * @return pktqueue_t* 
+ */
+pktqueue_t* pktqueue_create(int conn, const char* name);
+
+
+/**
+ * @brief   这个函数停止写线程并释放队列, 队列中还没有写出的帧被丢弃.
+ * 
+ * @param q 
+ */
+void pktqueue_destroy(pktqueue_t* q);
+
+
+/**
+ * @brief   这个函数把写线程使用的连接换成conn, 并清除写出失败的标志.
+ *          队列中还没有写出的帧将写到新的连接上.
+ * 
+ * @param q 
+ * @param conn 
+ */
+void pktqueue_setconn(pktqueue_t* q, int conn);
+
+
+/**
+ * @brief   这个函数把报文组帧为'!& 报文 !#'后放入队列, 由SON进程用来向SIP进程转发报文.
+ *          入队成功返回1. 数据报文因为队列达到PKTQUEUE_MAX_FRAMES个帧而被丢弃时返回0.
+ *          如果报文非法, 或者连接已经断开, 返回-1.
+ * 
+ * @param q 
+ * @param pkt 
+ * @return int 
+ */
+int pktqueue_sendpkt(pktqueue_t* q, sip_pkt_t* pkt);
+
+
+/**
+ * @brief   这个函数把报文及其下一跳组帧为'!& nextNodeID 报文 !#'后放入队列, 
+ *          由SIP进程用来要求SON进程发送报文. 返回值同pktqueue_sendpkt().
+ * 
+ * @param q 
+ * @param nextNodeID 
+ * @param pkt 
+ * @return int 
+ */
+int pktqueue_sendnext(pktqueue_t* q, int nextNodeID, sip_pkt_t* pkt);
+
+
+/**
+ * @brief   这个函数把'!& 首部'放入队列, 报文数据和结束分隔符已经由splicepkt()移入管道pipe.
+ *          写线程写出首部后用splice()把管道中的数据移到连接上, 然后把pipe->busy置为0(失败时置为-1).
+ *          调用者在入队前应把pipe->busy置为1. 返回值同pktqueue_sendpkt(), 返回0或-1时管道中的数据没有被取走.
+ * 
+ * @param q 
+ * @param pkt 
+ * @param pipe 
+ * @return int 
+ */
+int pktqueue_splice(pktqueue_t* q, sip_pkt_t* pkt, splicepipe_t* pipe);
+
+
+/**
+ * @brief   这个函数打印写线程的统计信息和丢弃的数据报文数.
+ * 
+ * @param q 
+ */
+void pktqueue_print(pktqueue_t* q);
+
+#endif
@@ -0,0 +1,127 @@
+/**
+ * @file    common/rcu.c
+ * @brief   这个文件实现基于纪元(epoch)的延迟回收
+ * @date    2023-03-22
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include "rcu.h"
+
+//已经分配的读者槽位数
+static atomic_int readerNum;
+//这个线程的读者槽位, 还没有分配时为-1
+static _Thread_local int readerSlot = -1;
+
+
+// 返回这个线程的读者槽位, 第一次调用时分配
+static int slot()
+{
+	if (readerSlot < 0) {
+		readerSlot = atomic_fetch_add(&readerNum, 1);
+		assert(readerSlot < RCU_MAX_READERS);
+	}
+	return readerSlot;
+}
+
+
+// 返回所有在临界区中的读者公布的最小纪元, 没有读者在临界区中时返回ULONG_MAX
+static unsigned long minepoch(rcu_t* rcu)
+{
+	unsigned long min = (unsigned long)-1;
+	int n = atomic_load(&readerNum);
+	for (int i = 0; i < n && i < RCU_MAX_READERS; i++) {
+		unsigned long e = atomic_load(&rcu->reader[i]);
+		if (e != 0 && e < min)
+			min = e;
+	}
+	return min;
+}
+
+
+rcu_t* rcu_create()
+{
+	rcu_t* rcu = (rcu_t*)malloc(sizeof(rcu_t));
+	assert(rcu != NULL);
+	atomic_init(&rcu->epoch, 1);
+	for (int i = 0; i < RCU_MAX_READERS; i++)
+		atomic_init(&rcu->reader[i], 0);
+	rcu->retired = NULL;
+	rcu->retiredNum = 0;
+	pthread_mutex_init(&rcu->mutex, NULL);
+	return rcu;
+}
+
+
+void rcu_destroy(rcu_t* rcu)
+{
+	while (rcu->retired) {
+		rcu_retired_t* r = rcu->retired;
+		rcu->retired = r->next;
+		r->destroy(r->ptr);
+		free(r);
+	}
+	pthread_mutex_destroy(&rcu->mutex);
+	free(rcu);
+}
+
+
+void rcu_read_lock(rcu_t* rcu)
+{
+	// 先公布纪元再读取原子指针, 两者都是顺序一致的, 这样写者在发布新版本后一定能看到这个读者
+	atomic_store(&rcu->reader[slot()], atomic_load(&rcu->epoch));
+}
+
+
+void rcu_read_unlock(rcu_t* rcu)
+{
+	atomic_store(&rcu->reader[slot()], 0);
+}
+
+
+// 释放所有没有读者的旧版本. 调用者应持有rcu->mutex
+static void reclaim(rcu_t* rcu)
+{
+	unsigned long min = minepoch(rcu);
+	rcu_retired_t** p = &rcu->retired;
+	while (*p) {
+		rcu_retired_t* r = *p;
+		if (r->epoch <= min) {
+			*p = r->next;
+			r->destroy(r->ptr);
+			free(r);
+			rcu->retiredNum--;
+		} else {
+			p = &r->next;
+		}
+	}
+}
+
+
+void rcu_retire(rcu_t* rcu, void* ptr, void (*destroy)(void*))
+{
+	rcu_retired_t* r = (rcu_retired_t*)malloc(sizeof(rcu_retired_t));
+	assert(r != NULL);
+	r->ptr = ptr;
+	r->destroy = destroy;
+	// 在新版本发布之后推进纪元: 公布了新纪元的读者读到的一定是新版本
+	r->epoch = atomic_fetch_add(&rcu->epoch, 1) + 1;
+	pthread_mutex_lock(&rcu->mutex);
+	r->next = rcu->retired;
+	rcu->retired = r;
+	rcu->retiredNum++;
+	reclaim(rcu);
+	pthread_mutex_unlock(&rcu->mutex);
+}
+
+
+unsigned long rcu_reclaim(rcu_t* rcu)
+{
+	pthread_mutex_lock(&rcu->mutex);
+	reclaim(rcu);
+	unsigned long n = rcu->retiredNum;
+	pthread_mutex_unlock(&rcu->mutex);
+	return n;
+}
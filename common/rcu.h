@@ -0,0 +1,92 @@
+/**
+ * @file    common/rcu.h
+ * @brief   这个文件定义基于纪元(epoch)的延迟回收, 用于读多写少的共享数据的无锁读取
+ * @date    2023-03-22
+ */
+
+
+#ifndef RCU_H
+#define RCU_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+//最多的读者线程数
+#define RCU_MAX_READERS 64
+
+//写者不修改已经发布的数据, 而是复制一份修改后通过原子指针发布新版本, 再把旧版本交给rcu_retire().
+//读者在rcu_read_lock()和rcu_read_unlock()之间读取原子指针和它指向的数据, 既不加锁也不会被写者阻塞.
+//读者进入临界区时公布当前的纪元, 旧版本只有在所有可能看到它的读者都离开临界区后才被释放.
+
+//等待回收的旧版本
+typedef struct rcuretired {
+	void* ptr;
+	void (*destroy)(void*);         //释放ptr的函数
+	unsigned long epoch;            //公布的纪元小于这个值的读者可能还在使用ptr
+	struct rcuretired* next;
+} rcu_retired_t;
+
+typedef struct rcu {
+	atomic_ulong epoch;                         //当前纪元, 每次rcu_retire()加1
+	atomic_ulong reader[RCU_MAX_READERS];       //每个读者线程进入临界区时的纪元, 不在临界区时为0
+	rcu_retired_t* retired;                     //等待回收的旧版本链表
+	unsigned long retiredNum;                   //等待回收的旧版本数
+	pthread_mutex_t mutex;                      //保护retired, 只有写者使用
+} rcu_t;
+
+
+/**
+ * @brief   这个函数创建一个rcu_t.
+ *
+ * @return rcu_t*
+ */
+rcu_t* rcu_create();
+
+
+/**
+ * @brief   这个函数释放所有等待回收的旧版本并删除rcu_t. 调用时不应有读者在临界区中.
+ *
+ * @param rcu
+ */
+void rcu_destroy(rcu_t* rcu);
+
+
+/**
+ * @brief   读者进入临界区. 之后读取的原子指针指向的数据在rcu_read_unlock()之前不会被释放.
+ * @details 每个线程第一次调用时分配一个读者槽位, 同一个线程在不同的rcu_t中使用同一个槽位.
+ *          临界区不能嵌套.
+ *
+ * @param rcu
+ */
+void rcu_read_lock(rcu_t* rcu);
+
+
+/**
+ * @brief   读者离开临界区.
+ *
+ * @param rcu
+ */
+void rcu_read_unlock(rcu_t* rcu);
+
+
+/**
+ * @brief   写者在发布了新版本之后调用这个函数回收旧版本ptr.
+ * @details 当所有可能读到ptr的读者离开临界区后, 用destroy(ptr)释放它.
+ *          这个函数不会等待读者, 不能立即释放的旧版本留到之后的rcu_retire()或rcu_reclaim()中释放.
+ *
+ * @param rcu
+ * @param ptr
+ * @param destroy
+ */
+void rcu_retire(rcu_t* rcu, void* ptr, void (*destroy)(void*));
+
+
+/**
+ * @brief   释放所有已经没有读者的旧版本, 返回仍在等待回收的旧版本数.
+ *
+ * @param rcu
+ * @return unsigned long
+ */
+unsigned long rcu_reclaim(rcu_t* rcu);
+
+#endif
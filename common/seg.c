@@ -8,12 +8,47 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
 
 
 const char* BEGIN_SIGN = "!&";
 const char* END_SIGN = "!#";
-const char* SEG_TYPE[6] = {"SYN", "SYNACK", "FIN", "FINACK", "DATA", "DATAACK"};
+const char* SEG_TYPE[12] = {"SYN", "SYNACK", "FIN", "FINACK", "DATA", "DATAACK", "BUSY", "MJOIN", "MLEAVE", "BIND", "UNBIND", "MDATA"};
+
+
+int sip_bindport(int sip_conn, unsigned int port, int bind)
+{
+	seg_t seg;
+	memset(&seg, 0, sizeof(seg));
+	seg.header.type = bind ? BIND : UNBIND;
+	seg.header.src_port = port;
+	return sip_sendseg(sip_conn, 0, &seg);
+}
+
+
+int sip_waitready(int timeout)
+{
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(SIP_PORT);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	for (long waited = 0; ; waited += SIP_READY_POLL) {
+		int fd = socket(AF_INET, SOCK_STREAM, 0);
+		if (fd >= 0 && connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0)
+			return fd;
+		if (fd >= 0)
+			close(fd);
+		if (timeout >= 0 && waited >= timeout * 1000L) {
+			printf("STCP: SIP PROCESS IS NOT READY IN %d SECONDS\n", timeout);
+			return -1;
+		}
+		usleep(SIP_READY_POLL * 1000);
+	}
+}
 
 
 int sip_sendseg(int sip_conn, int dest_nodeID, seg_t* segPtr)
@@ -132,6 +167,62 @@ int getsegToSend(int stcp_conn, int* dest_nodeID, seg_t* segPtr)
 }
 
 
+void segstream_init(segstream_t* s, int conn)
+{
+	s->conn = conn;
+	s->start = 0;
+	s->len = 0;
+}
+
+
+int segstream_push(segstream_t* s, const char* data, int len)
+{
+	// 把未处理的数据移到缓冲区开头
+	if (s->start > 0) {
+		memmove(s->buf, s->buf + s->start, s->len - s->start);
+		s->len -= s->start;
+		s->start = 0;
+	}
+	int n = (int)sizeof(s->buf) - s->len;
+	if (n > len)
+		n = len;
+	memcpy(s->buf + s->len, data, n);
+	s->len += n;
+	return n;
+}
+
+
+int segstream_next(segstream_t* s, int* dest_nodeID, seg_t* segPtr)
+{
+	while (s->len - s->start >= 2) {
+		char* p = s->buf + s->start;
+		// 确保以!&开始, 丢弃之前的数据
+		if (memcmp(p, BEGIN_SIGN, 2) != 0) {
+			s->start++;
+			continue;
+		}
+		if (s->len - s->start < (int)SEG_FRAME_LEN)
+			return 0;
+		// 确保以!#结尾
+		if (memcmp(p + SEG_FRAME_LEN - 2, END_SIGN, 2) != 0) {
+			printf("STCP_CONN[%d] ERROR: [SIP] CAN'T [RECV] [END]\n", s->conn);
+			s->start += 2;
+			continue;
+		}
+		sendseg_arg_t sendseg;
+		memcpy(&sendseg, p + 2, sizeof(sendseg_arg_t));
+		s->start += SEG_FRAME_LEN;
+		*dest_nodeID = sendseg.nodeID;
+		memcpy(segPtr, &sendseg.seg, sizeof(seg_t));
+		printf("SEG[%s] STCP_CONN[%d] RECV: %d BYTES [PORT: %d | SEQ: %3d]\n", 
+			SEG_TYPE[segPtr->header.type], s->conn, 
+			segPtr->header.length, segPtr->header.src_port, segPtr->header.seq_num);
+		return 1;
+	}
+	return 0;
+}
+
+
 int forwardsegToSTCP(int stcp_conn, int src_nodeID, seg_t* segPtr)
 {
 	// 打包segment和nodeID
@@ -158,6 +249,18 @@ int forwardsegToSTCP(int stcp_conn, int src_nodeID, seg_t* segPtr)
 }
 
 
+int seg_frame(int src_nodeID, seg_t* segPtr, char* buf)
+{
+	sendseg_arg_t sendseg;
+	sendseg.nodeID = src_nodeID;
+	sendseg.seg = *segPtr;
+	memcpy(buf, BEGIN_SIGN, 2);
+	memcpy(buf + 2, &sendseg, sizeof(sendseg_arg_t));
+	memcpy(buf + 2 + sizeof(sendseg_arg_t), END_SIGN, 2);
+	return SEG_FRAME_LEN;
+}
+
+
 int seglost(seg_t* segPtr, int sip_conn) 
 {
 	int random = rand() % 100;
@@ -17,6 +17,18 @@
 #define	FINACK 3
 #define	DATA 4
 #define	DATAACK 5
+//SIP进程因为下一跳拥塞而丢弃了一个段时, 向发送该段的STCP进程返回BUSY段
+#define BUSY 6
+//STCP进程通过发往组地址(MCAST_BASE+组号)的MJOIN/MLEAVE段加入或离开组播组, 这两种段由本节点的SIP进程处理, 不在重叠网络中传输
+#define MJOIN 7
+#define MLEAVE 8
+//一个SIP进程可以连接多个STCP进程, STCP进程通过BIND/UNBIND段在本地SIP进程注册或注销端口src_port,
+//SIP进程把目的端口为这个端口的段交给它. 这两种段也不在重叠网络中传输
+#define BIND 9
+#define UNBIND 10
+//发往组地址的组播数据段. 组播是不可靠的数据报服务: 没有连接, 不确认也不重传, 每个段独立交给组的所有其他成员.
+//STCP连接仍然只是单播的, SIP进程不把其他类型的段发往组地址
+#define MDATA 11
 
 
 //段首部定义 
@@ -43,6 +55,18 @@ typedef struct sendsegargument {
 	seg_t seg;		//一个段 
 } sendseg_arg_t;
 
+//一个'!& sendseg_arg_t !#'帧的字节数
+#define SEG_FRAME_LEN (4 + sizeof(sendseg_arg_t))
+
+//段帧流. SIP进程用io_uring接收STCP进程的段时, 一次接收的数据可能包含多个段帧, 也可能只有一个帧的一部分.
+//接收到的字节按顺序追加到段帧流中, 再从中逐个取出完整的段.
+typedef struct segstream {
+	int conn;                       //连接的套接字描述符, 用于打印
+	int start;                      //buf中未处理的数据的起点
+	int len;                        //buf中数据的终点
+	char buf[2 * SEG_FRAME_LEN];
+} segstream_t;
+
 
 /* 客户端和服务器的SIP API */
 
@@ -62,6 +86,29 @@ typedef struct sendsegargument {
 int sip_sendseg(int sip_conn, int dest_nodeID, seg_t* segPtr);
 
 
+/**
+ * @brief   STCP进程使用这个函数在本地SIP进程注册(bind为1)或注销(bind为0)端口port.
+ *          注册后SIP进程把目的端口为port的段交给这个STCP进程. 成功时返回1, 失败时返回-1.
+ *
+ * @param sip_conn
+ * @param port
+ * @param bind
+ * @return int
+ */
+int sip_bindport(int sip_conn, unsigned int port, int bind);
+
+
+/**
+ * @brief   STCP进程使用这个函数等待本地SIP进程就绪并连接到它, 返回到SIP进程的TCP连接.
+ * @details SIP进程在路由收敛后才开始在SIP_PORT上接受连接, 所以连接成功就表示SIP进程已经就绪.
+ *          这个函数每SIP_READY_POLL毫秒尝试连接一次, 最多等待timeout秒, 超时返回-1. timeout为负数时一直等待.
+ *
+ * @param timeout
+ * @return int
+ */
+int sip_waitready(int timeout);
+
+
 /**
  * @brief   STCP进程使用这个函数来接收来自SIP进程的包含段及其源节点ID的sendseg_arg_t结构.
  * 
@@ -81,7 +128,41 @@ int sip_recvseg(int sip_conn, int* src_nodeID, seg_t* segPtr);
  * @param segPtr 
  * @return int 
  */
-int getsegToSend(int stcp_conn, int* dest_nodeID, seg_t* segPtr); 
+int getsegToSend(int stcp_conn, int* dest_nodeID, seg_t* segPtr);
+
+
+/**
+ * @brief   这个函数初始化连接conn的段帧流.
+ * 
+ * @param s 
+ * @param conn 
+ */
+void segstream_init(segstream_t* s, int conn);
+
+
+/**
+ * @brief   这个函数把连接上接收到的len字节追加到段帧流中.
+ *          帧流的空间有限, 返回实际追加的字节数, 调用者应先用segstream_next()取出段, 再追加剩余的字节.
+ * 
+ * @param s 
+ * @param data 
+ * @param len 
+ * @return int 
+ */
+int segstream_push(segstream_t* s, const char* data, int len);
+
+
+/**
+ * @brief   这个函数是getsegToSend()在段帧流上的版本: 它从帧流中取出下一个完整的'!& sendseg_arg_t !#'帧,
+ *          目的节点ID写入dest_nodeID, 段写入segPtr. 分隔符不匹配的数据被丢弃.
+ *          取出一个段时返回1, 帧流中没有完整的帧时返回0.
+ * 
+ * @param s 
+ * @param dest_nodeID 
+ * @param segPtr 
+ * @return int 
+ */
+int segstream_next(segstream_t* s, int* dest_nodeID, seg_t* segPtr); 
 
 
 /**
@@ -94,6 +175,18 @@ int getsegToSend(int stcp_conn, int* dest_nodeID, seg_t* segPtr);
  */
 int forwardsegToSTCP(int stcp_conn, int src_nodeID, seg_t* segPtr); 
 
+
+/**
+ * @brief   这个函数把包含段及其源节点ID的sendseg_arg_t结构组成一个'!& sendseg_arg_t !#'帧写入buf,
+ *          返回帧的字节数SEG_FRAME_LEN. SIP进程用它把段放入STCP进程的发送缓存, 再用非阻塞写写出.
+ * 
+ * @param src_nodeID 
+ * @param segPtr 
+ * @param buf 
+ * @return int 
+ */
+int seg_frame(int src_nodeID, seg_t* segPtr, char* buf);
+
 /**
  * @brief 
  * @details	在剖析了一个STCP段之后,  调用seglost()来模拟网络中数据包的丢失.
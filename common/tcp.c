@@ -77,6 +77,39 @@ int tcp_server_listen(int port) {
 }
 
 
+int udp_conn_n(in_addr_t address, int localPort, int peerPort) {
+    int socket_fd;
+    socket_fd = socket(AF_INET, SOCK_DGRAM, 0);
+
+    int on = 1;
+    setsockopt(socket_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    setsockopt(socket_fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+
+    struct sockaddr_in local_addr;
+    bzero(&local_addr, sizeof(local_addr));
+    local_addr.sin_family = AF_INET;
+    local_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    local_addr.sin_port = htons(localPort);
+    if (bind(socket_fd, (struct sockaddr *) &local_addr, sizeof(local_addr)) < 0) {
+        printf("Udp: bind failed\n");
+        close(socket_fd);
+        return -1;
+    }
+
+    struct sockaddr_in peer_addr;
+    bzero(&peer_addr, sizeof(peer_addr));
+    peer_addr.sin_family = AF_INET;
+    peer_addr.sin_port = htons(peerPort);
+    peer_addr.sin_addr.s_addr = address;
+    if (connect(socket_fd, (struct sockaddr *) &peer_addr, sizeof(peer_addr)) < 0) {
+        printf("Udp: connect failed\n");
+        close(socket_fd);
+        return -1;
+    }
+    return socket_fd;
+}
+
+
 int tcp_server_conn(int port) {
     int listenfd;
     listenfd = tcp_server_listen(port);
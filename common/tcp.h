@@ -46,4 +46,17 @@ int tcp_server_listen(int port);
  * @return * int 
  */
 int tcp_server_conn(int port);
+
+
+/**
+ * @brief   udp连接, 套接字绑定到本地端口localPort并连接到对端sin_addr:peerPort,
+ *          多个这样的套接字可以绑定同一个本地端口, 内核按对端地址分发数据报. 
+ *          成功返回sockfd，不成功返回-1
+ * 
+ * @param sin_addr 
+ * @param localPort 
+ * @param peerPort 
+ * @return int 
+ */
+int udp_conn_n(in_addr_t sin_addr, int localPort, int peerPort);
 #endif
\ No newline at end of file
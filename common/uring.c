@@ -0,0 +1,221 @@
+/**
+ * @file    common/uring.c
+ * @brief   这个文件实现基于io_uring的接收后端
+ * @date    2023-03-09
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include "uring.h"
+
+
+static int uring_setup(unsigned entries, struct io_uring_params* p)
+{
+	return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int uring_enter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags, void* arg, size_t argSize)
+{
+	return syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, arg, argSize);
+}
+
+static int uring_register(int fd, unsigned op, void* arg, unsigned nrArgs)
+{
+	return syscall(__NR_io_uring_register, fd, op, arg, nrArgs);
+}
+
+// 把缓冲区bid放到缓冲区环中, 由调用者发布尾指针
+static void putbuf(uring_t* ring, int bid)
+{
+	struct io_uring_buf* buf = &ring->bufRing->bufs[ring->bufTail & (ring->nbufs - 1)];
+	buf->addr = (unsigned long)(ring->pool + (size_t)bid * ring->bufSize);
+	buf->len = ring->bufSize;
+	buf->bid = bid;
+	ring->bufTail++;
+}
+
+
+uring_t* uring_create(unsigned entries, int nbufs, int bufSize)
+{
+	struct io_uring_params p;
+	memset(&p, 0, sizeof(p));
+	int fd = uring_setup(entries, &p);
+	if (fd < 0)
+		return NULL;
+
+	uring_t* ring = (uring_t*)calloc(1, sizeof(uring_t));
+	ring->fd = fd;
+	ring->sqRingSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	ring->cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	ring->sqesSize = p.sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqRing = mmap(NULL, ring->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	ring->cqRing = mmap(NULL, ring->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+	ring->sqes = mmap(NULL, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	if (ring->sqRing == MAP_FAILED || ring->cqRing == MAP_FAILED || ring->sqes == MAP_FAILED) {
+		uring_destroy(ring);
+		return NULL;
+	}
+	char* sq = (char*)ring->sqRing;
+	char* cq = (char*)ring->cqRing;
+	ring->sqHead = (unsigned*)(sq + p.sq_off.head);
+	ring->sqTail = (unsigned*)(sq + p.sq_off.tail);
+	ring->sqMask = *(unsigned*)(sq + p.sq_off.ring_mask);
+	ring->sqArray = (unsigned*)(sq + p.sq_off.array);
+	ring->cqHead = (unsigned*)(cq + p.cq_off.head);
+	ring->cqTail = (unsigned*)(cq + p.cq_off.tail);
+	ring->cqMask = *(unsigned*)(cq + p.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+	pthread_mutex_init(&ring->sqMutex, NULL);
+
+	// 注册报文缓冲池
+	ring->nbufs = nbufs;
+	ring->bufSize = bufSize;
+	ring->bufRingSize = nbufs * sizeof(struct io_uring_buf);
+	ring->bufRing = mmap(NULL, ring->bufRingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	ring->pool = (char*)malloc((size_t)nbufs * bufSize);
+	if (ring->bufRing == MAP_FAILED) {
+		ring->bufRing = NULL;
+		uring_destroy(ring);
+		return NULL;
+	}
+	struct io_uring_buf_reg reg;
+	memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = (unsigned long)ring->bufRing;
+	reg.ring_entries = nbufs;
+	reg.bgid = URING_BGID;
+	if (uring_register(fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+		munmap(ring->bufRing, ring->bufRingSize);
+		ring->bufRing = NULL;
+		uring_destroy(ring);
+		return NULL;
+	}
+	for (int i = 0; i < nbufs; i++)
+		putbuf(ring, i);
+	__atomic_store_n(&ring->bufRing->tail, ring->bufTail, __ATOMIC_RELEASE);
+	return ring;
+}
+
+void uring_destroy(uring_t* ring)
+{
+	if (ring->bufRing) {
+		struct io_uring_buf_reg reg;
+		memset(&reg, 0, sizeof(reg));
+		reg.bgid = URING_BGID;
+		uring_register(ring->fd, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+		munmap(ring->bufRing, ring->bufRingSize);
+	}
+	if (ring->sqes && ring->sqes != MAP_FAILED)
+		munmap(ring->sqes, ring->sqesSize);
+	if (ring->cqRing && ring->cqRing != MAP_FAILED)
+		munmap(ring->cqRing, ring->cqRingSize);
+	if (ring->sqRing && ring->sqRing != MAP_FAILED)
+		munmap(ring->sqRing, ring->sqRingSize);
+	close(ring->fd);
+	free(ring->pool);
+	free(ring);
+}
+
+// 把请求src放入提交队列并提交, 成功返回1, 否则返回-1
+static int submit(uring_t* ring, struct io_uring_sqe* src)
+{
+	pthread_mutex_lock(&ring->sqMutex);
+	unsigned tail = *ring->sqTail;
+	if (tail - __atomic_load_n(ring->sqHead, __ATOMIC_ACQUIRE) > ring->sqMask) {
+		pthread_mutex_unlock(&ring->sqMutex);
+		return -1;
+	}
+	unsigned idx = tail & ring->sqMask;
+	ring->sqes[idx] = *src;
+	ring->sqArray[idx] = idx;
+	__atomic_store_n(ring->sqTail, tail + 1, __ATOMIC_RELEASE);
+	int n;
+	while ((n = uring_enter(ring->fd, 1, 0, 0, NULL, 0)) < 0 && errno == EINTR)
+		;
+	pthread_mutex_unlock(&ring->sqMutex);
+	return n == 1 ? 1 : -1;
+}
+
+int uring_recv_multishot(uring_t* ring, int fd, unsigned long long user_data)
+{
+	struct io_uring_sqe sqe;
+	memset(&sqe, 0, sizeof(sqe));
+	sqe.opcode = IORING_OP_RECV;
+	sqe.fd = fd;
+	sqe.ioprio = IORING_RECV_MULTISHOT;
+	sqe.flags = IOSQE_BUFFER_SELECT;
+	sqe.buf_group = URING_BGID;
+	sqe.user_data = user_data;
+	return submit(ring, &sqe);
+}
+
+int uring_nop(uring_t* ring, unsigned long long user_data)
+{
+	struct io_uring_sqe sqe;
+	memset(&sqe, 0, sizeof(sqe));
+	sqe.opcode = IORING_OP_NOP;
+	sqe.fd = -1;
+	sqe.user_data = user_data;
+	return submit(ring, &sqe);
+}
+
+int uring_cancel(uring_t* ring, unsigned long long user_data)
+{
+	struct io_uring_sqe sqe;
+	memset(&sqe, 0, sizeof(sqe));
+	sqe.opcode = IORING_OP_ASYNC_CANCEL;
+	sqe.fd = -1;
+	sqe.addr = user_data;
+	sqe.user_data = URING_CANCEL_DATA;
+	return submit(ring, &sqe);
+}
+
+int uring_wait(uring_t* ring, uring_cqe_t* cqes, int max, int timeoutMs)
+{
+	unsigned head = *ring->cqHead;
+	if (head == __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE)) {
+		// 完成队列为空, 在内核中等待
+		struct __kernel_timespec ts = {.tv_sec = timeoutMs / 1000, .tv_nsec = (timeoutMs % 1000) * 1000000L};
+		struct io_uring_getevents_arg arg;
+		memset(&arg, 0, sizeof(arg));
+		arg.sigmask_sz = _NSIG / 8;
+		arg.ts = (unsigned long)&ts;
+		if (uring_enter(ring->fd, 0, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg)) < 0) {
+			if (errno == ETIME || errno == EINTR)
+				return 0;
+			return -1;
+		}
+	}
+	int n = 0;
+	unsigned tail = __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE);
+	for (; head != tail && n < max; head++, n++) {
+		struct io_uring_cqe* cqe = &ring->cqes[head & ring->cqMask];
+		cqes[n].user_data = cqe->user_data;
+		cqes[n].res = cqe->res;
+		cqes[n].flags = cqe->flags;
+	}
+	__atomic_store_n(ring->cqHead, head, __ATOMIC_RELEASE);
+	return n;
+}
+
+char* uring_buf(uring_t* ring, uring_cqe_t* cqe)
+{
+	if (!(cqe->flags & IORING_CQE_F_BUFFER))
+		return NULL;
+	int bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+	return ring->pool + (size_t)bid * ring->bufSize;
+}
+
+void uring_recycle(uring_t* ring, uring_cqe_t* cqe)
+{
+	if (!(cqe->flags & IORING_CQE_F_BUFFER))
+		return;
+	putbuf(ring, cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+	__atomic_store_n(&ring->bufRing->tail, ring->bufTail, __ATOMIC_RELEASE);
+}
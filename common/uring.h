@@ -0,0 +1,146 @@
+/**
+ * @file    common/uring.h
+ * @brief   这个文件定义基于io_uring的接收后端的数据结构和API
+ * @date    2023-03-09
+ */
+
+
+#ifndef URING_H
+#define URING_H
+
+#include <pthread.h>
+#include <linux/io_uring.h>
+
+//SON进程和SIP进程可以用一个io_uring代替每个连接上的阻塞recv()接收报文.
+//每个连接上提交一个多发(multishot)接收请求, 内核每收到一批数据就从报文缓冲池中取出一个缓冲区,
+//填入数据后产生一个完成事件. 一次io_uring_enter()系统调用可以收取多个连接上的多个完成事件.
+//报文缓冲池通过提供缓冲区环(provided buffer ring)注册给内核, 缓冲区被处理后放回环中.
+//不直接依赖liburing, 而是通过系统调用和共享内存环实现.
+
+typedef struct uring {
+	int fd;                         //io_uring的文件描述符
+	unsigned* sqHead;               //提交队列环
+	unsigned* sqTail;
+	unsigned sqMask;
+	unsigned* sqArray;
+	struct io_uring_sqe* sqes;
+	unsigned* cqHead;               //完成队列环
+	unsigned* cqTail;
+	unsigned cqMask;
+	struct io_uring_cqe* cqes;
+	void* sqRing;                   //映射的内存区域
+	size_t sqRingSize;
+	void* cqRing;
+	size_t cqRingSize;
+	size_t sqesSize;
+	struct io_uring_buf_ring* bufRing;  //提供缓冲区环
+	size_t bufRingSize;
+	char* pool;                     //报文缓冲池
+	int nbufs;                      //缓冲区个数, 是2的幂
+	int bufSize;                    //每个缓冲区的字节数
+	unsigned short bufTail;         //缓冲区环的本地尾指针
+	pthread_mutex_t sqMutex;        //提交队列互斥量, 允许其他线程提交请求
+} uring_t;
+
+//完成事件, 由uring_wait()从完成队列中复制出来
+typedef struct uringcqe {
+	unsigned long long user_data;   //提交请求时指定的user_data
+	int res;                        //接收的字节数, 0表示连接关闭, 负数是-errno
+	unsigned flags;                 //IORING_CQE_F_*标志
+} uring_cqe_t;
+
+//使用缓冲池的缓冲区组ID
+#define URING_BGID 0
+//取消请求本身的完成事件的user_data, 调用者收到后应忽略它
+#define URING_CANCEL_DATA (~0ULL)
+
+
+/**
+ * @brief   这个函数创建一个有entries个提交队列条目的io_uring, 并注册nbufs个bufSize字节的报文缓冲区.
+ *          nbufs必须是2的幂. 如果内核不支持io_uring或提供缓冲区环, 返回NULL, 调用者应使用阻塞接收.
+ * 
+ * @param entries 
+ * @param nbufs 
+ * @param bufSize 
+ * @return uring_t* 
+ */
+uring_t* uring_create(unsigned entries, int nbufs, int bufSize);
+
+
+/**
+ * @brief   这个函数注销缓冲池, 关闭io_uring并释放所有内存.
+ * 
+ * @param ring 
+ */
+void uring_destroy(uring_t* ring);
+
+
+/**
+ * @brief   这个函数在套接字fd上提交一个多发接收请求, 它的完成事件都带有user_data.
+ *          每个完成事件的res是接收的字节数(0表示连接关闭, 负数是-errno), 
+ *          数据在uring_buf()返回的缓冲区中. 完成事件的flags中没有IORING_CQE_F_MORE时请求已经结束,
+ *          调用者需要重新提交. 可以在任何线程中调用. 成功返回1, 否则返回-1.
+ * 
+ * @param ring 
+ * @param fd 
+ * @param user_data 
+ * @return int 
+ */
+int uring_recv_multishot(uring_t* ring, int fd, unsigned long long user_data);
+
+
+/**
+ * @brief   这个函数提交一个空请求, 它立即产生一个带user_data的完成事件, 用来唤醒调用uring_wait()的线程.
+ *          内核在一个线程退出时取消这个线程提交的所有未完成的请求, 所以短暂的线程不应自己提交接收请求,
+ *          而是用这个函数让调用uring_wait()的线程提交. 可以在任何线程中调用. 成功返回1, 否则返回-1.
+ * @param ring 
+ * @param user_data 
+ * @return int 
+ */
+int uring_nop(uring_t* ring, unsigned long long user_data);
+
+
+/**
+ * @brief   这个函数取消user_data对应的请求. 被取消的多发接收请求以res为-ECANCELED的完成事件结束.
+ *          关闭UDP套接字的接收方向不会结束它上面的接收请求, 需要用这个函数取消.
+ *          取消请求本身也产生一个user_data为URING_CANCEL_DATA的完成事件. 可以在任何线程中调用.
+ *          成功提交返回1, 否则返回-1.
+ * @param ring 
+ * @param user_data 
+ * @return int 
+ */
+int uring_cancel(uring_t* ring, unsigned long long user_data);
+
+
+/**
+ * @brief   这个函数等待至少一个完成事件, 最多等待timeoutMs毫秒, 然后把最多max个完成事件复制到cqes中.
+ *          返回复制的完成事件数, 超时返回0, 出错返回-1. 只能在一个线程中调用.
+ * 
+ * @param ring 
+ * @param cqes 
+ * @param max 
+ * @param timeoutMs 
+ * @return int 
+ */
+int uring_wait(uring_t* ring, uring_cqe_t* cqes, int max, int timeoutMs);
+
+
+/**
+ * @brief   这个函数返回完成事件使用的缓冲区, 没有使用缓冲区时返回NULL.
+ * 
+ * @param ring 
+ * @param cqe 
+ * @return char* 
+ */
+char* uring_buf(uring_t* ring, uring_cqe_t* cqe);
+
+
+/**
+ * @brief   这个函数把完成事件使用的缓冲区放回缓冲池. 只能在调用uring_wait()的线程中调用.
+ * 
+ * @param ring 
+ * @param cqe 
+ */
+void uring_recycle(uring_t* ring, uring_cqe_t* cqe);
+
+#endif
@@ -92,6 +92,8 @@ int stcp_server_sock(unsigned int server_port)
 	int sockfd = newTcb(server_port);
 	if (sockfd == -1)
 		return -1;
+	// 在SIP进程注册端口, 同一个节点上可以有多个STCP进程
+	sip_bindport(sip_conn, server_port, 1);
 	
 	server_tcb_t* tcb = getTcb(sockfd);
 
@@ -106,6 +108,9 @@ int stcp_server_sock(unsigned int server_port)
 	assert(recvBuf != NULL);
 	tcb->recvBuf = recvBuf;
 	tcb->usedBufLen = 0;
+	tcb->groupBuf = (char*) malloc(MCAST_RECVBUF_SIZE);
+	assert(tcb->groupBuf != NULL);
+	tcb->groupBufLen = 0;
 	// 为接收缓冲区创建互斥量
 	pthread_mutex_t* sendBuf_mutex;
 	sendBuf_mutex = (pthread_mutex_t*) malloc(sizeof(pthread_mutex_t));
@@ -216,7 +221,9 @@ int stcp_server_close(int sockfd)
 	
   	switch (serverTcb->state) {
     	case CLOSED:
+			sip_bindport(sip_conn, serverTcb->server_portNum, 0);
 			free(serverTcb->recvBuf);
+			free(serverTcb->groupBuf);
 			free(serverTcb->bufMutex);
       		free(tcbTable[sockfd]);
       		tcbTable[sockfd] = NULL;
@@ -232,6 +239,57 @@ int stcp_server_close(int sockfd)
   	}
 }
 
+// 加入或离开组播组
+//
+// 向本地SIP进程发送发往组地址的MJOIN/MLEAVE段, 组成员关系由SIP进程维护.
+//
+static int sendgroupseg(int group, unsigned short type)
+{
+	if (group < 0 || group >= MCAST_MAX_GROUPS)
+		return -1;
+	seg_t seg;
+	memset(&seg, 0, sizeof(seg));
+	seg.header.type = type;
+	return sip_sendseg(sip_conn, MCAST_BASE + group, &seg) < 0 ? -1 : 1;
+}
+
+int stcp_server_join(int group)
+{
+	return sendgroupseg(group, MJOIN);
+}
+
+int stcp_server_leave(int group)
+{
+	return sendgroupseg(group, MLEAVE);
+}
+
+// 接收组播数据报
+//
+// 从组播接收缓冲区取出最早的一个数据报, 没有数据报时每RECVBUF_POLLING_INTERVAL秒检查一次.
+//
+int stcp_server_recvgroup(int sockfd, void* buf, unsigned int length)
+{
+	server_tcb_t* serverTcb = getTcb(sockfd);
+	if (!serverTcb)
+		return -1;
+
+	while (1) {
+		pthread_mutex_lock(serverTcb->bufMutex);
+		if (serverTcb->groupBufLen > 0) {
+			unsigned short len;
+			memcpy(&len, serverTcb->groupBuf, sizeof(len));
+			unsigned int n = len < length ? len : length;
+			memcpy(buf, serverTcb->groupBuf + sizeof(len), n);
+			serverTcb->groupBufLen -= sizeof(len) + len;
+			memmove(serverTcb->groupBuf, serverTcb->groupBuf + sizeof(len) + len, serverTcb->groupBufLen);
+			pthread_mutex_unlock(serverTcb->bufMutex);
+			return n;
+		}
+		pthread_mutex_unlock(serverTcb->bufMutex);
+		select(0, 0, 0, 0, &(struct timeval){.tv_sec = RECVBUF_POLLING_INTERVAL});
+	}
+}
+
 // 处理进入段的线程
 //
 // 这是由stcp_server_init()启动的线程. 它处理所有来自客户端的进入数据. seghandler被设计为一个调用sip_recvseg()的无穷循环, 
@@ -258,6 +316,21 @@ void *seghandler(void* arg) {
 			continue;
 		}
 
+		// 组播数据报不属于任何连接, 在任何状态下都放进组播接收缓冲区. 缓冲区满时丢弃, 不确认
+		if (segBuf.header.type == MDATA) {
+			unsigned short len = segBuf.header.length;
+			pthread_mutex_lock(serverTcb->bufMutex);
+			if (len <= MAX_SEG_LEN && serverTcb->groupBufLen + sizeof(len) + len <= MCAST_RECVBUF_SIZE) {
+				memcpy(serverTcb->groupBuf + serverTcb->groupBufLen, &len, sizeof(len));
+				memcpy(serverTcb->groupBuf + serverTcb->groupBufLen + sizeof(len), segBuf.data, len);
+				serverTcb->groupBufLen += sizeof(len) + len;
+			} else {
+				printf("SERVER: GROUP RECEIVE BUFFER IS FULL, DROP MDATA SEG\n");
+			}
+			pthread_mutex_unlock(serverTcb->bufMutex);
+			continue;
+		}
+
 		// 段处理
 		pthread_mutex_lock(&tcbTable_mutex);
 		switch (serverTcb->state) {
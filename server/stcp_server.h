@@ -29,6 +29,8 @@ typedef struct server_tcb {
 	char* recvBuf;                  //指向接收缓冲区的指针
 	unsigned int  usedBufLen;       //接收缓冲区中已接收数据的大小
 	pthread_mutex_t* bufMutex;      //指向一个互斥量的指针, 该互斥量用于对接收缓冲区的访问
+	char* groupBuf;                 //组播接收缓冲区, 每个组播数据报前有2字节的长度, 也由bufMutex保护
+	unsigned int groupBufLen;       //组播接收缓冲区中已接收数据的大小
 } server_tcb_t;
 
 
@@ -95,6 +97,40 @@ int stcp_server_recv(int sockfd, void* buf, unsigned int length);
 int stcp_server_close(int sockfd);
 
 
+/**
+ * @brief	这个函数使本节点加入组播组group.
+ * @details	它向本地SIP进程发送一个发往组地址MCAST_BASE+group的MJOIN段, 由SIP进程向重叠网络通告组成员关系.
+ * 			之后其他节点用stcp_client_sendgroup()发往这个组的数据报交给本节点, 用stcp_server_recvgroup()接收.
+ * 			成功时返回1, 失败时返回-1.
+ * 
+ * @param group 
+ * @return int 
+ */
+int stcp_server_join(int group);
+
+
+/**
+ * @brief	这个函数接收一个发往这个套接字的端口的组播数据报.
+ * @details	组播数据报不属于任何连接, 套接字可以处于任何状态. 数据报按到达的顺序返回, 每次返回一个,
+ * 			长度超过length的部分被丢弃. 没有数据报时等待. 返回数据报中复制到buf的字节数, 失败时返回-1.
+ * 
+ * @param sockfd 
+ * @param buf 
+ * @param length 
+ * @return int 
+ */
+int stcp_server_recvgroup(int sockfd, void* buf, unsigned int length);
+
+
+/**
+ * @brief	这个函数使本节点离开组播组group. 成功时返回1, 失败时返回-1.
+ * 
+ * @param group 
+ * @return int 
+ */
+int stcp_server_leave(int group);
+
+
 /**
  * @brief 
  * @details	这是由stcp_server_init()启动的线程. 它处理所有来自客户端的进入数据. 
@@ -0,0 +1,164 @@
+/**
+ * @file    sip/adverttable.c
+ * @brief   这个文件实现用于路由通告表的数据结构和函数.
+ * @date    2023-03-26
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "../common/constants.h"
+#include "../topology/topology.h"
+#include "adverttable.h"
+
+
+// 返回邻居nodeID的条目, 不是邻居时返回NULL
+static advert_entry_t* findnbr(adverttable_t* at, int nodeID)
+{
+    for (int i = 0; i < at->nbrNum; i++)
+        if (at->nbr[i].nodeID == nodeID)
+            return &at->nbr[i];
+    return NULL;
+}
+
+// 条目的重传计时器是否已经到期
+static int due(advert_entry_t* e, long now)
+{
+    long rto = ROUTEUPDATE_RETRANSMIT;
+    for (int i = 0; i < e->retries && rto < ROUTEUPDATE_INTERVAL * 1000L; i++)
+        rto *= 2;
+    if (rto > ROUTEUPDATE_INTERVAL * 1000L)
+        rto = ROUTEUPDATE_INTERVAL * 1000L;
+    return e->pending && now - e->sentAt >= rto;
+}
+
+
+adverttable_t* adverttable_create(int nodeNum)
+{
+    int* nbrArr = topology_getNbrArray();
+    adverttable_t* at = (adverttable_t*)malloc(sizeof(adverttable_t));
+    assert(at != NULL);
+    at->nbrNum = topology_getNbrNum();
+    at->nodeNum = nodeNum;
+    at->nbr = (advert_entry_t*)malloc(sizeof(advert_entry_t) * (at->nbrNum > 0 ? at->nbrNum : 1));
+    for (int i = 0; i < at->nbrNum; i++) {
+        advert_entry_t* e = &at->nbr[i];
+        e->nodeID = nbrArr[i];
+        e->acked = 0;
+        e->ackedSeq = 0;
+        e->pending = 0;
+        e->sentSeq = 0;
+        e->sentAt = 0;
+        e->retries = 0;
+        e->ackedCost = (unsigned int*)malloc(sizeof(unsigned int) * (nodeNum > 0 ? nodeNum : 1));
+        e->sentCost = (unsigned int*)malloc(sizeof(unsigned int) * (nodeNum > 0 ? nodeNum : 1));
+        e->touched = (unsigned char*)calloc(nodeNum > 0 ? nodeNum : 1, 1);
+    }
+    free(nbrArr);
+    return at;
+}
+
+
+void adverttable_destroy(adverttable_t* at)
+{
+    for (int i = 0; i < at->nbrNum; i++) {
+        free(at->nbr[i].ackedCost);
+        free(at->nbr[i].sentCost);
+        free(at->nbr[i].touched);
+    }
+    free(at->nbr);
+    free(at);
+}
+
+
+int adverttable_delta(adverttable_t* at, int nbrNodeID, routeupdate_entry_t* advert, routeupdate_entry_t* delta, unsigned int* base, int* full)
+{
+    advert_entry_t* e = findnbr(at, nbrNodeID);
+    if (e == NULL)
+        return -1;
+    if (!e->acked) {
+        memcpy(delta, advert, sizeof(routeupdate_entry_t) * at->nodeNum);
+        *full = 1;
+        *base = 0;
+        return at->nodeNum;
+    }
+    int n = 0;
+    for (int j = 0; j < at->nodeNum; j++)
+        if (advert[j].cost != e->ackedCost[j] || e->touched[j])
+            delta[n++] = advert[j];
+    *full = 0;
+    *base = e->ackedSeq;
+    // 没有确认的版本与确认的版本相同, 不需要再确认
+    if (n == 0)
+        e->pending = 0;
+    return n;
+}
+
+
+void adverttable_sent(adverttable_t* at, int nbrNodeID, routeupdate_entry_t* advert, unsigned int seq, long now)
+{
+    advert_entry_t* e = findnbr(at, nbrNodeID);
+    if (e == NULL)
+        return;
+    for (int j = 0; j < at->nodeNum; j++) {
+        e->sentCost[j] = advert[j].cost;
+        if (e->acked && advert[j].cost != e->ackedCost[j])
+            e->touched[j] = 1;
+    }
+    // 上一次发送的版本还没有确认, 这次是重传
+    e->retries = e->pending ? e->retries + 1 : 0;
+    e->pending = 1;
+    e->sentSeq = seq;
+    e->sentAt = now;
+}
+
+
+void adverttable_ack(adverttable_t* at, int nbrNodeID, unsigned int seq, int resync)
+{
+    advert_entry_t* e = findnbr(at, nbrNodeID);
+    if (e == NULL)
+        return;
+    if (resync) {
+        adverttable_reset(at, nbrNodeID);
+        return;
+    }
+    if (!e->pending || seq != e->sentSeq)
+        return;
+    memcpy(e->ackedCost, e->sentCost, sizeof(unsigned int) * at->nodeNum);
+    memset(e->touched, 0, at->nodeNum);
+    e->acked = 1;
+    e->ackedSeq = seq;
+    e->pending = 0;
+    e->retries = 0;
+}
+
+
+void adverttable_reset(adverttable_t* at, int nbrNodeID)
+{
+    advert_entry_t* e = findnbr(at, nbrNodeID);
+    if (e == NULL)
+        return;
+    e->acked = 0;
+    // 下一次发送完整的距离矢量, 之前的版本不再等待确认
+    e->pending = 0;
+    e->retries = 0;
+    memset(e->touched, 0, at->nodeNum);
+}
+
+
+int adverttable_isdue(adverttable_t* at, int nbrNodeID, long now)
+{
+    advert_entry_t* e = findnbr(at, nbrNodeID);
+    return e != NULL && due(e, now);
+}
+
+
+int adverttable_due(adverttable_t* at, long now)
+{
+    int n = 0;
+    for (int i = 0; i < at->nbrNum; i++)
+        n += due(&at->nbr[i], now);
+    return n;
+}
@@ -0,0 +1,131 @@
+/**
+ * @file    sip/adverttable.h
+ * @brief   这个文件定义用于路由通告表的数据结构和函数.
+ * @date    2023-03-26
+ */
+
+
+#ifndef ADVERTTABLE_H
+#define ADVERTTABLE_H
+
+#include "../common/pkt.h"
+
+
+//路由通告表条目, 每个邻居一个.
+//记录邻居最近确认的路由更新版本中每个目的节点的代价, 之后发给这个邻居的路由更新只包含与它相比改变了的条目.
+//确认的版本之后发送过的条目也被包含在增量中, 这样无论邻居使用了哪个没有确认的版本, 使用增量后都与发送方一致.
+//条目按距离矢量表的列号存放.
+typedef struct advertentry {
+	int nodeID;                     //邻居的节点ID
+	int acked;                      //邻居是否确认过路由更新, 为0时下一次发送完整的距离矢量
+	unsigned int ackedSeq;          //邻居最近确认的版本
+	unsigned int* ackedCost;        //ackedCost[j]是确认的版本中到第j列的代价
+	int pending;                    //是否有还没有确认的路由更新
+	unsigned int sentSeq;           //最近发送的路由更新的序号
+	long sentAt;                    //最近发送路由更新的时刻(毫秒)
+	int retries;                    //没有确认的路由更新已经重传的次数, 每次重传后重传间隔加倍
+	unsigned int* sentCost;         //sentCost[j]是最近发送的版本中到第j列的代价
+	unsigned char* touched;         //touched[j]为1表示确认的版本之后发送过第j列的不同代价
+} advert_entry_t;
+
+typedef struct adverttable {
+	int nbrNum;                     //邻居数
+	int nodeNum;                    //每个邻居的条目数, 即距离矢量表的列数
+	advert_entry_t* nbr;            //每个邻居一个条目
+} adverttable_t;
+
+
+/**
+ * @brief   这个函数动态创建路由通告表, 每个邻居一个条目, nodeNum是距离矢量表的列数.
+ *          所有邻居都还没有确认过路由更新, 所以第一次发送完整的距离矢量.
+ * 
+ * @param nodeNum 
+ * @return adverttable_t* 
+ */
+adverttable_t* adverttable_create(int nodeNum);
+
+
+/**
+ * @brief   这个函数删除路由通告表.
+ *          它释放所有为路由通告表动态分配的内存.
+ * 
+ * @param at 
+ */
+void adverttable_destroy(adverttable_t* at);
+
+
+/**
+ * @brief   这个函数根据发给邻居nbrNodeID的完整路由更新advert(nodeNum个条目, 按列号排列)生成增量, 写入delta并返回条目数.
+ * @details 邻居还没有确认过路由更新时, 增量就是完整的距离矢量, full被设为1.
+ *          否则full为0, base被设为邻居确认的版本, 增量为空时也不再有需要确认的路由更新.
+ *          邻居不存在时返回-1.
+ * 
+ * @param at 
+ * @param nbrNodeID 
+ * @param advert 
+ * @param delta 
+ * @param base 
+ * @param full 
+ * @return int 
+ */
+int adverttable_delta(adverttable_t* at, int nbrNodeID, routeupdate_entry_t* advert, routeupdate_entry_t* delta, unsigned int* base, int* full);
+
+
+/**
+ * @brief   这个函数在now时刻(毫秒)把advert的增量作为序号为seq的路由更新发给邻居nbrNodeID后调用, 记录发送的版本, 并启动重传计时器.
+ * 
+ * @param at 
+ * @param nbrNodeID 
+ * @param advert 
+ * @param seq 
+ * @param now 
+ */
+void adverttable_sent(adverttable_t* at, int nbrNodeID, routeupdate_entry_t* advert, unsigned int seq, long now);
+
+
+/**
+ * @brief   这个函数在收到邻居nbrNodeID的路由更新确认报文时调用.
+ *          确认了最近发送的版本时, 它成为之后增量的基准版本. 更早的版本的确认被忽略.
+ *          resync为1时邻居不能使用增量, 下一次发送完整的距离矢量.
+ * 
+ * @param at 
+ * @param nbrNodeID 
+ * @param seq 
+ * @param resync 
+ */
+void adverttable_ack(adverttable_t* at, int nbrNodeID, unsigned int seq, int resync);
+
+
+/**
+ * @brief   这个函数使下一次发给邻居nbrNodeID的路由更新是完整的距离矢量, 在邻居重新连接或失效时调用.
+ *          之前发送的路由更新不再等待确认, 链路断开或者SIP进程没有运行的邻居不会被一直重传.
+ * 
+ * @param at 
+ * @param nbrNodeID 
+ */
+void adverttable_reset(adverttable_t* at, int nbrNodeID);
+
+
+/**
+ * @brief   这个函数返回在now时刻(毫秒)发给邻居nbrNodeID的路由更新是否需要重传.
+ *          路由更新没有确认, 并且从最近一次发送起已经过了重传间隔时返回1.
+ *          重传间隔从ROUTEUPDATE_RETRANSMIT毫秒开始, 每次重传后加倍, 最多ROUTEUPDATE_INTERVAL秒.
+ * 
+ * @param at 
+ * @param nbrNodeID 
+ * @param now 
+ * @return int 
+ */
+int adverttable_isdue(adverttable_t* at, int nbrNodeID, long now);
+
+
+/**
+ * @brief   这个函数返回在now时刻(毫秒)需要重传路由更新的邻居数.
+ * 
+ * @param at 
+ * @param now 
+ * @return int 
+ */
+int adverttable_due(adverttable_t* at, long now);
+
+#endif
@@ -0,0 +1,172 @@
+/**
+ * @file    sip/apptable.c
+ * @brief   这个文件实现用于本地STCP进程表的数据结构和函数.
+ * @date    2023-04-02
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include "apptable.h"
+
+
+apptable_t* apptable_create()
+{
+    apptable_t* at = (apptable_t*)malloc(sizeof(apptable_t));
+    assert(at != NULL);
+    for (int i = 0; i < SIP_MAX_APPS; i++) {
+        at->app[i].conn = -1;
+        at->app[i].portNum = 0;
+        at->app[i].segsIn = 0;
+        at->app[i].segsOut = 0;
+        at->app[i].outBuf = NULL;
+        at->app[i].outLen = 0;
+        at->app[i].segsDropped = 0;
+        pthread_mutex_init(&at->app[i].sendMutex, NULL);
+    }
+    at->owner = (short*)malloc(sizeof(short) * STCP_MAX_PORT);
+    assert(at->owner != NULL);
+    for (int port = 0; port < STCP_MAX_PORT; port++)
+        at->owner[port] = -1;
+    at->unbound = 0;
+    return at;
+}
+
+
+void apptable_destroy(apptable_t* at)
+{
+    for (int i = 0; i < SIP_MAX_APPS; i++) {
+        free(at->app[i].outBuf);
+        pthread_mutex_destroy(&at->app[i].sendMutex);
+    }
+    free(at->owner);
+    free(at);
+}
+
+
+int apptable_add(apptable_t* at, int conn)
+{
+    for (int i = 0; i < SIP_MAX_APPS; i++) {
+        if (at->app[i].conn < 0) {
+            at->app[i].conn = conn;
+            at->app[i].portNum = 0;
+            at->app[i].segsIn = 0;
+            at->app[i].segsOut = 0;
+            at->app[i].segsDropped = 0;
+            at->app[i].outLen = 0;
+            // 发送缓存在条目第一次使用时分配, 以后的STCP进程重用它
+            if (at->app[i].outBuf == NULL) {
+                at->app[i].outBuf = (char*)malloc(SIP_APP_QUEUE * SEG_FRAME_LEN);
+                assert(at->app[i].outBuf != NULL);
+            }
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+int apptable_remove(apptable_t* at, int idx)
+{
+    int conn = at->app[idx].conn;
+    // 进程退出时不一定注销了端口, 在这里全部注销
+    for (int port = 0; port < STCP_MAX_PORT && at->app[idx].portNum > 0; port++) {
+        if (at->owner[port] == idx) {
+            at->owner[port] = -1;
+            at->app[idx].portNum--;
+        }
+    }
+    at->app[idx].conn = -1;
+    at->app[idx].portNum = 0;
+    at->app[idx].outLen = 0;
+    return conn;
+}
+
+
+int apptable_bind(apptable_t* at, int idx, unsigned int port)
+{
+    if (port >= STCP_MAX_PORT)
+        return -1;
+    if (at->owner[port] == idx)
+        return 0;
+    if (at->owner[port] >= 0)
+        return -1;
+    at->owner[port] = idx;
+    at->app[idx].portNum++;
+    return 1;
+}
+
+
+int apptable_unbind(apptable_t* at, int idx, unsigned int port)
+{
+    if (port >= STCP_MAX_PORT || at->owner[port] != idx)
+        return 0;
+    at->owner[port] = -1;
+    at->app[idx].portNum--;
+    return 1;
+}
+
+
+int apptable_lookup(apptable_t* at, unsigned int port)
+{
+    return port < STCP_MAX_PORT ? at->owner[port] : -1;
+}
+
+
+int apptable_send(apptable_t* at, int idx, int src_nodeID, seg_t* seg)
+{
+    stcp_app_t* app = &at->app[idx];
+    int full = (SIP_APP_QUEUE - 1) * (int)SEG_FRAME_LEN;
+    // 缓存满时先腾出STCP进程已经读走的空间, 仍然是满的才丢弃
+    if (app->outLen > full && apptable_flush(at, idx) > full) {
+        app->segsDropped++;
+        return 0;
+    }
+    app->outLen += seg_frame(src_nodeID, seg, app->outBuf + app->outLen);
+    app->segsOut++;
+    apptable_flush(at, idx);
+    return 1;
+}
+
+
+int apptable_flush(apptable_t* at, int idx)
+{
+    stcp_app_t* app = &at->app[idx];
+    int sent = 0;
+    while (sent < app->outLen) {
+        int n = send(app->conn, app->outBuf + sent, app->outLen - sent, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n > 0) {
+            sent += n;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        } else {
+            // 连接断开, 缓存中的段不会再被读走
+            app->outLen = 0;
+            return 0;
+        }
+    }
+    if (sent > 0) {
+        memmove(app->outBuf, app->outBuf + sent, app->outLen - sent);
+        app->outLen -= sent;
+    }
+    return app->outLen;
+}
+
+
+void apptable_print(apptable_t* at)
+{
+    printf("-------------STCP PROCESSES----------\n");
+    for (int i = 0; i < SIP_MAX_APPS; i++) {
+        stcp_app_t* app = &at->app[i];
+        if (app->conn >= 0)
+            printf("APP[%d]: CONN: %d | PORTS: %d | SEGS IN: %lu | SEGS OUT: %lu | DROPPED: %lu | QUEUED: %d\n", i, app->conn, app->portNum, app->segsIn, app->segsOut, app->segsDropped, app->outLen / (int)SEG_FRAME_LEN);
+    }
+    printf("UNBOUND PORT DROPS: %lu\n", at->unbound);
+    printf("-------------------------------------\n");
+}
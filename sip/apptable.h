@@ -0,0 +1,139 @@
+/**
+ * @file    sip/apptable.h
+ * @brief   这个文件定义用于本地STCP进程表的数据结构和函数.
+ * @date    2023-04-02
+ */
+
+
+#ifndef APPTABLE_H
+#define APPTABLE_H
+
+#include <pthread.h>
+#include "../common/constants.h"
+#include "../common/seg.h"
+
+
+//本地STCP进程表条目, 每个连接到SIP进程的STCP进程一个.
+typedef struct stcpapp {
+	int conn;                   //到这个STCP进程的连接, 空闲的条目为-1
+	pthread_mutex_t sendMutex;  //向这个STCP进程转交段的互斥量, 不同的STCP进程可以同时转交
+	int portNum;                //这个STCP进程注册的端口数
+	unsigned long segsIn;       //从这个STCP进程收到的段数
+	unsigned long segsOut;      //交给这个STCP进程的段数
+	char* outBuf;               //还没有写出的段帧, 最多SIP_APP_QUEUE个, 由sendMutex保护
+	int outLen;                 //outBuf中的字节数
+	unsigned long segsDropped;  //因为发送缓存已满而丢弃的发给这个STCP进程的段数
+} stcp_app_t;
+
+//本地STCP进程表记录所有连接到SIP进程的STCP进程, 以及每个端口属于哪个STCP进程.
+//进入的段按目的端口交给注册了这个端口的STCP进程. 一个端口同时只属于一个STCP进程.
+typedef struct apptable {
+	stcp_app_t app[SIP_MAX_APPS];
+	short* owner;               //owner[port]是注册了端口port的STCP进程的下标, 没有时为-1, 共STCP_MAX_PORT个条目
+	unsigned long unbound;      //因为目的端口没有注册而被丢弃的段数
+} apptable_t;
+
+
+/**
+ * @brief   这个函数动态创建本地STCP进程表, 所有条目都是空闲的, 所有端口都没有注册.
+ *
+ * @return apptable_t*
+ */
+apptable_t* apptable_create();
+
+
+/**
+ * @brief   这个函数删除本地STCP进程表.
+ *          它释放所有为本地STCP进程表动态分配的内存, 但不关闭连接.
+ *
+ * @param at
+ */
+void apptable_destroy(apptable_t* at);
+
+
+/**
+ * @brief   这个函数把连接conn上的新STCP进程加入表中, 返回它的下标. 表满时返回-1.
+ *
+ * @param at
+ * @param conn
+ * @return int
+ */
+int apptable_add(apptable_t* at, int conn);
+
+
+/**
+ * @brief   这个函数删除下标为idx的STCP进程并注销它的所有端口, 返回它的连接. 调用者负责关闭连接.
+ *
+ * @param at
+ * @param idx
+ * @return int
+ */
+int apptable_remove(apptable_t* at, int idx);
+
+
+/**
+ * @brief   这个函数为下标为idx的STCP进程注册端口port.
+ *          注册成功时返回1, 端口已经属于这个STCP进程时返回0, 端口属于其他STCP进程或者端口号无效时返回-1.
+ *
+ * @param at
+ * @param idx
+ * @param port
+ * @return int
+ */
+int apptable_bind(apptable_t* at, int idx, unsigned int port);
+
+
+/**
+ * @brief   这个函数注销下标为idx的STCP进程的端口port. 成功时返回1, 端口不属于这个STCP进程时返回0.
+ *
+ * @param at
+ * @param idx
+ * @param port
+ * @return int
+ */
+int apptable_unbind(apptable_t* at, int idx, unsigned int port);
+
+
+/**
+ * @brief   这个函数返回注册了端口port的STCP进程的下标, 没有时返回-1.
+ *
+ * @param at
+ * @param port
+ * @return int
+ */
+int apptable_lookup(apptable_t* at, unsigned int port);
+
+
+/**
+ * @brief   这个函数把来自节点src_nodeID的段组帧后放入下标为idx的STCP进程的发送缓存, 然后用非阻塞写尽量写出缓存.
+ *          缓存中已有SIP_APP_QUEUE个段时, 这个段被丢弃并计数. 调用者应持有这个STCP进程的sendMutex.
+ *          段放入缓存时返回1, 被丢弃时返回0.
+ *
+ * @param at
+ * @param idx
+ * @param src_nodeID
+ * @param seg
+ * @return int
+ */
+int apptable_send(apptable_t* at, int idx, int src_nodeID, seg_t* seg);
+
+
+/**
+ * @brief   这个函数用非阻塞写写出下标为idx的STCP进程的发送缓存, 返回缓存中还没有写出的字节数.
+ *          连接出错时清空缓存, 连接断开由接收这个STCP进程的段的线程发现. 调用者应持有这个STCP进程的sendMutex.
+ *
+ * @param at
+ * @param idx
+ * @return int
+ */
+int apptable_flush(apptable_t* at, int idx);
+
+
+/**
+ * @brief   这个函数打印所有连接的STCP进程, 它们的端口数和段数.
+ *
+ * @param at
+ */
+void apptable_print(apptable_t* at);
+
+#endif
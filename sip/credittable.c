@@ -0,0 +1,89 @@
+/**
+ * @file    sip/credittable.c
+ * @brief   这个文件实现用于下一跳信用表的数据结构和函数.
+ * @date    2023-03-06
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include "credittable.h"
+#include "../common/constants.h"
+#include "../topology/topology.h"
+
+
+credit_entry_t* credittable_create()
+{
+    int* nbrArr = topology_getNbrArray();
+    int nbrNum = topology_getNbrNum();
+    credit_entry_t* ct = (credit_entry_t*)malloc(sizeof(credit_entry_t) * nbrNum);
+    for (int i = 0; i < nbrNum; i++) {
+        ct[i].nodeID = nbrArr[i];
+        ct[i].credits = 0;
+        ct[i].busy = 0;
+    }
+    return ct;
+}
+
+
+void credittable_destroy(credit_entry_t* ct)
+{
+    if (ct)
+        free(ct);
+}
+
+
+int credittable_take(credit_entry_t* ct, int nodeID)
+{
+    int nbrNum = topology_getNbrNum();
+    for (int i = 0; i < nbrNum; i++) {
+        if (ct[i].nodeID == nodeID) {
+            if (ct[i].credits > 0) {
+                ct[i].credits--;
+                return 1;
+            }
+            ct[i].busy++;
+            return -1;
+        }
+    }
+    return -1;
+}
+
+
+void credittable_takeall(credit_entry_t* ct)
+{
+    int nbrNum = topology_getNbrNum();
+    for (int i = 0; i < nbrNum; i++)
+        ct[i].credits--;
+}
+
+
+void credittable_grant(credit_entry_t* ct, int nodeID, int credits)
+{
+    int nbrNum = topology_getNbrNum();
+    for (int i = 0; i < nbrNum; i++) {
+        if (ct[i].nodeID == nodeID) {
+            ct[i].credits += credits;
+            return;
+        }
+    }
+}
+
+
+void credittable_reset(credit_entry_t* ct)
+{
+    int nbrNum = topology_getNbrNum();
+    for (int i = 0; i < nbrNum; i++)
+        ct[i].credits = 0;
+}
+
+
+void credittable_print(credit_entry_t* ct)
+{
+    int nbrNum = topology_getNbrNum();
+    printf("------------CREDIT TABLE-------------\n");
+    for (int i = 0; i < nbrNum; i++) {
+        printf("CREDIT[%d]: [NODEID: %d | CREDITS: %d | BUSY: %lu]\n", i, ct[i].nodeID, ct[i].credits, ct[i].busy);
+    }
+    printf("-------------------------------------\n");
+}
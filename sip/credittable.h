@@ -0,0 +1,85 @@
+/**
+ * @file    sip/credittable.h
+ * @brief   这个文件定义用于下一跳信用表的数据结构和函数.
+ * @date    2023-03-06
+ */
+
+
+#ifndef CREDITTABLE_H
+#define CREDITTABLE_H
+
+//下一跳信用表条目定义
+//SIP进程每交给SON进程一个发往某个下一跳的报文, 就消耗该下一跳的一个信用.
+//SON进程把报文写到邻居链路上之后, 通过CREDIT报文返还信用.
+typedef struct creditentry {
+	int nodeID;             //邻居(下一跳)的节点ID
+	int credits;            //还可以交给SON进程发往这个下一跳的报文数, 广播可能使它小于0
+	unsigned long busy;     //因为没有信用而被丢弃的报文数
+} credit_entry_t;
+
+
+/**
+ * @brief   这个函数动态创建下一跳信用表, 每个邻居一个条目.
+ *          所有条目的信用被初始化为0, SON进程在SIP进程连接后会给出初始信用.
+ * 
+ * @return credit_entry_t* 
+ */
+credit_entry_t* credittable_create();
+
+
+/**
+ * @brief   这个函数删除下一跳信用表.
+ *          它释放所有用于下一跳信用表的动态分配内存.
+ * 
+ * @param ct 
+ */
+void credittable_destroy(credit_entry_t* ct);
+
+
+/**
+ * @brief   这个函数在把一个报文交给SON进程发往下一跳nodeID之前调用.
+ *          如果该下一跳还有信用, 就消耗一个信用并返回1. 
+ *          否则记录一次拥塞丢弃并返回-1, 如果nodeID不是邻居, 也返回-1.
+ * 
+ * @param ct 
+ * @param nodeID 
+ * @return int 
+ */
+int credittable_take(credit_entry_t* ct, int nodeID);
+
+
+/**
+ * @brief   这个函数在把一个广播报文交给SON进程之前调用.
+ *          广播报文发往每个邻居, 因此每个邻居都消耗一个信用, 信用可以因此小于0.
+ * 
+ * @param ct 
+ */
+void credittable_takeall(credit_entry_t* ct);
+
+
+/**
+ * @brief   这个函数在收到SON进程的CREDIT报文时调用, 给下一跳nodeID增加credits个信用.
+ * 
+ * @param ct 
+ * @param nodeID 
+ * @param credits 
+ */
+void credittable_grant(credit_entry_t* ct, int nodeID, int credits);
+
+
+/**
+ * @brief   这个函数在与SON进程的连接重新建立时调用, 将所有下一跳的信用清零.
+ * 
+ * @param ct 
+ */
+void credittable_reset(credit_entry_t* ct);
+
+
+/**
+ * @brief   这个函数打印下一跳信用表的内容.
+ * 
+ * @param ct 
+ */
+void credittable_print(credit_entry_t* ct);
+
+#endif
@@ -0,0 +1,96 @@
+/**
+ * @file    sip/ctrlqueue.c
+ * @brief   这个文件实现SIP进程的控制报文队列.
+ * @date    2023-03-27
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <assert.h>
+#include "ctrlqueue.h"
+
+
+ctrlqueue_t* ctrlqueue_create(int max)
+{
+	ctrlqueue_t* q = (ctrlqueue_t*)malloc(sizeof(ctrlqueue_t));
+	assert(q != NULL);
+	q->head = q->tail = NULL;
+	q->num = 0;
+	q->max = max;
+	q->dropped = q->batches = q->pkts = 0;
+	pthread_mutex_init(&q->mutex, NULL);
+	pthread_cond_init(&q->ready, NULL);
+	return q;
+}
+
+
+void ctrlqueue_destroy(ctrlqueue_t* q)
+{
+	ctrlqueue_free(q->head);
+	pthread_mutex_destroy(&q->mutex);
+	pthread_cond_destroy(&q->ready);
+	free(q);
+}
+
+
+int ctrlqueue_put(ctrlqueue_t* q, sip_pkt_t* pkt)
+{
+	if (pkt->header.length > MAX_PKT_LEN)
+		return -1;
+	ctrl_node_t* node = (ctrl_node_t*)malloc(offsetof(ctrl_node_t, pkt.data) + pkt->header.length);
+	assert(node != NULL);
+	node->next = NULL;
+	memcpy(&node->pkt, pkt, sizeof(sip_hdr_t) + pkt->header.length);
+	pthread_mutex_lock(&q->mutex);
+	if (q->num >= q->max) {
+		q->dropped++;
+		pthread_mutex_unlock(&q->mutex);
+		free(node);
+		return -1;
+	}
+	if (q->tail)
+		q->tail->next = node;
+	else
+		q->head = node;
+	q->tail = node;
+	if (q->num++ == 0)
+		pthread_cond_signal(&q->ready);
+	pthread_mutex_unlock(&q->mutex);
+	return 1;
+}
+
+
+ctrl_node_t* ctrlqueue_take(ctrlqueue_t* q, int windowMs)
+{
+	pthread_mutex_lock(&q->mutex);
+	while (q->num == 0)
+		pthread_cond_wait(&q->ready, &q->mutex);
+	pthread_mutex_unlock(&q->mutex);
+
+	// 第一个报文到达后再等待一个窗口, 期间到达的报文合并到同一批中
+	if (windowMs > 0) {
+		struct timespec ts = {windowMs / 1000, (windowMs % 1000) * 1000000L};
+		nanosleep(&ts, NULL);
+	}
+
+	pthread_mutex_lock(&q->mutex);
+	ctrl_node_t* list = q->head;
+	q->batches++;
+	q->pkts += q->num;
+	q->head = q->tail = NULL;
+	q->num = 0;
+	pthread_mutex_unlock(&q->mutex);
+	return list;
+}
+
+
+void ctrlqueue_free(ctrl_node_t* list)
+{
+	while (list) {
+		ctrl_node_t* next = list->next;
+		free(list);
+		list = next;
+	}
+}
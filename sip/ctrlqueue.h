@@ -0,0 +1,83 @@
+/**
+ * @file    sip/ctrlqueue.h
+ * @brief   这个文件定义SIP进程的控制报文队列.
+ * @date    2023-03-27
+ */
+
+
+#ifndef CTRLQUEUE_H
+#define CTRLQUEUE_H
+
+#include <pthread.h>
+#include "../common/pkt.h"
+
+//接收线程把路由报文(路由更新, 确认和LSA)放入控制报文队列后立即继续转发数据报文,
+//控制线程每次取出一批报文, 在一次加锁中处理, 路由只重新计算和发布一次.
+
+//队列中的一个报文, 只分配首部和有效数据需要的空间
+typedef struct ctrlnode {
+	struct ctrlnode* next;
+	int result;                 //控制线程处理这个报文的结果, 由使用者定义
+	sip_pkt_t pkt;
+} ctrl_node_t;
+
+typedef struct ctrlqueue {
+	ctrl_node_t* head;          //队首, 最早放入的报文
+	ctrl_node_t* tail;          //队尾
+	int num;                    //队列中的报文数
+	int max;                    //队列中最多的报文数, 满时放入的报文被丢弃
+	unsigned long dropped;      //因为队列满而丢弃的报文数
+	unsigned long batches;      //控制线程取出的批数
+	unsigned long pkts;         //控制线程取出的报文数
+	pthread_mutex_t mutex;
+	pthread_cond_t ready;       //队列从空变为非空时通知控制线程
+} ctrlqueue_t;
+
+
+/**
+ * @brief   这个函数创建一个最多容纳max个报文的控制报文队列.
+ * 
+ * @param max 
+ * @return ctrlqueue_t* 
+ */
+ctrlqueue_t* ctrlqueue_create(int max);
+
+
+/**
+ * @brief   这个函数释放控制报文队列和其中的报文.
+ * 
+ * @param q 
+ */
+void ctrlqueue_destroy(ctrlqueue_t* q);
+
+
+/**
+ * @brief   这个函数把报文复制一份放入队列. 成功返回1, 队列满时丢弃报文并返回-1.
+ *          丢失的路由报文由确认重传和周期性刷新恢复.
+ * 
+ * @param q 
+ * @param pkt 
+ * @return int 
+ */
+int ctrlqueue_put(ctrlqueue_t* q, sip_pkt_t* pkt);
+
+
+/**
+ * @brief   这个函数等待队列中有报文, 再等待windowMs毫秒让这段时间内到达的报文也进入队列,
+ *          然后取出队列中所有的报文, 按放入的顺序链接成链表返回. 链表中的报文用ctrlqueue_free()释放.
+ * 
+ * @param q 
+ * @param windowMs 
+ * @return ctrl_node_t* 
+ */
+ctrl_node_t* ctrlqueue_take(ctrlqueue_t* q, int windowMs);
+
+
+/**
+ * @brief   这个函数释放ctrlqueue_take()返回的链表.
+ * 
+ * @param list 
+ */
+void ctrlqueue_free(ctrl_node_t* list);
+
+#endif
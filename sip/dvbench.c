@@ -0,0 +1,316 @@
+/**
+ * @file    sip/dvbench.c
+ * @brief   这个文件实现距离矢量路由收敛的基准测试程序.
+ *          它在一个进程中为合成拓扑(线形或环形, 链路代价为1; 或者在环形上随机加入弦的网状拓扑, 链路代价为1到5)的每个节点创建距离矢量表,
+ *          按同步轮次模拟触发更新: 每一轮, 上一轮距离矢量变化了的节点把路由更新发给所有邻居.
+ *          先让路由收敛, 然后让节点1和节点2之间的链路断开(link), 或者让节点2崩溃(crash, 邻居在ROUTE_TIMEOUT秒后才发现),
+ *          分别在使用和不使用毒性逆转时统计重新收敛需要的轮数和路由更新报文数.
+ *          链路断开时还统计重新收敛之前, 两端只去掉断开的下一跳(改用等价下一跳或备份下一跳)时能够送达的节点对数.
+ *          路由更新经过与SIP进程相同的增量生成, 变长编码, 分片重组和确认, 统计的字节数包括确认报文,
+ *          并与每次都发送定长编码的完整距离矢量时的字节数比较.
+ *          每一轮相当于一个抑制计时器间隔(ROUTEUPDATE_HOLDDOWN毫秒).
+ *          用法: ./sip/dvbench line|ring|mesh [节点数] [link|crash]
+ *          结果输出到标准错误.
+ * @date    2023-03-25
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../common/constants.h"
+#include "../common/pkt.h"
+#include "../topology/topology.h"
+#include "dvtable.h"
+#include "rtreasm.h"
+#include "adverttable.h"
+
+//定长编码的条目和分片首部的字节数, 用于计算发送完整距离矢量时的字节数
+#define FIXED_ENTRY_LEN 8
+#define FIXED_HDR_LEN 12
+
+//节点数, 节点ID从1到nodeNum
+int nodeNum;
+//每个节点的距离矢量表, 下标是节点ID
+dv_t** dvs;
+//每个节点的路由更新重组表和路由通告表
+rtreasm_t** rtreasms;
+adverttable_t** ats;
+//每个节点下一次路由更新的序号
+unsigned int* seqs;
+//down[i]为1表示节点i已经崩溃
+int* down;
+//节点1和节点2之间的链路是否断开
+int linkDown;
+//changed[i]为1表示节点i的距离矢量在上一轮变化了, 这一轮要发送路由更新
+int* changed;
+int* nextChanged;
+
+
+// 节点a和节点b之间的链路是否可用
+static int linkup(int a, int b)
+{
+    if (down[a] || down[b])
+        return 0;
+    return !(linkDown && ((a == 1 && b == 2) || (a == 2 && b == 1)));
+}
+
+
+// 把s发给r的一次路由更新编码, 分片后交给r, 返回包括确认在内的字节数
+static unsigned long deliver(int s, int r, unsigned int seq, unsigned int base, int full, routeupdate_entry_t* entries, int entryNum,
+    int* dests, int* nextNodes, int* changedOut)
+{
+    pkt_routeupdate_t pkt_rp;
+    routeupdate_entry_t* got;
+    unsigned long bytes = 0;
+    int fragNum = 0, first = 0;
+    do {
+        pkt_rtencode(&pkt_rp, entries + first, entryNum - first);
+        first += pkt_rp.entryNum;
+        fragNum++;
+    } while (first < entryNum);
+    pkt_rp.seq = seq;
+    pkt_rp.base = base;
+    pkt_rp.fragNum = fragNum;
+    pkt_rp.flags = full ? ROUTEUPDATE_FULL : 0;
+    first = 0;
+    for (int f = 0; f < fragNum; f++) {
+        pkt_rp.fragIdx = f;
+        int len = ROUTEUPDATE_LEN(pkt_rtencode(&pkt_rp, entries + first, entryNum - first));
+        first += pkt_rp.entryNum;
+        bytes += PKT_FRAME_OVERHEAD + len;
+        dvtable_heard(dvs[r], s, 1);
+        int n = rtreasm_add(rtreasms[r], s, &pkt_rp, len, &got);
+        if (n > 0 && dvtable_update(dvs[r], s, got, n, dests, nextNodes) > 0)
+            *changedOut = 1;
+        // 确认立即到达发送方
+        if (n >= 0 || n == RTREASM_DUP || n == RTREASM_RESYNC) {
+            adverttable_ack(ats[s], r, seq, n == RTREASM_RESYNC);
+            bytes += PKT_FRAME_OVERHEAD + sizeof(pkt_routeack_t);
+        }
+    }
+    return bytes;
+}
+
+
+// 运行触发更新直到收敛, 返回轮数, 发送的路由更新数和字节数累加到msgs和bytes
+static int converge(int poison, unsigned long* msgs, unsigned long* bytes)
+{
+    int maxNbr = 1;
+    for (int s = 1; s <= nodeNum; s++)
+        if (dvs[s]->rowNum - 1 > maxNbr)
+            maxNbr = dvs[s]->rowNum - 1;
+    routeupdate_entry_t* advert = (routeupdate_entry_t*)malloc(sizeof(routeupdate_entry_t) * nodeNum);
+    routeupdate_entry_t* deltas = (routeupdate_entry_t*)malloc(sizeof(routeupdate_entry_t) * nodeNum * maxNbr * (nodeNum + 1));
+    int* deltaNum = (int*)malloc(sizeof(int) * maxNbr * (nodeNum + 1));
+    int* full = (int*)malloc(sizeof(int) * maxNbr * (nodeNum + 1));
+    unsigned int* base = (unsigned int*)malloc(sizeof(unsigned int) * maxNbr * (nodeNum + 1));
+    int* dests = (int*)malloc(sizeof(int) * nodeNum);
+    int* nextNodes = (int*)malloc(sizeof(int) * nodeNum);
+    int rounds = 0;
+    while (1) {
+        int any = 0;
+        // 同一轮的路由更新都用这一轮开始时的距离矢量生成, 没有变化的邻居不发送
+        for (int s = 1; s <= nodeNum; s++) {
+            if (!changed[s] || down[s])
+                continue;
+            dv_t* dv = dvs[s];
+            for (int i = 0; i < dv->rowNum - 1; i++) {
+                int k = s * maxNbr + i;
+                dvtable_getadvert(dv, dv->rowID[i], poison, advert);
+                deltaNum[k] = adverttable_delta(ats[s], dv->rowID[i], advert, deltas + (size_t)k * nodeNum, &base[k], &full[k]);
+                if (deltaNum[k] == 0 || !linkup(s, dv->rowID[i]))
+                    deltaNum[k] = -1;
+                else
+                    adverttable_sent(ats[s], dv->rowID[i], advert, seqs[s], 0);
+            }
+        }
+        memset(nextChanged, 0, sizeof(int) * (nodeNum + 1));
+        for (int s = 1; s <= nodeNum; s++) {
+            if (!changed[s] || down[s])
+                continue;
+            dv_t* dv = dvs[s];
+            for (int i = 0; i < dv->rowNum - 1; i++) {
+                int k = s * maxNbr + i, r = dv->rowID[i];
+                if (deltaNum[k] < 0)
+                    continue;
+                (*msgs)++;
+                *bytes += deliver(s, r, seqs[s], base[k], full[k], deltas + (size_t)k * nodeNum, deltaNum[k], dests, nextNodes, &nextChanged[r]);
+            }
+            seqs[s]++;
+        }
+        for (int s = 1; s <= nodeNum; s++)
+            any |= nextChanged[s];
+        memcpy(changed, nextChanged, sizeof(int) * (nodeNum + 1));
+        if (!any)
+            break;
+        rounds++;
+    }
+    free(advert);
+    free(deltas);
+    free(deltaNum);
+    free(full);
+    free(base);
+    free(dests);
+    free(nextNodes);
+    return rounds;
+}
+
+
+// 每次发送定长编码的完整距离矢量时, msgs个路由更新的字节数
+static unsigned long fixedbytes(unsigned long msgs)
+{
+    int perFrag = (MAX_PKT_LEN - FIXED_HDR_LEN) / FIXED_ENTRY_LEN;
+    int frags = (nodeNum + perFrag - 1) / perFrag;
+    return msgs * (frags * (PKT_FRAME_OVERHEAD + FIXED_HDR_LEN) + (unsigned long)nodeNum * FIXED_ENTRY_LEN);
+}
+
+
+// 节点1和节点2之间的链路断开后, 重新收敛之前两端只去掉断开的下一跳时, 能够无环送达的(源, 目的)节点对数.
+// useBackup为1时所有等价下一跳都断开的路由改用备份下一跳, 与SIP进程的routingtable_failover()相同
+static int failoverreach(int useBackup)
+{
+    int hops[MAX_ECMP_PATHS], reached = 0;
+    for (int s = 1; s <= nodeNum; s++) {
+        for (int d = 1; d <= nodeNum; d++) {
+            int cur = s, len = 0;
+            while (cur != d && cur > 0 && len++ <= nodeNum) {
+                int n = dvtable_getnexthops(dvs[cur], d, hops), next = -1;
+                for (int k = 0; k < n && next < 0; k++)
+                    if (!((cur == 1 && hops[k] == 2) || (cur == 2 && hops[k] == 1)))
+                        next = hops[k];
+                if (next < 0 && useBackup && n > 0)
+                    next = dvtable_getbackup(dvs[cur], d);
+                cur = next;
+            }
+            if (s != d && cur == d)
+                reached++;
+        }
+    }
+    return reached;
+}
+
+
+// 在给定的拓扑上运行一次测试
+static void run(const char* topo, const char* fail, int poison)
+{
+    int* dests = (int*)malloc(sizeof(int) * nodeNum);
+    int* nextNodes = (int*)malloc(sizeof(int) * nodeNum);
+    dvs = (dv_t**)malloc(sizeof(dv_t*) * (nodeNum + 1));
+    rtreasms = (rtreasm_t**)malloc(sizeof(rtreasm_t*) * (nodeNum + 1));
+    ats = (adverttable_t**)malloc(sizeof(adverttable_t*) * (nodeNum + 1));
+    seqs = (unsigned int*)malloc(sizeof(unsigned int) * (nodeNum + 1));
+    down = (int*)calloc(nodeNum + 1, sizeof(int));
+    changed = (int*)malloc(sizeof(int) * (nodeNum + 1));
+    nextChanged = (int*)malloc(sizeof(int) * (nodeNum + 1));
+    linkDown = 0;
+    for (int i = 1; i <= nodeNum; i++) {
+        topology_setMyNodeID(i);
+        dvs[i] = dvtable_create();
+        rtreasms[i] = rtreasm_create();
+        ats[i] = adverttable_create(dvs[i]->nodeNum);
+        seqs[i] = 1;
+        changed[i] = 1;
+    }
+    unsigned long msgs = 0, bytes = 0;
+    int rounds = converge(poison, &msgs, &bytes);
+    fprintf(stderr, "%s %d nodes, poison %s: initial convergence %d rounds, %lu updates, %lu bytes (%lu with full vectors)\n",
+        topo, nodeNum, poison ? "on " : "off", rounds, msgs, bytes, fixedbytes(msgs));
+
+    memset(changed, 0, sizeof(int) * (nodeNum + 1));
+    long detect = 0;
+    if (strcmp(fail, "crash") == 0) {
+        // 节点2崩溃: 它的邻居在ROUTE_TIMEOUT秒内没有收到它的路由更新, 其他邻居仍在周期性刷新
+        down[2] = 1;
+        detect = ROUTE_TIMEOUT;
+        for (int s = 1; s <= nodeNum; s++) {
+            if (down[s])
+                continue;
+            dv_t* dv = dvs[s];
+            for (int i = 0; i < dv->rowNum - 1; i++) {
+                if (!down[dv->rowID[i]]) {
+                    dvtable_heard(dv, dv->rowID[i], 1 + ROUTE_TIMEOUT);
+                } else {
+                    // 与SIP进程一样, 失效的邻居的版本被丢弃
+                    rtreasm_reset(rtreasms[s], dv->rowID[i]);
+                    adverttable_reset(ats[s], dv->rowID[i]);
+                }
+            }
+            if (dvtable_expire(dv, 1 + ROUTE_TIMEOUT, ROUTE_TIMEOUT, dests, nextNodes) > 0)
+                changed[s] = 1;
+        }
+    } else {
+        // 节点1和节点2之间的链路断开, 两端立即发现
+        fprintf(stderr, "%s %d nodes, poison %s: before reconvergence %d of %d node pairs reachable with backup next hops, %d without\n",
+            topo, nodeNum, poison ? "on " : "off", failoverreach(1), nodeNum * (nodeNum - 1), failoverreach(0));
+        linkDown = 1;
+        if (dvtable_setlinkcost(dvs[1], 2, INFINITE_COST, dests, nextNodes) > 0)
+            changed[1] = 1;
+        if (dvtable_setlinkcost(dvs[2], 1, INFINITE_COST, dests, nextNodes) > 0)
+            changed[2] = 1;
+    }
+    msgs = bytes = 0;
+    rounds = converge(poison, &msgs, &bytes);
+
+    // 检查收敛后到节点1的代价: 不可达的节点数和可达节点的最大代价
+    int unreachable = 0;
+    unsigned int maxCost = 0;
+    for (int s = 2; s <= nodeNum; s++) {
+        if (down[s])
+            continue;
+        unsigned int c = dvtable_getcost(dvs[s], s, 1);
+        if (c >= INFINITE_COST)
+            unreachable++;
+        else if (c > maxCost)
+            maxCost = c;
+    }
+    fprintf(stderr, "%s %d nodes, poison %s: after %s failure %d rounds (%.1f s), %lu updates, %lu bytes (%lu with full vectors), %d nodes cannot reach node 1, max cost %u\n",
+        topo, nodeNum, poison ? "on " : "off", fail, rounds, detect + rounds * ROUTEUPDATE_HOLDDOWN / 1000.0,
+        msgs, bytes, fixedbytes(msgs), unreachable, maxCost);
+
+    for (int i = 1; i <= nodeNum; i++) {
+        dvtable_destroy(dvs[i]);
+        rtreasm_destroy(rtreasms[i]);
+        adverttable_destroy(ats[i]);
+    }
+    free(dvs);
+    free(rtreasms);
+    free(ats);
+    free(seqs);
+    free(down);
+    free(changed);
+    free(nextChanged);
+    free(dests);
+    free(nextNodes);
+}
+
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2 || (strcmp(argv[1], "line") != 0 && strcmp(argv[1], "ring") != 0 && strcmp(argv[1], "mesh") != 0)) {
+        fprintf(stderr, "usage: %s line|ring|mesh [nodes] [link|crash]\n", argv[0]);
+        return 1;
+    }
+    nodeNum = argc > 2 ? atoi(argv[2]) : 16;
+    const char* fail = argc > 3 ? argv[3] : "link";
+    if (nodeNum < 3) {
+        fprintf(stderr, "need at least 3 nodes\n");
+        return 1;
+    }
+    int mesh = strcmp(argv[1], "mesh") == 0;
+    // 网状拓扑使用固定的随机种子, 每次运行的拓扑相同
+    srand(1);
+    for (int i = 1; i < nodeNum; i++)
+        topology_addLink(i, i + 1, mesh ? 1 + rand() % 5 : 1);
+    if (strcmp(argv[1], "line") != 0)
+        topology_addLink(nodeNum, 1, mesh ? 1 + rand() % 5 : 1);
+    for (int k = 0; mesh && k < nodeNum / 2; k++) {
+        int a = 1 + rand() % nodeNum, b = 1 + rand() % nodeNum;
+        if (a != b && topology_getCost(a, b) >= INFINITE_COST)
+            topology_addLink(a, b, 1 + rand() % 5);
+    }
+
+    run(argv[1], fail, 0);
+    run(argv[1], fail, 1);
+    return 0;
+}
@@ -13,6 +13,93 @@
 #include "../topology/topology.h"
 #include "dvtable.h"
 
+//缓存行的字节数, 代价矩阵的每行按缓存行对齐
+#define CACHELINE 64
+
+
+// 返回节点ID对应的行号, 不是源节点时返回-1
+static inline int rowof(dv_t* dv, int nodeID)
+{
+    int j = topology_getNodeIndex(nodeID);
+    return j >= 0 ? dv->rowOf[j] : -1;
+}
+
+// 返回第i行的起始地址
+static inline unsigned int* rowat(dv_t* dv, int i)
+{
+    return dv->cost + (size_t)i * dv->stride;
+}
+
+// 代价相加, 结果不超过INFINITE_COST
+static inline unsigned int costadd(unsigned int a, unsigned int b)
+{
+    return a + b < INFINITE_COST ? a + b : INFINITE_COST;
+}
+
+// 重新计算本节点到第j列的代价 D(x,y) = min_v { c(x,v) + D(v,y) }, 下一跳和备份下一跳, 有变化时返回1
+static int recompute(dv_t* dv, int j)
+{
+    int self = dv->rowNum - 1;
+    unsigned int* dx = rowat(dv, self);
+    if (dv->colID[j] == dv->rowID[self])
+        return 0;
+    unsigned int best = INFINITE_COST;
+    unsigned long long set = 0;
+    int bestRow = -1;
+    for (int i = 0; i < self; i++) {
+        unsigned int c = costadd(dv->link[i], rowat(dv, i)[j]);
+        if (c >= INFINITE_COST || c > best)
+            continue;
+        if (c < best)
+            set = 0;
+        // 代价相同时保留当前的下一跳, 避免路由来回切换
+        if (c < best || i == dv->next[j])
+            bestRow = i;
+        best = c;
+        if (i < 64)
+            set |= 1ULL << i;
+    }
+    // 无环备份下一跳: 不在等价下一跳中, 并且 D(v,y) < D(v,x) + D(x,y) 的邻居, 选代价最小的一个.
+    // 毒性逆转使邻居把经过本节点到达本节点的路由通告为无穷大, 这时用直接链路代价作为D(v,x)
+    int backup = -1;
+    unsigned int backupCost = INFINITE_COST;
+    for (int i = 0; i < self && best < INFINITE_COST; i++) {
+        unsigned int dvy = rowat(dv, i)[j], dvx = dv->selfCol >= 0 ? rowat(dv, i)[dv->selfCol] : INFINITE_COST;
+        if (i == bestRow || (i < 64 && ((set >> i) & 1)) || dv->link[i] >= INFINITE_COST || dvy >= INFINITE_COST)
+            continue;
+        if (dvx > dv->link[i])
+            dvx = dv->link[i];
+        unsigned int c = costadd(dv->link[i], dvy);
+        if (dvy < dvx + best && c < backupCost) {
+            backup = i;
+            backupCost = c;
+        }
+    }
+    if (best == dx[j] && bestRow == dv->next[j] && set == dv->nextSet[j] && backup == dv->backup[j])
+        return 0;
+    dx[j] = best;
+    dv->next[j] = bestRow;
+    dv->nextSet[j] = set;
+    dv->backup[j] = backup;
+    return 1;
+}
+
+
+// 重新计算所有(或者只有经过第v行邻居的)目的节点, 把改变了的写入dests和nextNodes, 返回改变了的目的节点数
+static int recomputeall(dv_t* dv, int v, int* dests, int* nextNodes)
+{
+    int n = 0;
+    for (int j = 0; j < dv->nodeNum; j++) {
+        if (v >= 0 && dv->next[j] != v && !(v < 64 && ((dv->nextSet[j] >> v) & 1)))
+            continue;
+        if (recompute(dv, j)) {
+            dests[n] = dv->colID[j];
+            nextNodes[n++] = dv->next[j] < 0 ? -1 : dv->rowID[dv->next[j]];
+        }
+    }
+    return n;
+}
+
 
 dv_t* dvtable_create()
 {
@@ -21,67 +108,238 @@ dv_t* dvtable_create()
     int* nodeArr = topology_getNodeArray();
     int nbrNum = topology_getNbrNum();
     int nodeNum = topology_getNodeNum();
-    dv_t* dv = (dv_t*)malloc(sizeof(dv_t) * (nbrNum + 1));
-    for (int i = 0; i <= nbrNum; i++) {
-        dv[i].nodeID = i < nbrNum ? nbrArr[i] : myNodeID;
-        dv[i].dvEntry = (dv_entry_t*)malloc(sizeof(dv_entry_t) * (nodeNum));
+    dv_t* dv = (dv_t*)malloc(sizeof(dv_t));
+    assert(dv != NULL);
+    dv->rowNum = nbrNum + 1;
+    dv->nodeNum = nodeNum;
+    int perLine = CACHELINE / sizeof(unsigned int);
+    dv->stride = (nodeNum + perLine - 1) / perLine * perLine;
+
+    // 列号就是节点的下标, 再建立列号到行号的映射
+    dv->rowID = (int*)malloc(sizeof(int) * dv->rowNum);
+    dv->colID = (int*)malloc(sizeof(int) * nodeNum);
+    dv->rowOf = (int*)malloc(sizeof(int) * (nodeNum > 0 ? nodeNum : 1));
+    dv->link = (unsigned int*)malloc(sizeof(unsigned int) * dv->rowNum);
+    dv->heard = (long*)calloc(dv->rowNum, sizeof(long));
+    dv->next = (int*)malloc(sizeof(int) * nodeNum);
+    dv->nextSet = (unsigned long long*)malloc(sizeof(unsigned long long) * nodeNum);
+    dv->backup = (int*)malloc(sizeof(int) * nodeNum);
+    dv->dirty = (int*)malloc(sizeof(int) * nodeNum);
+    dv->queued = (unsigned char*)calloc(nodeNum, 1);
+    dv->dirtyNum = 0;
+    for (int j = 0; j < nodeNum; j++)
+        dv->rowOf[j] = -1;
+    for (int i = 0; i < dv->rowNum; i++) {
+        dv->rowID[i] = i < nbrNum ? nbrArr[i] : myNodeID;
+        if (topology_getNodeIndex(dv->rowID[i]) >= 0)
+            dv->rowOf[topology_getNodeIndex(dv->rowID[i])] = i;
+        dv->link[i] = i < nbrNum ? topology_getCost(myNodeID, nbrArr[i]) : 0;
+    }
+    dv->selfCol = -1;
+    for (int j = 0; j < nodeNum; j++) {
+        dv->colID[j] = nodeArr[j];
+        if (nodeArr[j] == myNodeID)
+            dv->selfCol = j;
+        // 初始时只有到邻居的直接路径
+        int i = dv->rowOf[j];
+        dv->next[j] = i >= 0 && i < nbrNum ? i : -1;
+        dv->nextSet[j] = dv->next[j] >= 0 && dv->next[j] < 64 ? 1ULL << dv->next[j] : 0;
+        dv->backup[j] = -1;
+    }
+
+    size_t size = sizeof(unsigned int) * dv->rowNum * dv->stride;
+    dv->cost = (unsigned int*)aligned_alloc(CACHELINE, (size + CACHELINE - 1) / CACHELINE * CACHELINE);
+    assert(dv->cost != NULL);
+    for (int i = 0; i < dv->rowNum; i++) {
+        unsigned int* row = rowat(dv, i);
+        for (int j = 0; j < dv->stride; j++)
+            row[j] = INFINITE_COST;
+        // 邻居的距离矢量从它的路由更新报文中得到, 本节点的距离矢量初始为直接链路代价
         for (int j = 0; j < nodeNum; j++) {
-            int src_nodeID = dv[i].nodeID;
-            int dest_nodeID = nodeArr[j];
-            dv[i].dvEntry[j].nodeID = dest_nodeID;
-            dv[i].dvEntry[j].cost = 
-                src_nodeID == dest_nodeID ? 0 : topology_getCost(src_nodeID, dest_nodeID);
+            if (dv->rowID[i] == dv->colID[j])
+                row[j] = 0;
+            else if (i == nbrNum)
+                row[j] = topology_getCost(myNodeID, dv->colID[j]);
         }
     }
+    free(nbrArr);
+    free(nodeArr);
     return dv;
 }
 
 
 void dvtable_destroy(dv_t* dvtable)
 {
-    for (int i = 0; i <= topology_getNbrNum(); i++)
-        free(dvtable[i].dvEntry);
+    free(dvtable->cost);
+    free(dvtable->rowID);
+    free(dvtable->colID);
+    free(dvtable->rowOf);
+    free(dvtable->link);
+    free(dvtable->heard);
+    free(dvtable->next);
+    free(dvtable->nextSet);
+    free(dvtable->backup);
+    free(dvtable->dirty);
+    free(dvtable->queued);
     free(dvtable);
 }
 
 
 int dvtable_setcost(dv_t* dvtable,int fromNodeID,int toNodeID, unsigned int cost)
 {
-    for (int i = 0; i <= topology_getNbrNum(); i++) {
-        if (dvtable[i].nodeID == fromNodeID) {
-            for (int j = 0; j <= topology_getNodeNum(); j++) {
-                if (dvtable[i].dvEntry[j].nodeID == toNodeID) {
-                    dvtable[i].dvEntry[j].cost = cost;
-                    return 1;
-                }
+    int i = rowof(dvtable, fromNodeID), j = topology_getNodeIndex(toNodeID);
+    if (i < 0 || j < 0)
+        return -1;
+    dvtable->cost[(size_t)i * dvtable->stride + j] = cost;
+    return 1;
+}
+
+
+unsigned int dvtable_getcost(dv_t* dvtable, int fromNodeID, int toNodeID)
+{
+    int i = rowof(dvtable, fromNodeID), j = topology_getNodeIndex(toNodeID);
+    if (i < 0 || j < 0)
+        return INFINITE_COST;
+    return dvtable->cost[(size_t)i * dvtable->stride + j];
+}
+
+
+void dvtable_apply(dv_t* dvtable, int fromNodeID, routeupdate_entry_t* entries, int entryNum)
+{
+    int v = rowof(dvtable, fromNodeID), self = dvtable->rowNum - 1;
+    if (v < 0 || v == self)
+        return;
+    unsigned int* dx = rowat(dvtable, self);
+    unsigned int* dv = rowat(dvtable, v);
+    for (int k = 0; k < entryNum; k++) {
+        int j = topology_getNodeIndex(entries[k].nodeID);
+        unsigned int cost = entries[k].cost < INFINITE_COST ? entries[k].cost : INFINITE_COST;
+        if (j < 0 || dv[j] == cost)
+            continue;
+        dv[j] = cost;
+        // 只有当前经过这个邻居的目的节点, 经过这个邻居不会更远的目的节点,
+        // 以及备份下一跳是这个邻居或者这个邻居可能成为备份下一跳的目的节点受影响
+        if (dvtable->next[j] == v || (v < 64 && ((dvtable->nextSet[j] >> v) & 1)) || costadd(dvtable->link[v], cost) <= dx[j]
+                || dvtable->backup[j] == v || (cost < INFINITE_COST && cost < dvtable->link[v] + dx[j])) {
+            // 同一个目的节点可能出现在多个条目或多次更新中, 只重新计算一次
+            if (!dvtable->queued[j]) {
+                dvtable->queued[j] = 1;
+                dvtable->dirty[dvtable->dirtyNum++] = j;
             }
         }
     }
-    return -1;
 }
 
 
-unsigned int dvtable_getcost(dv_t* dvtable, int fromNodeID, int toNodeID)
+int dvtable_recompute(dv_t* dvtable, int* dests, int* nextNodes)
 {
-    for (int i = 0; i <= topology_getNbrNum(); i++) {
-        if (dvtable[i].nodeID == fromNodeID) {
-            for (int j = 0; j <= topology_getNodeNum(); j++)
-                if (dvtable[i].dvEntry[j].nodeID == toNodeID)
-                    return dvtable[i].dvEntry[j].cost;
+    int n = 0;
+    for (int k = 0; k < dvtable->dirtyNum; k++) {
+        int j = dvtable->dirty[k];
+        dvtable->queued[j] = 0;
+        if (recompute(dvtable, j)) {
+            dests[n] = dvtable->colID[j];
+            nextNodes[n++] = dvtable->next[j] < 0 ? -1 : dvtable->rowID[dvtable->next[j]];
         }
     }
-    return INFINITE_COST;
+    dvtable->dirtyNum = 0;
+    return n;
+}
+
+
+int dvtable_update(dv_t* dvtable, int fromNodeID, routeupdate_entry_t* entries, int entryNum, int* dests, int* nextNodes)
+{
+    dvtable_apply(dvtable, fromNodeID, entries, entryNum);
+    return dvtable_recompute(dvtable, dests, nextNodes);
+}
+
+
+void dvtable_heard(dv_t* dvtable, int nbrNodeID, long now)
+{
+    int v = rowof(dvtable, nbrNodeID);
+    if (v >= 0 && v < dvtable->rowNum - 1)
+        dvtable->heard[v] = now;
+}
+
+
+int dvtable_expire(dv_t* dvtable, long now, long timeout, int* dests, int* nextNodes)
+{
+    int expired = -1, expiredNum = 0;
+    for (int v = 0; v < dvtable->rowNum - 1; v++) {
+        if (dvtable->heard[v] == 0)
+            dvtable->heard[v] = now;
+        if (now - dvtable->heard[v] < timeout)
+            continue;
+        // 邻居不再发来路由更新, 它的距离矢量不再可信
+        dvtable->heard[v] = now;
+        unsigned int* row = rowat(dvtable, v);
+        for (int j = 0; j < dvtable->nodeNum; j++)
+            row[j] = INFINITE_COST;
+        expired = v;
+        expiredNum++;
+    }
+    if (expiredNum == 0)
+        return 0;
+    // 代价只会增大, 只有一个邻居失效时只重新计算经过它的目的节点
+    return recomputeall(dvtable, expiredNum == 1 ? expired : -1, dests, nextNodes);
+}
+
+
+int dvtable_setlinkcost(dv_t* dvtable, int nbrNodeID, unsigned int cost, int* dests, int* nextNodes)
+{
+    int v = rowof(dvtable, nbrNodeID);
+    if (v < 0 || v == dvtable->rowNum - 1)
+        return -1;
+    dvtable->link[v] = cost < INFINITE_COST ? cost : INFINITE_COST;
+    return recomputeall(dvtable, -1, dests, nextNodes);
+}
+
+
+int dvtable_getadvert(dv_t* dvtable, int nbrNodeID, int poison, routeupdate_entry_t* entries)
+{
+    int v = rowof(dvtable, nbrNodeID);
+    unsigned int* dx = rowat(dvtable, dvtable->rowNum - 1);
+    for (int j = 0; j < dvtable->nodeNum; j++) {
+        entries[j].nodeID = dvtable->colID[j];
+        entries[j].cost = dx[j];
+        // 毒性逆转: 经过这个邻居的路由不能再通告给它
+        if (poison && v >= 0 && (dvtable->next[j] == v || (v < 64 && ((dvtable->nextSet[j] >> v) & 1))))
+            entries[j].cost = INFINITE_COST;
+    }
+    return dvtable->nodeNum;
+}
+
+
+int dvtable_getnexthops(dv_t* dvtable, int destNodeID, int* nextNodes)
+{
+    int j = topology_getNodeIndex(destNodeID), n = 0;
+    if (j < 0 || dvtable->next[j] < 0)
+        return 0;
+    nextNodes[n++] = dvtable->rowID[dvtable->next[j]];
+    for (int i = 0; i < dvtable->rowNum - 1 && i < 64 && n < MAX_ECMP_PATHS; i++)
+        if (((dvtable->nextSet[j] >> i) & 1) && i != dvtable->next[j])
+            nextNodes[n++] = dvtable->rowID[i];
+    return n;
+}
+
+
+int dvtable_getbackup(dv_t* dvtable, int destNodeID)
+{
+    int j = topology_getNodeIndex(destNodeID);
+    if (j < 0 || dvtable->backup[j] < 0)
+        return -1;
+    return dvtable->rowID[dvtable->backup[j]];
 }
 
 
 void dvtable_print(dv_t* dvtable)
 {
     printf("--------DISTANCE VECTOR TABLE--------\n");
-    for (int i = 0; i <= topology_getNbrNum(); i++) {
-        printf("SRC[%d]: ", dvtable[i].nodeID);
-        for (int j = 0; j < topology_getNodeNum(); j++)
-            printf("[DEST: %d |COST: %d] ", dvtable[i].dvEntry[j].nodeID, dvtable[i].dvEntry[j].cost);
+    for (int i = 0; i < dvtable->rowNum; i++) {
+        printf("SRC[%d]: ", dvtable->rowID[i]);
+        for (int j = 0; j < dvtable->nodeNum; j++)
+            printf("[DEST: %d |COST: %d] ", dvtable->colID[j], dvtable->cost[(size_t)i * dvtable->stride + j]);
         printf("\n");
     }
     printf("-------------------------------------\n");
-}
\ No newline at end of file
+}
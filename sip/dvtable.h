@@ -11,25 +11,36 @@
 #include "../common/pkt.h"
 
 
-//dv_entry_t结构定义
-typedef struct distancevectorentry {
-	int nodeID;		    //目标节点ID	
-	unsigned int cost;	//到目标节点的代价
-} dv_entry_t;
-
-//一个距离矢量表包含(n+1)个dv_t条目, 其中n是这个节点的邻居数, 剩下的一个是这个节点自身. 
+//距离矢量表是一个(n+1)行N列的代价矩阵, 其中n是这个节点的邻居数, 剩下的一行是这个节点自身, N是重叠网络中总的节点数.
+//列号是topology_getNodeIndex()给出的节点下标, 行号通过列号到行号的映射得到, 查找和设置代价都是O(1)的.
+//矩阵按行连续存放, 每行按缓存行对齐.
+//本节点的距离矢量是 D(x,y) = min_v { c(x,v) + D(v,y) }, 收到邻居的路由更新时只重新计算受影响的目的节点.
+//重新计算时还为每个目的节点选出一个不在最短路径上的无环备份下一跳(Loop-Free Alternate):
+//满足 D(v,y) < D(v,x) + D(x,y) 的邻居v到y的路径不经过本节点, 主下一跳断开时可以立即改用它.
 typedef struct distancevector {
-	int nodeID;		        //源节点ID
-	dv_entry_t* dvEntry;	//一个包含N个dv_entry_t的数组, 其中每个成员包含目标节点ID和从该源节点到该目标节点的代价. N是重叠网络中总的节点数.
+	int rowNum;             //行数: 邻居数+1, 最后一行是这个节点自身
+	int nodeNum;            //列数: 重叠网络中总的节点数
+	int stride;             //每行占用的条目数, 是缓存行中条目数的整数倍
+	int* rowID;             //第i行的源节点ID
+	int* colID;             //第j列的目标节点ID
+	int* rowOf;             //rowOf[j]是第j列的节点对应的行号, 不是源节点时为-1
+	unsigned int* cost;     //rowNum*stride的代价矩阵, cost[i*stride+j]是从rowID[i]到colID[j]的代价
+	unsigned int* link;     //link[i]是从这个节点到邻居rowID[i]的直接链路代价c(x,v)
+	long* heard;            //heard[i]是最近一次收到邻居rowID[i]的路由更新的时刻(秒), 还没有开始计时时为0
+	int* next;              //next[j]是到colID[j]的当前最短路径经过的邻居的行号, 没有路径时为-1
+	unsigned long long* nextSet;    //nextSet[j]的第i位为1表示经过第i行的邻居到colID[j]的路径也是最短的(等价多路径), 只记录前64个邻居
+	int* backup;            //backup[j]是到colID[j]的无环备份下一跳(LFA)的行号, 没有时为-1
+	int selfCol;            //这个节点自身的列号
+	int* dirty;             //dvtable_apply()写入的还没有重新计算的列号
+	int dirtyNum;           //dirty中的列数
+	unsigned char* queued;  //queued[j]为1表示第j列已经在dirty中
 } dv_t;
 
 
 /**
  * @brief   这个函数动态创建距离矢量表.
- *          距离矢量表包含n+1个条目, 其中n是这个节点的邻居数,剩下1个是这个节点本身.
- *          距离矢量表中的每个条目是一个dv_t结构,它包含一个源节点ID和一个有N个dv_entry_t结构的数组, 
- *          其中N是重叠网络中节点总数.
- *          每个dv_entry_t包含一个目的节点地址和从该源节点到该目的节点的链路代价.
+ *          距离矢量表包含n+1行, 其中n是这个节点的邻居数,剩下1行是这个节点本身.
+ *          每行有N个条目, 其中N是重叠网络中节点总数, 每个条目是从该行的源节点到一个目的节点的链路代价.
  *          距离矢量表也在这个函数中初始化.从这个节点到其邻居的链路代价使用提取自topology.dat文件中的直接链路代价初始化.
  *          其他链路代价被初始化为INFINITE_COST.
  *          该函数返回动态创建的距离矢量表.
@@ -73,6 +84,131 @@ int dvtable_setcost(dv_t* dvtable,int fromNodeID,int toNodeID, unsigned int cost
 unsigned int dvtable_getcost(dv_t* dvtable, int fromNodeID, int toNodeID);
 
 
+/**
+ * @brief   这个函数用邻居fromNodeID发来的entryNum个路由更新条目增量地更新距离矢量表.
+ *          首先把条目写入邻居的行, 只有代价变化了的条目才会引起重新计算:
+ *          如果到目的节点y的当前路径经过这个邻居, 或者经过这个邻居的新路径更短,
+ *          就重新计算 D(x,y) = min_v { c(x,v) + D(v,y) }, 所以代价增大也能正确传播.
+ *          代价或下一跳(包括等价的下一跳和备份下一跳)改变了的目的节点ID写入dests, 新的下一跳写入nextNodes(不可达时为-1),
+ *          两个数组至少应有nodeNum个元素. 返回改变了的目的节点数.
+ * 
+ * @param dvtable 
+ * @param fromNodeID 
+ * @param entries 
+ * @param entryNum 
+ * @param dests 
+ * @param nextNodes 
+ * @return int 
+ */
+int dvtable_update(dv_t* dvtable, int fromNodeID, routeupdate_entry_t* entries, int entryNum, int* dests, int* nextNodes);
+
+
+/**
+ * @brief   这个函数把邻居fromNodeID发来的entryNum个路由更新条目写入邻居的行, 但不重新计算,
+ *          受影响的目的节点被记下来, 由之后的dvtable_recompute()一起重新计算.
+ *          这样一批路由更新中多次受影响的目的节点只重新计算一次.
+ * 
+ * @param dvtable 
+ * @param fromNodeID 
+ * @param entries 
+ * @param entryNum 
+ */
+void dvtable_apply(dv_t* dvtable, int fromNodeID, routeupdate_entry_t* entries, int entryNum);
+
+
+/**
+ * @brief   这个函数重新计算dvtable_apply()记下的所有目的节点.
+ *          代价或下一跳改变了的目的节点ID写入dests, 新的下一跳写入nextNodes, 返回改变了的目的节点数.
+ *          dvtable_update()相当于dvtable_apply()之后调用这个函数.
+ * 
+ * @param dvtable 
+ * @param dests 
+ * @param nextNodes 
+ * @return int 
+ */
+int dvtable_recompute(dv_t* dvtable, int* dests, int* nextNodes);
+
+
+/**
+ * @brief   这个函数记录在now时刻(秒)收到了邻居nbrNodeID的路由更新.
+ * 
+ * @param dvtable 
+ * @param nbrNodeID 
+ * @param now 
+ */
+void dvtable_heard(dv_t* dvtable, int nbrNodeID, long now);
+
+
+/**
+ * @brief   这个函数使超过timeout秒没有发来路由更新的邻居的距离矢量失效.
+ * @details 失效的邻居的行(包括到它自己的代价)被设为INFINITE_COST, 经过它的路由重新计算,
+ *          之后重新开始计时, 直到再次收到它的路由更新. 第一次调用时开始对所有邻居计时.
+ *          代价或下一跳改变了的目的节点ID和新的下一跳写入dests和nextNodes, 返回改变了的目的节点数.
+ * 
+ * @param dvtable 
+ * @param now 
+ * @param timeout 
+ * @param dests 
+ * @param nextNodes 
+ * @return int 
+ */
+int dvtable_expire(dv_t* dvtable, long now, long timeout, int* dests, int* nextNodes);
+
+
+/**
+ * @brief   这个函数把到邻居nbrNodeID的直接链路代价c(x,v)设为cost并重新计算所有目的节点.
+ *          cost为INFINITE_COST表示链路断开. 代价或下一跳改变了的目的节点ID和新的下一跳写入dests和nextNodes,
+ *          返回改变了的目的节点数. nbrNodeID不是邻居时返回-1.
+ * 
+ * @param dvtable 
+ * @param nbrNodeID 
+ * @param cost 
+ * @param dests 
+ * @param nextNodes 
+ * @return int 
+ */
+int dvtable_setlinkcost(dv_t* dvtable, int nbrNodeID, unsigned int cost, int* dests, int* nextNodes);
+
+
+/**
+ * @brief   这个函数生成发给邻居nbrNodeID的路由更新条目, 返回条目数. entries至少应有nodeNum个元素.
+ * @details poison为1时使用毒性逆转: 下一跳(包括等价的下一跳)是这个邻居的路由以INFINITE_COST通告给它,
+ *          这样两个节点之间不会形成环路, 链路断开时不会互相抬高代价直到INFINITE_COST.
+ *          poison为0时通告完整的距离矢量.
+ * 
+ * @param dvtable 
+ * @param nbrNodeID 
+ * @param poison 
+ * @param entries 
+ * @return int 
+ */
+int dvtable_getadvert(dv_t* dvtable, int nbrNodeID, int poison, routeupdate_entry_t* entries);
+
+
+/**
+ * @brief   这个函数把到目的节点destNodeID的所有等价最短路径的下一跳写入nextNodes, 第一个是dvtable_update()给出的下一跳.
+ *          nextNodes至少应有MAX_ECMP_PATHS个元素. 返回下一跳数, 目的节点不可达时返回0.
+ * 
+ * @param dvtable 
+ * @param destNodeID 
+ * @param nextNodes 
+ * @return int 
+ */
+int dvtable_getnexthops(dv_t* dvtable, int destNodeID, int* nextNodes);
+
+
+/**
+ * @brief   这个函数返回到目的节点destNodeID的无环备份下一跳, 没有时返回-1.
+ * @details 备份下一跳是满足 D(v,y) < D(v,x) + D(x,y) 的邻居中代价最小的一个, 它不是等价的下一跳,
+ *          所以所有等价的下一跳都断开时才会用到它. 它和下一跳一起由dvtable_update()等函数重新计算.
+ *
+ * @param dvtable
+ * @param destNodeID
+ * @return int
+ */
+int dvtable_getbackup(dv_t* dvtable, int destNodeID);
+
+
 /**
  * @brief   这个函数打印距离矢量表的内容.
  * 
@@ -80,4 +216,4 @@ unsigned int dvtable_getcost(dv_t* dvtable, int fromNodeID, int toNodeID);
  */
 void dvtable_print(dv_t* dvtable);
 
-#endif
\ No newline at end of file
+#endif
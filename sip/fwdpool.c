@@ -0,0 +1,110 @@
+/**
+ * @file    sip/fwdpool.c
+ * @brief   这个文件实现SIP进程的转发线程池.
+ * @date    2023-03-28
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "fwdpool.h"
+
+
+// 转发线程: 每次取出环形缓冲区中所有的报文, 在锁外逐个处理
+static void* worker(void* arg)
+{
+	fwd_worker_t* w = (fwd_worker_t*)arg;
+	pthread_mutex_lock(&w->mutex);
+	while (1) {
+		while (w->head == w->tail && !w->stop)
+			pthread_cond_wait(&w->ready, &w->mutex);
+		if (w->stop)
+			break;
+		unsigned int tail = w->tail;
+		pthread_mutex_unlock(&w->mutex);
+		// 生产者只写head到tail之外的位置, 处理期间这些报文不会被覆盖
+		for (unsigned int i = w->head; i != tail; i++)
+			w->forward(w, &w->ring[i % w->size]);
+		pthread_mutex_lock(&w->mutex);
+		w->head = tail;
+	}
+	pthread_mutex_unlock(&w->mutex);
+	return NULL;
+}
+
+
+fwdpool_t* fwdpool_create(int num, int size, void (*forward)(fwd_worker_t* w, fwd_item_t* item))
+{
+	fwdpool_t* pool = (fwdpool_t*)malloc(sizeof(fwdpool_t));
+	assert(pool != NULL);
+	pool->num = num;
+	pool->worker = (fwd_worker_t*)calloc(num > 0 ? num : 1, sizeof(fwd_worker_t));
+	for (int i = 0; i < num; i++) {
+		fwd_worker_t* w = &pool->worker[i];
+		w->id = i;
+		w->size = size;
+		w->ring = (fwd_item_t*)malloc(sizeof(fwd_item_t) * size);
+		assert(w->ring != NULL);
+		w->forward = forward;
+		pthread_mutex_init(&w->mutex, NULL);
+		pthread_cond_init(&w->ready, NULL);
+		pthread_create(&w->thread, NULL, worker, w);
+	}
+	return pool;
+}
+
+
+void fwdpool_destroy(fwdpool_t* pool)
+{
+	for (int i = 0; i < pool->num; i++) {
+		fwd_worker_t* w = &pool->worker[i];
+		pthread_mutex_lock(&w->mutex);
+		w->stop = 1;
+		pthread_cond_signal(&w->ready);
+		pthread_mutex_unlock(&w->mutex);
+		pthread_join(w->thread, NULL);
+		pthread_mutex_destroy(&w->mutex);
+		pthread_cond_destroy(&w->ready);
+		free(w->ring);
+	}
+	free(pool->worker);
+	free(pool);
+}
+
+
+int fwdpool_put(fwdpool_t* pool, unsigned int hash, sip_pkt_t* pkt, int local)
+{
+	if (pkt->header.length > MAX_PKT_LEN)
+		return -1;
+	fwd_worker_t* w = &pool->worker[hash % pool->num];
+	pthread_mutex_lock(&w->mutex);
+	if (w->tail - w->head >= (unsigned int)w->size) {
+		w->overflow++;
+		pthread_mutex_unlock(&w->mutex);
+		return -1;
+	}
+	// 只复制首部和有效数据
+	fwd_item_t* item = &w->ring[w->tail % w->size];
+	item->local = local;
+	memcpy(&item->pkt, pkt, sizeof(sip_hdr_t) + pkt->header.length);
+	if (w->tail++ == w->head)
+		pthread_cond_signal(&w->ready);
+	pthread_mutex_unlock(&w->mutex);
+	return 1;
+}
+
+
+void fwdpool_print(fwdpool_t* pool)
+{
+	unsigned long expired = 0, looped = 0;
+	for (int i = 0; i < pool->num; i++) {
+		fwd_worker_t* w = &pool->worker[i];
+		printf("SIP: WORKER[%d]: %lu FORWARDED, %lu DELIVERED, %lu BUSY, %lu NO ROUTE, %lu OVERFLOW, %lu TTL EXPIRED, %lu LOOPED\n",
+			w->id, w->forwarded, w->delivered, w->busy, w->noroute, w->overflow, w->expired, w->looped);
+		expired += w->expired;
+		looped += w->looped;
+	}
+	printf("SIP: %lu PKTS DROPPED FOR TTL, %lu PKTS CAME BACK TO THIS NODE\n", expired, looped);
+}
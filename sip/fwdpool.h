@@ -0,0 +1,89 @@
+/**
+ * @file    sip/fwdpool.h
+ * @brief   这个文件定义SIP进程的转发线程池.
+ * @date    2023-03-28
+ */
+
+
+#ifndef FWDPOOL_H
+#define FWDPOOL_H
+
+#include <pthread.h>
+#include "../common/pkt.h"
+
+//接收线程和STCP线程按流的哈希值把数据报文分给转发线程, 同一个流的报文总是由同一个转发线程按顺序处理.
+//每个转发线程有自己的报文环形缓冲区和统计信息, 所有转发线程无锁读取同一个路由表快照(见rcu.h).
+
+//环形缓冲区中的一个报文
+typedef struct fwditem {
+	int local;                  //为1表示报文来自本节点的STCP进程, 否则是从邻居收到的
+	sip_pkt_t pkt;
+} fwd_item_t;
+
+typedef struct fwdworker {
+	int id;                     //转发线程的编号
+	fwd_item_t* ring;           //预先分配的报文环形缓冲区
+	int size;                   //环形缓冲区的大小
+	unsigned int head;          //转发线程下一个要处理的报文, 只有转发线程修改
+	unsigned int tail;          //生产者下一个要写入的位置
+	int stop;                   //为1时转发线程退出
+	pthread_mutex_t mutex;      //保护head, tail和stop
+	pthread_cond_t ready;       //环形缓冲区从空变为非空时通知转发线程
+	pthread_t thread;
+	unsigned long forwarded;    //转发给下一跳的报文数
+	unsigned long delivered;    //交给本节点STCP进程的报文数
+	unsigned long busy;         //因为下一跳没有信用或者到SON进程的队列已满而丢弃的报文数
+	unsigned long noroute;      //因为没有路由而丢弃的报文数
+	unsigned long expired;      //因为跳数限制减到0而丢弃的报文数
+	unsigned long looped;       //源节点是本节点的转发报文数: 报文回到了发出它的节点, 说明有路由环路
+	unsigned long overflow;     //因为环形缓冲区满而丢弃的报文数, 由生产者在mutex下更新
+	void (*forward)(struct fwdworker* w, fwd_item_t* item);   //处理一个报文, 并更新统计信息
+} fwd_worker_t;
+
+typedef struct fwdpool {
+	int num;                    //转发线程数
+	fwd_worker_t* worker;
+} fwdpool_t;
+
+
+/**
+ * @brief   这个函数创建num个转发线程, 每个线程有一个容纳size个报文的环形缓冲区, 用forward处理报文.
+ *          size必须是2的幂, 这样环形缓冲区的下标回绕时仍然连续.
+ * 
+ * @param num 
+ * @param size 
+ * @param forward 
+ * @return fwdpool_t* 
+ */
+fwdpool_t* fwdpool_create(int num, int size, void (*forward)(fwd_worker_t* w, fwd_item_t* item));
+
+
+/**
+ * @brief   这个函数停止所有转发线程并释放线程池, 环形缓冲区中还没有处理的报文被丢弃.
+ * 
+ * @param pool 
+ */
+void fwdpool_destroy(fwdpool_t* pool);
+
+
+/**
+ * @brief   这个函数把报文复制到哈希值为hash的流所属的转发线程的环形缓冲区中.
+ *          成功返回1, 环形缓冲区满时丢弃报文并返回-1.
+ * 
+ * @param pool 
+ * @param hash 
+ * @param pkt 
+ * @param local 
+ * @return int 
+ */
+int fwdpool_put(fwdpool_t* pool, unsigned int hash, sip_pkt_t* pkt, int local);
+
+
+/**
+ * @brief   这个函数打印每个转发线程的统计信息.
+ * 
+ * @param pool 
+ */
+void fwdpool_print(fwdpool_t* pool);
+
+#endif
@@ -0,0 +1,146 @@
+/**
+ * @file    sip/holdqueue.c
+ * @brief   这个文件实现用于暂存还没有路由的报文的数据结构和函数.
+ * @date    2023-04-03
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "../common/constants.h"
+#include "../topology/topology.h"
+#include "holdqueue.h"
+
+
+// 丢弃一个目的节点队首超时的报文, 返回丢弃的报文数. 调用者应持有mutex
+static int dropaged(holdqueue_t* hq, hold_dest_t* d, long now)
+{
+    int n = 0;
+    while (d->num > 0 && now - d->ring[d->head].at >= hq->maxAge) {
+        d->head = (d->head + 1) % hq->size;
+        d->num--;
+        n++;
+    }
+    hq->heldNum -= n;
+    hq->aged += n;
+    return n;
+}
+
+
+holdqueue_t* holdqueue_create(int size, long maxAge)
+{
+    int* nodeArr = topology_getNodeArray();
+    holdqueue_t* hq = (holdqueue_t*)malloc(sizeof(holdqueue_t));
+    assert(hq != NULL);
+    hq->nodeNum = topology_getNodeNum();
+    hq->nodeID = (int*)malloc(sizeof(int) * (hq->nodeNum > 0 ? hq->nodeNum : 1));
+    for (int i = 0; i < hq->nodeNum; i++)
+        hq->nodeID[i] = nodeArr[i];
+    hq->dest = (hold_dest_t*)calloc(hq->nodeNum > 0 ? hq->nodeNum : 1, sizeof(hold_dest_t));
+    hq->size = size > 0 ? size : 1;
+    hq->maxAge = maxAge;
+    hq->heldNum = 0;
+    pthread_mutex_init(&hq->mutex, NULL);
+    hq->held = 0;
+    hq->released = 0;
+    hq->aged = 0;
+    hq->overflow = 0;
+    free(nodeArr);
+    return hq;
+}
+
+
+void holdqueue_destroy(holdqueue_t* hq)
+{
+    for (int i = 0; i < hq->nodeNum; i++)
+        free(hq->dest[i].ring);
+    free(hq->dest);
+    free(hq->nodeID);
+    pthread_mutex_destroy(&hq->mutex);
+    free(hq);
+}
+
+
+int holdqueue_put(holdqueue_t* hq, fwd_item_t* item, long now)
+{
+    int i = topology_getNodeIndex(item->pkt.header.dest_nodeID);
+    if (i < 0)
+        return -1;
+    pthread_mutex_lock(&hq->mutex);
+    hold_dest_t* d = &hq->dest[i];
+    if (d->ring == NULL)
+        d->ring = (hold_item_t*)malloc(sizeof(hold_item_t) * hq->size);
+    if (d->num == hq->size)
+        dropaged(hq, d, now);
+    if (d->ring == NULL || d->num == hq->size) {
+        hq->overflow++;
+        pthread_mutex_unlock(&hq->mutex);
+        return -1;
+    }
+    hold_item_t* h = &d->ring[(d->head + d->num) % hq->size];
+    h->at = now;
+    // 只复制报文的有效部分
+    h->item.local = item->local;
+    memcpy(&h->item.pkt, &item->pkt, sizeof(sip_hdr_t) + item->pkt.header.length);
+    d->num++;
+    hq->heldNum++;
+    hq->held++;
+    pthread_mutex_unlock(&hq->mutex);
+    return 1;
+}
+
+
+int holdqueue_held(holdqueue_t* hq, int destNodeID)
+{
+    // 大多数时候没有暂存的报文, 不加锁
+    int i = topology_getNodeIndex(destNodeID);
+    if (i < 0 || atomic_load(&hq->heldNum) == 0)
+        return 0;
+    pthread_mutex_lock(&hq->mutex);
+    int n = hq->dest[i].num;
+    pthread_mutex_unlock(&hq->mutex);
+    return n;
+}
+
+
+int holdqueue_release(holdqueue_t* hq, long now, int (*routable)(int destNodeID), void (*release)(fwd_item_t* item))
+{
+    int n = 0;
+    pthread_mutex_lock(&hq->mutex);
+    for (int i = 0; i < hq->nodeNum && hq->heldNum > 0; i++) {
+        hold_dest_t* d = &hq->dest[i];
+        if (d->num == 0 || !routable(hq->nodeID[i]))
+            continue;
+        dropaged(hq, d, now);
+        while (d->num > 0) {
+            release(&d->ring[d->head].item);
+            d->head = (d->head + 1) % hq->size;
+            d->num--;
+            hq->heldNum--;
+            n++;
+        }
+    }
+    hq->released += n;
+    pthread_mutex_unlock(&hq->mutex);
+    return n;
+}
+
+
+int holdqueue_expire(holdqueue_t* hq, long now)
+{
+    int n = 0;
+    pthread_mutex_lock(&hq->mutex);
+    for (int i = 0; i < hq->nodeNum && hq->heldNum > 0; i++)
+        n += dropaged(hq, &hq->dest[i], now);
+    pthread_mutex_unlock(&hq->mutex);
+    return n;
+}
+
+
+void holdqueue_print(holdqueue_t* hq)
+{
+    printf("SIP: HOLD QUEUE: %lu PKTS HELD, %lu RELEASED, %lu AGED OUT, %lu OVERFLOWED, %d STILL HELD\n",
+        hq->held, hq->released, hq->aged, hq->overflow, atomic_load(&hq->heldNum));
+}
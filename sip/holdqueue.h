@@ -0,0 +1,117 @@
+/**
+ * @file    sip/holdqueue.h
+ * @brief   这个文件定义用于暂存还没有路由的报文的数据结构和函数.
+ * @date    2023-04-03
+ */
+
+
+#ifndef HOLDQUEUE_H
+#define HOLDQUEUE_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include "fwdpool.h"
+
+//暂存队列中的一个报文
+typedef struct holditem {
+	long at;                    //报文进入暂存队列的时刻(毫秒)
+	fwd_item_t item;
+} hold_item_t;
+
+//一个目的节点的暂存队列, 是一个环形缓冲区, 第一次暂存发往这个节点的报文时分配
+typedef struct holddest {
+	hold_item_t* ring;
+	int head;                   //最早的报文的下标
+	int num;                    //暂存的报文数
+} hold_dest_t;
+
+//暂存队列保存路由收敛期间没有路由的报文, 路由出现后按原来的顺序交回转发线程, 而不是丢弃后等待STCP超时重传.
+//每个目的节点最多暂存size个报文, 超过maxAge毫秒的报文被丢弃.
+typedef struct holdqueue {
+	int nodeNum;                //重叠网络中总的节点数
+	int* nodeID;                //第i个节点的ID
+	int size;                   //每个目的节点最多暂存的报文数
+	long maxAge;                //报文最多暂存的时间(毫秒)
+	hold_dest_t* dest;          //每个节点一个暂存队列
+	_Atomic int heldNum;        //所有暂存队列中的报文数, 转发线程不加锁读取它来判断是否有暂存的报文
+	pthread_mutex_t mutex;      //保护所有暂存队列和统计信息
+	unsigned long held;         //暂存过的报文数
+	unsigned long released;     //路由出现后交回的报文数
+	unsigned long aged;         //因为超时而丢弃的报文数
+	unsigned long overflow;     //因为暂存队列满而丢弃的报文数
+} holdqueue_t;
+
+
+/**
+ * @brief   这个函数创建暂存队列, 每个目的节点最多暂存size个报文, 每个报文最多暂存maxAge毫秒.
+ *
+ * @param size
+ * @param maxAge
+ * @return holdqueue_t*
+ */
+holdqueue_t* holdqueue_create(int size, long maxAge);
+
+
+/**
+ * @brief   这个函数删除暂存队列, 丢弃其中所有的报文.
+ *
+ * @param hq
+ */
+void holdqueue_destroy(holdqueue_t* hq);
+
+
+/**
+ * @brief   这个函数在now时刻(毫秒)暂存一个发往item->pkt.header.dest_nodeID的报文.
+ *          队列满时先丢弃超时的报文, 仍然满时返回-1, 目的节点不在重叠网络中时也返回-1. 成功时返回1.
+ *
+ * @param hq
+ * @param item
+ * @param now
+ * @return int
+ */
+int holdqueue_put(holdqueue_t* hq, fwd_item_t* item, long now);
+
+
+/**
+ * @brief   这个函数返回发往destNodeID的暂存报文数. 有暂存报文时, 同一个目的节点的新报文也应暂存, 保持原来的顺序.
+ *
+ * @param hq
+ * @param destNodeID
+ * @return int
+ */
+int holdqueue_held(holdqueue_t* hq, int destNodeID);
+
+
+/**
+ * @brief   这个函数在now时刻(毫秒)交回所有routable()返回非0的目的节点的暂存报文.
+ * @details 每个报文按暂存的顺序交给release(), 超时的报文被丢弃. release()在暂存队列的锁内调用,
+ *          这样同一个目的节点的新报文在交回的报文之后处理. release()不应阻塞, 也不应再调用暂存队列的函数.
+ *          返回交回的报文数.
+ *
+ * @param hq
+ * @param now
+ * @param routable
+ * @param release
+ * @return int
+ */
+int holdqueue_release(holdqueue_t* hq, long now, int (*routable)(int destNodeID), void (*release)(fwd_item_t* item));
+
+
+/**
+ * @brief   这个函数丢弃在now时刻(毫秒)已经超时的暂存报文, 返回丢弃的报文数.
+ *
+ * @param hq
+ * @param now
+ * @return int
+ */
+int holdqueue_expire(holdqueue_t* hq, long now);
+
+
+/**
+ * @brief   这个函数打印暂存队列的统计信息.
+ *
+ * @param hq
+ */
+void holdqueue_print(holdqueue_t* hq);
+
+#endif
@@ -0,0 +1,242 @@
+/**
+ * @file    sip/lsdb.c
+ * @brief   这个文件实现用于链路状态数据库的数据结构和函数.
+ * @date    2023-03-20
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <assert.h>
+#include "../common/constants.h"
+#include "../topology/topology.h"
+#include "lsdb.h"
+
+
+// 返回第u个节点的LSA中到节点v的链路代价, 没有这条链路时返回INFINITE_COST
+static unsigned int linkcost(lsdb_t* lsdb, int u, int v)
+{
+    pkt_lsa_t* lsa = &lsdb->lsa[u];
+    if (!lsdb->valid[u])
+        return INFINITE_COST;
+    for (int k = 0; k < lsa->linkNum; k++)
+        if (lsa->link[k].nodeID == lsdb->nodeID[v])
+            return lsa->link[k].cost;
+    return INFINITE_COST;
+}
+
+// 向二叉堆中插入一个元素
+static void heappush(lsdb_t* lsdb, int* n, unsigned int dist, int idx)
+{
+    if (*n == lsdb->heapSize) {
+        lsdb->heapSize *= 2;
+        lsdb->heap = (spf_heap_entry_t*)realloc(lsdb->heap, sizeof(spf_heap_entry_t) * lsdb->heapSize);
+        assert(lsdb->heap != NULL);
+    }
+    spf_heap_entry_t* heap = lsdb->heap;
+    int i = (*n)++;
+    while (i > 0 && heap[(i - 1) / 2].dist > dist) {
+        heap[i] = heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap[i].dist = dist;
+    heap[i].idx = idx;
+}
+
+// 取出二叉堆中代价最小的元素
+static spf_heap_entry_t heappop(lsdb_t* lsdb, int* n)
+{
+    spf_heap_entry_t* heap = lsdb->heap;
+    spf_heap_entry_t top = heap[0], last = heap[--(*n)];
+    int i = 0;
+    while (2 * i + 1 < *n) {
+        int c = 2 * i + 1;
+        if (c + 1 < *n && heap[c + 1].dist < heap[c].dist)
+            c++;
+        if (heap[c].dist >= last.dist)
+            break;
+        heap[i] = heap[c];
+        i = c;
+    }
+    heap[i] = last;
+    return top;
+}
+
+
+lsdb_t* lsdb_create(nbr_cost_entry_t* nct)
+{
+    int* nodeArr = topology_getNodeArray();
+    int nodeNum = topology_getNodeNum();
+    int myNodeID = topology_getMyNodeID();
+    lsdb_t* lsdb = (lsdb_t*)malloc(sizeof(lsdb_t));
+    assert(lsdb != NULL);
+    lsdb->nodeNum = nodeNum;
+    lsdb->nodeID = (int*)malloc(sizeof(int) * nodeNum);
+    lsdb->valid = (int*)malloc(sizeof(int) * nodeNum);
+    lsdb->lsa = (pkt_lsa_t*)malloc(sizeof(pkt_lsa_t) * nodeNum);
+    lsdb->dist = (unsigned int*)malloc(sizeof(unsigned int) * nodeNum);
+    lsdb->next = (int*)malloc(sizeof(int) * nodeNum);
+    lsdb->nextSet = (unsigned long long*)malloc(sizeof(unsigned long long) * nodeNum);
+    lsdb->done = (int*)malloc(sizeof(int) * nodeNum);
+    // 每条链路最多使一个节点入堆一次, 链路多时堆按需增长
+    lsdb->heapSize = nodeNum * 4 + 1;
+    lsdb->heap = (spf_heap_entry_t*)malloc(sizeof(spf_heap_entry_t) * lsdb->heapSize);
+    for (int i = 0; i < nodeNum; i++) {
+        lsdb->nodeID[i] = nodeArr[i];
+        lsdb->valid[i] = 0;
+        lsdb->dist[i] = INFINITE_COST;
+        lsdb->next[i] = -1;
+        lsdb->nextSet[i] = 0;
+    }
+    lsdb->self = topology_getNodeIndex(myNodeID);
+    assert(lsdb->self >= 0);
+    lsdb->dist[lsdb->self] = 0;
+
+    // 序号从当前时间开始, 第一次调用lsdb_originate()时加1
+    pkt_lsa_t lsa;
+    lsdb->lsa[lsdb->self].seq = (unsigned int)time(NULL);
+    lsdb_originate(lsdb, nct, &lsa);
+    free(nodeArr);
+    return lsdb;
+}
+
+
+void lsdb_destroy(lsdb_t* lsdb)
+{
+    free(lsdb->nodeID);
+    free(lsdb->valid);
+    free(lsdb->lsa);
+    free(lsdb->dist);
+    free(lsdb->next);
+    free(lsdb->nextSet);
+    free(lsdb->done);
+    free(lsdb->heap);
+    free(lsdb);
+}
+
+
+void lsdb_originate(lsdb_t* lsdb, nbr_cost_entry_t* nct, pkt_lsa_t* lsa)
+{
+    pkt_lsa_t* mine = &lsdb->lsa[lsdb->self];
+    int nbrNum = topology_getNbrNum();
+    mine->nodeID = lsdb->nodeID[lsdb->self];
+    mine->seq++;
+    mine->linkNum = 0;
+    for (int i = 0; i < nbrNum && i < LSA_MAX_LINKS; i++) {
+        mine->link[mine->linkNum].nodeID = nct[i].nodeID;
+        mine->link[mine->linkNum].cost = nct[i].cost;
+        mine->linkNum++;
+    }
+    lsdb->valid[lsdb->self] = 1;
+    memcpy(lsa, mine, sizeof(pkt_lsa_t));
+}
+
+
+int lsdb_install(lsdb_t* lsdb, pkt_lsa_t* lsa)
+{
+    int u = topology_getNodeIndex(lsa->nodeID);
+    if (u < 0 || u == lsdb->self || lsa->linkNum > LSA_MAX_LINKS)
+        return 0;
+    if (lsdb->valid[u] && !pkt_seqnewer(lsa->seq, lsdb->lsa[u].seq))
+        return 0;
+    memcpy(&lsdb->lsa[u], lsa, sizeof(pkt_lsa_t));
+    lsdb->valid[u] = 1;
+    return 1;
+}
+
+
+int lsdb_spf(lsdb_t* lsdb, int* dests, int* nextNodes)
+{
+    int nodeNum = lsdb->nodeNum, self = lsdb->self;
+    unsigned long long* oldSet = (unsigned long long*)malloc(sizeof(unsigned long long) * nodeNum);
+    int* oldNext = (int*)malloc(sizeof(int) * nodeNum);
+    int heapNum = 0, n = 0;
+
+    for (int i = 0; i < nodeNum; i++) {
+        oldSet[i] = lsdb->nextSet[i];
+        oldNext[i] = lsdb->next[i];
+        lsdb->dist[i] = INFINITE_COST;
+        lsdb->next[i] = -1;
+        lsdb->nextSet[i] = 0;
+        lsdb->done[i] = 0;
+    }
+    lsdb->dist[self] = 0;
+    heappush(lsdb, &heapNum, 0, self);
+    while (heapNum > 0) {
+        spf_heap_entry_t top = heappop(lsdb, &heapNum);
+        int u = top.idx;
+        // 同一个节点可能多次入堆, 只处理代价最小的那次
+        if (lsdb->done[u])
+            continue;
+        lsdb->done[u] = 1;
+        pkt_lsa_t* lsa = &lsdb->lsa[u];
+        for (int k = 0; k < lsa->linkNum; k++) {
+            int v = topology_getNodeIndex(lsa->link[k].nodeID);
+            if (v < 0 || lsdb->done[v] || lsa->link[k].cost >= INFINITE_COST)
+                continue;
+            // 双向检查: 对端的LSA也必须包含这条链路
+            if (linkcost(lsdb, v, u) >= INFINITE_COST)
+                continue;
+            unsigned int d = top.dist + lsa->link[k].cost;
+            // 从这个节点直接到达的节点, 下一跳就是它本身, 否则沿用父节点的下一跳.
+            // 等价的下一跳集合只记录这个节点的前64条链路
+            int next = u == self ? lsdb->nodeID[v] : lsdb->next[u];
+            unsigned long long hops = u != self ? lsdb->nextSet[u] : k < 64 ? 1ULL << k : 0;
+            if (d < lsdb->dist[v]) {
+                lsdb->dist[v] = d;
+                lsdb->next[v] = next;
+                lsdb->nextSet[v] = hops;
+                heappush(lsdb, &heapNum, d, v);
+            } else if (d == lsdb->dist[v]) {
+                // 等价路径: 合并下一跳. 链路代价为正, 所以v出堆前它的所有等价父节点都已经处理过
+                lsdb->nextSet[v] |= hops;
+            }
+        }
+    }
+
+    for (int i = 0; i < nodeNum; i++) {
+        if (i != self && (lsdb->next[i] != oldNext[i] || lsdb->nextSet[i] != oldSet[i])) {
+            dests[n] = lsdb->nodeID[i];
+            nextNodes[n++] = lsdb->next[i];
+        }
+    }
+    free(oldSet);
+    free(oldNext);
+    return n;
+}
+
+
+int lsdb_getnexthops(lsdb_t* lsdb, int destNodeID, int* nextNodes)
+{
+    int i = topology_getNodeIndex(destNodeID), n = 0;
+    pkt_lsa_t* mine = &lsdb->lsa[lsdb->self];
+    if (i < 0 || lsdb->next[i] < 0)
+        return 0;
+    nextNodes[n++] = lsdb->next[i];
+    for (int k = 0; k < mine->linkNum && k < 64 && n < MAX_ECMP_PATHS; k++)
+        if (((lsdb->nextSet[i] >> k) & 1) && (int)mine->link[k].nodeID != lsdb->next[i])
+            nextNodes[n++] = mine->link[k].nodeID;
+    return n;
+}
+
+
+void lsdb_print(lsdb_t* lsdb)
+{
+    printf("---------LINK STATE DATABASE---------\n");
+    for (int i = 0; i < lsdb->nodeNum; i++) {
+        printf("LSA[%d]: ", lsdb->nodeID[i]);
+        if (!lsdb->valid[i]) {
+            printf("NONE\n");
+            continue;
+        }
+        printf("[SEQ: %u] ", lsdb->lsa[i].seq);
+        for (int k = 0; k < lsdb->lsa[i].linkNum; k++)
+            printf("[NBR: %d |COST: %d] ", lsdb->lsa[i].link[k].nodeID, lsdb->lsa[i].link[k].cost);
+        printf("\n");
+    }
+    for (int i = 0; i < lsdb->nodeNum; i++)
+        printf("[DEST: %d |COST: %d |NEXT: %d] ", lsdb->nodeID[i], lsdb->dist[i], lsdb->next[i]);
+    printf("\n-------------------------------------\n");
+}
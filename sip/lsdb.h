@@ -0,0 +1,116 @@
+/**
+ * @file    sip/lsdb.h
+ * @brief   这个文件定义用于链路状态数据库的数据结构和函数.
+ * @date    2023-03-20
+ */
+
+
+#ifndef LSDB_H
+#define LSDB_H
+
+#include "../common/pkt.h"
+#include "nbrcosttable.h"
+
+
+//Dijkstra算法使用的二叉堆中的元素
+typedef struct spfheapentry {
+	unsigned int dist;      //从这个节点到该节点的路径代价
+	int idx;                //节点的下标
+} spf_heap_entry_t;
+
+//链路状态数据库保存重叠网络中每个节点最新的LSA, 以及用它们计算出的最短路径树.
+//节点ID通过topology_getNodeIndex()转换为稠密的下标, 每个节点一个条目.
+typedef struct linkstatedb {
+	int nodeNum;            //重叠网络中总的节点数
+	int self;               //这个节点的下标
+	int* nodeID;            //第i个节点的ID
+	int* valid;             //valid[i]为1表示已经收到了第i个节点的LSA
+	pkt_lsa_t* lsa;         //lsa[i]是第i个节点最新的LSA
+	unsigned int* dist;     //最短路径计算的结果: 到第i个节点的路径代价
+	int* next;              //最短路径计算的结果: 到第i个节点的下一跳节点ID, 不可达时为-1
+	unsigned long long* nextSet;    //最短路径计算的结果: 到第i个节点的所有等价最短路径的下一跳, 第k位对应这个节点的LSA中的第k条链路, 只记录前64条链路
+	int* done;              //lsdb_spf()使用: 第i个节点的最短路径已经确定
+	int heapSize;           //lsdb_spf()使用的二叉堆的容量, 不够时加倍
+	spf_heap_entry_t* heap; //lsdb_spf()使用的二叉堆
+} lsdb_t;
+
+
+/**
+ * @brief   这个函数动态创建链路状态数据库, 重叠网络中的每个节点一个条目.
+ *          这个节点的LSA使用邻居代价表生成并加入数据库, 序号从当前时间开始,
+ *          这样节点重启后生成的LSA总是比重启前的新. 其他节点的条目在收到它们的LSA前是无效的.
+ *
+ * @param nct
+ * @return lsdb_t*
+ */
+lsdb_t* lsdb_create(nbr_cost_entry_t* nct);
+
+
+/**
+ * @brief   这个函数删除链路状态数据库.
+ *          它释放所有为链路状态数据库动态分配的内存.
+ *
+ * @param lsdb
+ */
+void lsdb_destroy(lsdb_t* lsdb);
+
+
+/**
+ * @brief   这个函数用邻居代价表重新生成这个节点的LSA, 序号加1,
+ *          把它保存到数据库中并复制到lsa, 用于泛洪.
+ *
+ * @param lsdb
+ * @param nct
+ * @param lsa
+ */
+void lsdb_originate(lsdb_t* lsdb, nbr_cost_entry_t* nct, pkt_lsa_t* lsa);
+
+
+/**
+ * @brief   这个函数把收到的LSA加入数据库.
+ *          如果LSA来自重叠网络中的其他节点, 并且比数据库中该节点的LSA新, 就替换它并返回1.
+ *          否则(重复或过时的LSA, 或者是这个节点自己的LSA)返回0, 这样的LSA不应再泛洪.
+ *
+ * @param lsdb
+ * @param lsa
+ * @return int
+ */
+int lsdb_install(lsdb_t* lsdb, pkt_lsa_t* lsa);
+
+
+/**
+ * @brief   这个函数用二叉堆实现的Dijkstra算法计算从这个节点到所有节点的最短路径.
+ *          只使用两端的LSA都包含的链路(双向检查), 这样单方面失效的链路不会被使用.
+ *          代价相同的多条最短路径的下一跳都被记录下来(等价多路径).
+ *          下一跳(包括等价的下一跳)改变了的目的节点ID写入dests, 新的下一跳写入nextNodes(不可达时为-1),
+ *          两个数组至少应有nodeNum个元素. 返回下一跳改变了的目的节点数.
+ *
+ * @param lsdb
+ * @param dests
+ * @param nextNodes
+ * @return int
+ */
+int lsdb_spf(lsdb_t* lsdb, int* dests, int* nextNodes);
+
+
+/**
+ * @brief   这个函数把最近一次最短路径计算得到的到destNodeID的所有等价下一跳写入nextNodes,
+ *          第一个是lsdb_spf()给出的下一跳. nextNodes至少应有MAX_ECMP_PATHS个元素.
+ *          返回下一跳数, 目的节点不可达时返回0.
+ *
+ * @param lsdb
+ * @param destNodeID
+ * @param nextNodes
+ * @return int
+ */
+int lsdb_getnexthops(lsdb_t* lsdb, int destNodeID, int* nextNodes);
+
+
+/**
+ * @brief   这个函数打印链路状态数据库的内容和最短路径.
+ *
+ * @param lsdb
+ */
+void lsdb_print(lsdb_t* lsdb);
+
+#endif
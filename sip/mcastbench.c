@@ -0,0 +1,240 @@
+/**
+ * @file    sip/mcastbench.c
+ * @brief   这个文件实现组播树复制的基准测试程序.
+ *          它在一个进程中为合成拓扑(线形或环形, 链路代价为1; 或者在环形上随机加入弦的网状拓扑, 链路代价为1到5)的每个节点
+ *          建立最短路径(包括等价路径)路由表和组播组成员表, 成员关系像SIP进程一样通过组成员报告传给所有节点.
+ *          然后从节点1向组发送组播报文, 每个节点用与SIP进程相同的mcasttable_partition()按下一跳复制,
+ *          统计每个报文在链路上的副本数, 与向每个成员单独发送单播报文时的链路副本数比较,
+ *          并检查每个成员正好收到一次, 非成员没有收到.
+ *          每种成员数发送FLOWS个流的报文, 不同的流在等价路径上可能经过不同的树.
+ *          用法: ./sip/mcastbench line|ring|mesh [节点数] [成员数]
+ *          不给出成员数时依次测试1个, 四分之一, 一半和除节点1外所有节点是成员的情况. 结果输出到标准错误.
+ * @date    2023-04-04
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../common/constants.h"
+#include "../common/pkt.h"
+#include "../topology/topology.h"
+#include "routingtable.h"
+#include "mcasttable.h"
+
+//每种成员数发送的流数
+#define FLOWS 16
+//测试使用的组号
+#define GROUP 1
+
+//节点数, 节点ID从1到nodeNum
+int nodeNum;
+//每个节点的路由表和组播组成员表, 下标是节点ID
+routingtable_t** rts;
+mcasttable_t** mts;
+//dist[a * (nodeNum + 1) + b]是节点a到节点b的最短路径代价
+unsigned int* dist;
+
+
+// 计算所有节点对之间的最短路径代价, 并为每个节点建立包含所有等价下一跳的路由表
+static void buildroutes()
+{
+    int n1 = nodeNum + 1;
+    dist = (unsigned int*)malloc(sizeof(unsigned int) * n1 * n1);
+    for (int a = 1; a <= nodeNum; a++)
+        for (int b = 1; b <= nodeNum; b++)
+            dist[a * n1 + b] = a == b ? 0 : topology_getCost(a, b);
+    for (int k = 1; k <= nodeNum; k++)
+        for (int a = 1; a <= nodeNum; a++)
+            for (int b = 1; b <= nodeNum; b++)
+                if (dist[a * n1 + k] + dist[k * n1 + b] < dist[a * n1 + b])
+                    dist[a * n1 + b] = dist[a * n1 + k] + dist[k * n1 + b];
+
+    rts = (routingtable_t**)malloc(sizeof(routingtable_t*) * n1);
+    for (int s = 1; s <= nodeNum; s++) {
+        topology_setMyNodeID(s);
+        rts[s] = routingtable_create();
+        int* nbrArr = topology_getNbrArray();
+        int nbrNum = topology_getNbrNum();
+        for (int d = 1; d <= nodeNum; d++) {
+            int hops[MAX_ECMP_PATHS], hopNum = 0;
+            for (int i = 0; i < nbrNum && hopNum < MAX_ECMP_PATHS && d != s; i++)
+                if (topology_getCost(s, nbrArr[i]) + dist[nbrArr[i] * n1 + d] == dist[s * n1 + d])
+                    hops[hopNum++] = nbrArr[i];
+            if (hopNum > 0)
+                routingtable_setnextnodes(rts[s], d, hops, hopNum);
+        }
+        free(nbrArr);
+    }
+}
+
+
+// 让memberNum个节点(不包括节点1)加入组, 成员报告交给所有其他节点, 与泛洪的结果相同. member[i]为1表示节点i是成员
+static void join(int memberNum, int* member)
+{
+    memset(member, 0, sizeof(int) * (nodeNum + 1));
+    // 固定的随机种子, 每次运行的成员相同
+    srand(2);
+    for (int k = 0; k < memberNum; ) {
+        int m = 2 + rand() % (nodeNum - 1);
+        if (!member[m]) {
+            member[m] = 1;
+            k++;
+        }
+    }
+    for (int m = 2; m <= nodeNum; m++) {
+        if (!member[m])
+            continue;
+        pkt_groupreport_t report;
+        mcasttable_join(mts[m], GROUP, 1);
+        int n = mcasttable_report(mts[m], &report);
+        for (int o = 1; o <= nodeNum; o++)
+            if (o != m)
+                mcasttable_install(mts[o], &report, GROUPREPORT_LEN(n), 1);
+    }
+}
+
+
+// 用流哈希值hash从节点1向组发送一个组播报文, 沿组播树复制. 返回链路上的副本数, 每个节点收到的次数累加到got
+static int sendmcast(unsigned int hash, int* got, int* maxBranch)
+{
+    int mapLen = mts[1]->mapLen, nbrMax = nodeNum;
+    // 待处理的报文副本: 所在节点, 剩余跳数和成员位图
+    int cap = nodeNum * SIP_TTL + 1, head = 0, tail = 0, copies = 0;
+    int* at = (int*)malloc(sizeof(int) * cap);
+    int* ttl = (int*)malloc(sizeof(int) * cap);
+    unsigned char* maps = (unsigned char*)malloc((size_t)cap * mapLen);
+    int* branch = (int*)malloc(sizeof(int) * nbrMax);
+    unsigned char* branchMap = (unsigned char*)malloc((size_t)nbrMax * mapLen);
+
+    at[tail] = 1;
+    ttl[tail] = SIP_TTL;
+    mcasttable_getmembers(mts[1], GROUP, maps);
+    tail++;
+    while (head < tail) {
+        int node = at[head], t = ttl[head];
+        unsigned char* map = maps + (size_t)head * mapLen;
+        head++;
+        mcasttable_t* mt = mts[node];
+        // 与SIP进程的forwardmcast()相同: 本节点是成员时交付, 其余成员按下一跳分组
+        if (mt->self >= 0 && (map[mt->self / 8] & (1 << (mt->self % 8)))) {
+            got[node]++;
+            map[mt->self / 8] &= ~(1 << (mt->self % 8));
+        }
+        if (node != 1 && --t <= 0)
+            continue;
+        int noroute;
+        int branchNum = mcasttable_partition(mt, map, rts[node], hash, branch, branchMap, nbrMax, &noroute);
+        if (branchNum > *maxBranch)
+            *maxBranch = branchNum;
+        for (int b = 0; b < branchNum && tail < cap; b++) {
+            at[tail] = branch[b];
+            ttl[tail] = t;
+            memcpy(maps + (size_t)tail * mapLen, branchMap + (size_t)b * mapLen, mapLen);
+            tail++;
+            copies++;
+        }
+    }
+    free(at);
+    free(ttl);
+    free(maps);
+    free(branch);
+    free(branchMap);
+    return copies;
+}
+
+
+// 用流哈希值hash从节点1向每个成员单独发送单播报文时, 链路上的副本数
+static int sendunicast(unsigned int hash, int* member)
+{
+    int copies = 0;
+    for (int m = 2; m <= nodeNum; m++) {
+        int cur = 1, len = 0;
+        while (member[m] && cur != m && cur > 0 && len < SIP_TTL) {
+            cur = routingtable_getflownextnode(rts[cur], m, hash);
+            len++;
+        }
+        copies += len;
+    }
+    return copies;
+}
+
+
+// 在给定的拓扑上用memberNum个成员运行一次测试
+static void run(const char* topo, int memberNum)
+{
+    int* member = (int*)malloc(sizeof(int) * (nodeNum + 1));
+    int* got = (int*)malloc(sizeof(int) * (nodeNum + 1));
+    mts = (mcasttable_t**)malloc(sizeof(mcasttable_t*) * (nodeNum + 1));
+    for (int i = 1; i <= nodeNum; i++) {
+        topology_setMyNodeID(i);
+        mts[i] = mcasttable_create();
+    }
+    join(memberNum, member);
+
+    unsigned long mcastCopies = 0, unicastCopies = 0;
+    int maxBranch = 0, wrong = 0;
+    for (int f = 0; f < FLOWS; f++) {
+        // 不同的流使用不同的流哈希值
+        unsigned int hash = (f + 1) * 2654435761u;
+        memset(got, 0, sizeof(int) * (nodeNum + 1));
+        mcastCopies += sendmcast(hash, got, &maxBranch);
+        unicastCopies += sendunicast(hash, member);
+        for (int i = 1; i <= nodeNum; i++)
+            if (got[i] != member[i])
+                wrong++;
+    }
+    fprintf(stderr, "%s %d nodes, %2d members: %6.1f link copies per packet with multicast, %6.1f with unicast (%.2fx), "
+        "max %d branches at a node, %d wrong deliveries in %d packets\n",
+        topo, nodeNum, memberNum, (double)mcastCopies / FLOWS, (double)unicastCopies / FLOWS,
+        mcastCopies ? (double)unicastCopies / mcastCopies : 0.0, maxBranch, wrong, FLOWS);
+
+    for (int i = 1; i <= nodeNum; i++)
+        mcasttable_destroy(mts[i]);
+    free(mts);
+    free(member);
+    free(got);
+}
+
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2 || (strcmp(argv[1], "line") != 0 && strcmp(argv[1], "ring") != 0 && strcmp(argv[1], "mesh") != 0)) {
+        fprintf(stderr, "usage: %s line|ring|mesh [nodes] [members]\n", argv[0]);
+        return 1;
+    }
+    nodeNum = argc > 2 ? atoi(argv[2]) : 16;
+    int memberNum = argc > 3 ? atoi(argv[3]) : 0;
+    if (nodeNum < 3 || memberNum < 0 || memberNum > nodeNum - 1) {
+        fprintf(stderr, "need at least 3 nodes and at most nodes-1 members\n");
+        return 1;
+    }
+    int mesh = strcmp(argv[1], "mesh") == 0;
+    // 与dvbench相同的拓扑: 网状拓扑使用固定的随机种子, 每次运行的拓扑相同
+    srand(1);
+    for (int i = 1; i < nodeNum; i++)
+        topology_addLink(i, i + 1, mesh ? 1 + rand() % 5 : 1);
+    if (strcmp(argv[1], "line") != 0)
+        topology_addLink(nodeNum, 1, mesh ? 1 + rand() % 5 : 1);
+    for (int k = 0; mesh && k < nodeNum / 2; k++) {
+        int a = 1 + rand() % nodeNum, b = 1 + rand() % nodeNum;
+        if (a != b && topology_getCost(a, b) >= INFINITE_COST)
+            topology_addLink(a, b, 1 + rand() % 5);
+    }
+    buildroutes();
+
+    if (memberNum > 0) {
+        run(argv[1], memberNum);
+    } else {
+        int sizes[4] = {1, nodeNum / 4, nodeNum / 2, nodeNum - 1};
+        for (int k = 0; k < 4; k++)
+            if (k == 0 || sizes[k] > sizes[k - 1])
+                run(argv[1], sizes[k]);
+    }
+
+    for (int s = 1; s <= nodeNum; s++)
+        routingtable_destroy(rts[s]);
+    free(rts);
+    free(dist);
+    return 0;
+}
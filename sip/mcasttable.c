@@ -0,0 +1,183 @@
+/**
+ * @file    sip/mcasttable.c
+ * @brief   这个文件实现用于组播组成员表的数据结构和函数.
+ * @date    2023-03-30
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <assert.h>
+#include "../common/constants.h"
+#include "../topology/topology.h"
+#include "mcasttable.h"
+
+
+// 返回第g个组的成员位图
+static inline unsigned char* mapof(mcasttable_t* mt, int g)
+{
+    return mt->member + (size_t)g * mt->mapLen;
+}
+
+// 把第i个节点从所有组中去掉
+static void clearnode(mcasttable_t* mt, int i)
+{
+    for (int g = 0; g < MCAST_MAX_GROUPS; g++)
+        mapof(mt, g)[i / 8] &= ~(1 << (i % 8));
+}
+
+
+mcasttable_t* mcasttable_create()
+{
+    int myNodeID = topology_getMyNodeID();
+    int* nodeArr = topology_getNodeArray();
+    mcasttable_t* mt = (mcasttable_t*)malloc(sizeof(mcasttable_t));
+    assert(mt != NULL);
+    mt->nodeNum = topology_getNodeNum();
+    mt->mapLen = (mt->nodeNum + 7) / 8;
+    mt->nodeID = (int*)malloc(sizeof(int) * (mt->nodeNum > 0 ? mt->nodeNum : 1));
+    // 节点数组按节点ID从小到大排列, 所有节点得到相同的位图编号
+    for (int i = 0; i < mt->nodeNum; i++)
+        mt->nodeID[i] = nodeArr[i];
+    mt->self = topology_getNodeIndex(myNodeID);
+    mt->member = (unsigned char*)calloc((size_t)MCAST_MAX_GROUPS * (mt->mapLen > 0 ? mt->mapLen : 1), 1);
+    mt->seq = (unsigned int*)calloc(mt->nodeNum > 0 ? mt->nodeNum : 1, sizeof(unsigned int));
+    mt->heard = (long*)calloc(mt->nodeNum > 0 ? mt->nodeNum : 1, sizeof(long));
+    mt->mySeq = (unsigned int)time(NULL);
+    free(nodeArr);
+    return mt;
+}
+
+
+void mcasttable_destroy(mcasttable_t* mt)
+{
+    free(mt->nodeID);
+    free(mt->member);
+    free(mt->seq);
+    free(mt->heard);
+    free(mt);
+}
+
+
+int mcasttable_join(mcasttable_t* mt, int group, int join)
+{
+    if (group < 0 || group >= MCAST_MAX_GROUPS || mt->self < 0)
+        return -1;
+    unsigned char* map = mapof(mt, group);
+    unsigned char bit = 1 << (mt->self % 8);
+    if (!(map[mt->self / 8] & bit) == !join)
+        return 0;
+    map[mt->self / 8] ^= bit;
+    return 1;
+}
+
+
+int mcasttable_report(mcasttable_t* mt, pkt_groupreport_t* report)
+{
+    report->nodeID = mt->self >= 0 ? mt->nodeID[mt->self] : topology_getMyNodeID();
+    report->seq = ++mt->mySeq;
+    report->groupNum = 0;
+    for (int g = 0; g < MCAST_MAX_GROUPS && mt->self >= 0; g++)
+        if (mapof(mt, g)[mt->self / 8] & (1 << (mt->self % 8)))
+            report->group[report->groupNum++] = g;
+    return report->groupNum;
+}
+
+
+int mcasttable_install(mcasttable_t* mt, pkt_groupreport_t* report, int length, long now)
+{
+    if (length < (int)GROUPREPORT_LEN(0) || report->groupNum > MCAST_MAX_GROUPS || length < (int)GROUPREPORT_LEN(report->groupNum))
+        return 0;
+    int i = topology_getNodeIndex(report->nodeID);
+    if (i < 0 || i == mt->self)
+        return 0;
+    // 还没有收到过这个节点的报告(或者已经超时清除)时接受任何序号
+    if (mt->heard[i] != 0 && !pkt_seqnewer(report->seq, mt->seq[i]))
+        return 0;
+    mt->seq[i] = report->seq;
+    mt->heard[i] = now;
+    clearnode(mt, i);
+    for (int k = 0; k < report->groupNum; k++)
+        if (report->group[k] < MCAST_MAX_GROUPS)
+            mapof(mt, report->group[k])[i / 8] |= 1 << (i % 8);
+    return 1;
+}
+
+
+int mcasttable_expire(mcasttable_t* mt, long now, long timeout)
+{
+    int n = 0;
+    for (int i = 0; i < mt->nodeNum; i++) {
+        if (i == mt->self || mt->heard[i] == 0 || now - mt->heard[i] < timeout)
+            continue;
+        clearnode(mt, i);
+        mt->heard[i] = 0;
+        n++;
+    }
+    return n;
+}
+
+
+int mcasttable_getmembers(mcasttable_t* mt, int group, unsigned char* map)
+{
+    if (group < 0 || group >= MCAST_MAX_GROUPS)
+        return -1;
+    memcpy(map, mapof(mt, group), mt->mapLen);
+    if (mt->self >= 0)
+        map[mt->self / 8] &= ~(1 << (mt->self % 8));
+    int n = 0;
+    for (int i = 0; i < mt->nodeNum; i++)
+        if (map[i / 8] & (1 << (i % 8)))
+            n++;
+    return n;
+}
+
+
+int mcasttable_partition(mcasttable_t* mt, const unsigned char* map, routingtable_t* rt, unsigned int hash,
+    int* branch, unsigned char* branchMap, int maxBranch, int* noroute)
+{
+    int branchNum = 0;
+    *noroute = 0;
+    for (int i = 0; i < mt->nodeNum; i++) {
+        if (!(map[i / 8] & (1 << (i % 8))))
+            continue;
+        int next = routingtable_getflownextnode(rt, mt->nodeID[i], hash);
+        int b = 0;
+        while (b < branchNum && branch[b] != next)
+            b++;
+        if (next == -1 || (b == branchNum && branchNum == maxBranch)) {
+            (*noroute)++;
+            continue;
+        }
+        if (b == branchNum) {
+            branch[branchNum++] = next;
+            memset(branchMap + (size_t)b * mt->mapLen, 0, mt->mapLen);
+        }
+        branchMap[(size_t)b * mt->mapLen + i / 8] |= 1 << (i % 8);
+    }
+    return branchNum;
+}
+
+
+void mcasttable_print(mcasttable_t* mt)
+{
+    printf("-----------MULTICAST GROUPS----------\n");
+    for (int g = 0; g < MCAST_MAX_GROUPS; g++) {
+        unsigned char* map = mapof(mt, g);
+        int first = 1;
+        for (int i = 0; i < mt->nodeNum; i++) {
+            if (!(map[i / 8] & (1 << (i % 8))))
+                continue;
+            if (first)
+                printf("GROUP[%d]: %d", g, mt->nodeID[i]);
+            else
+                printf(",%d", mt->nodeID[i]);
+            first = 0;
+        }
+        if (!first)
+            printf("\n");
+    }
+    printf("-------------------------------------\n");
+}
@@ -0,0 +1,137 @@
+/**
+ * @file    sip/mcasttable.h
+ * @brief   这个文件定义用于组播组成员表的数据结构和函数.
+ * @date    2023-03-30
+ */
+
+
+#ifndef MCASTTABLE_H
+#define MCASTTABLE_H
+
+#include "../common/pkt.h"
+#include "routingtable.h"
+
+
+//组播组成员表记录重叠网络中每个组播组的成员节点.
+//每个组的成员是一个位图, 第i位对应节点ID第i小的节点, 所有节点的位图编号相同, 可以直接放进组播报文.
+//其他节点的成员关系来自它们泛洪的组成员报告, 本节点的成员关系由本节点的STCP进程加入或离开组时修改.
+typedef struct mcasttable {
+	int nodeNum;            //重叠网络中总的节点数
+	int self;               //这个节点的下标
+	int* nodeID;            //第i个节点的ID, 按节点ID从小到大排列
+	int mapLen;             //一个成员位图的字节数
+	unsigned char* member;  //MCAST_MAX_GROUPS个成员位图, 第g个组的位图从member[g*mapLen]开始
+	unsigned int* seq;      //seq[i]是第i个节点最新的组成员报告的序号
+	long* heard;            //heard[i]是收到第i个节点最新的组成员报告的时刻(秒), 还没有收到时为0
+	unsigned int mySeq;     //本节点上一次组成员报告的序号
+} mcasttable_t;
+
+
+/**
+ * @brief   这个函数动态创建组播组成员表, 所有组都没有成员.
+ *          本节点报告的序号从当前时间开始, 这样节点重启后的报告总是比重启前的新.
+ *
+ * @return mcasttable_t*
+ */
+mcasttable_t* mcasttable_create();
+
+
+/**
+ * @brief   这个函数删除组播组成员表.
+ *          它释放所有为组播组成员表动态分配的内存.
+ *
+ * @param mt
+ */
+void mcasttable_destroy(mcasttable_t* mt);
+
+
+/**
+ * @brief   这个函数使本节点加入(join为1)或离开(join为0)组播组group.
+ *          成员关系改变了时返回1, 没有改变时返回0, 组号无效时返回-1.
+ *          成员关系改变后应发送组成员报告.
+ *
+ * @param mt
+ * @param group
+ * @param join
+ * @return int
+ */
+int mcasttable_join(mcasttable_t* mt, int group, int join);
+
+
+/**
+ * @brief   这个函数生成本节点的组成员报告, 序号加1, 返回本节点加入的组数.
+ *          报告的数据长度是GROUPREPORT_LEN(report->groupNum).
+ *
+ * @param mt
+ * @param report
+ * @return int
+ */
+int mcasttable_report(mcasttable_t* mt, pkt_groupreport_t* report);
+
+
+/**
+ * @brief   这个函数在now时刻(秒)把收到的数据长度为length的组成员报告加入成员表.
+ *          如果报告来自其他节点, 并且比之前收到的该节点的报告新, 就用它替换该节点的成员关系并返回1,
+ *          这样的报告应继续泛洪. 否则(重复的, 过时的或非法的报告, 或者是本节点自己的报告)返回0.
+ *
+ * @param mt
+ * @param report
+ * @param length
+ * @param now
+ * @return int
+ */
+int mcasttable_install(mcasttable_t* mt, pkt_groupreport_t* report, int length, long now);
+
+
+/**
+ * @brief   这个函数清除超过timeout秒没有收到组成员报告的节点的成员关系, 返回被清除的节点数.
+ *          节点离开重叠网络后不再发送报告, 它的成员关系最终被清除.
+ *
+ * @param mt
+ * @param now
+ * @param timeout
+ * @return int
+ */
+int mcasttable_expire(mcasttable_t* mt, long now, long timeout);
+
+
+/**
+ * @brief   这个函数把组播组group中除本节点外的成员位图复制到map, map至少应有mapLen字节.
+ *          返回成员数, 组号无效时返回-1.
+ *
+ * @param mt
+ * @param group
+ * @param map
+ * @return int
+ */
+int mcasttable_getmembers(mcasttable_t* mt, int group, unsigned char* map);
+
+
+/**
+ * @brief   这个函数把成员位图map中的成员按路由表rt中的下一跳分组, 每个下一跳是组播树的一个分支.
+ * @details 所有成员用同一个流哈希值hash查找下一跳, 这样同一个组播流的报文经过相同的树.
+ *          第b个分支的下一跳写入branch[b], 经过它的成员的位图写入branchMap + b * mapLen, 每个分支发送一个副本.
+ *          最多maxBranch个分支. 没有路由的成员不属于任何分支, 它们的数目写入*noroute. 返回分支数.
+ *
+ * @param mt
+ * @param map
+ * @param rt
+ * @param hash
+ * @param branch
+ * @param branchMap
+ * @param maxBranch
+ * @param noroute
+ * @return int
+ */
+int mcasttable_partition(mcasttable_t* mt, const unsigned char* map, routingtable_t* rt, unsigned int hash,
+    int* branch, unsigned char* branchMap, int maxBranch, int* noroute);
+
+
+/**
+ * @brief   这个函数打印所有有成员的组播组.
+ *
+ * @param mt
+ */
+void mcasttable_print(mcasttable_t* mt);
+
+#endif
@@ -51,6 +51,19 @@ unsigned int nbrcosttable_getcost(nbr_cost_entry_t* nct, int nodeID)
 }
 
 
+int nbrcosttable_setcost(nbr_cost_entry_t* nct, int nodeID, unsigned int cost)
+{
+    int nbrNum = topology_getNbrNum();
+    for (int i = 0; i < nbrNum; i++) {
+        if (nodeID == nct[i].nodeID) {
+            nct[i].cost = cost;
+            return 1;
+        }
+    }
+    return -1;
+}
+
+
 void nbrcosttable_print(nbr_cost_entry_t* nct)
 {
     int nbrNum = topology_getNbrNum();
@@ -45,6 +45,18 @@ void nbrcosttable_destroy(nbr_cost_entry_t* nct);
 unsigned int nbrcosttable_getcost(nbr_cost_entry_t* nct, int nodeID);
 
 
+/**
+ * @brief   这个函数把到邻居nodeID的直接链路代价设为cost, 链路断开时设为INFINITE_COST.
+ *          如果邻居节点在表中发现, 返回1, 否则返回-1.
+ * 
+ * @param nct 
+ * @param nodeID 
+ * @param cost 
+ * @return int 
+ */
+int nbrcosttable_setcost(nbr_cost_entry_t* nct, int nodeID, unsigned int cost);
+
+
 /**
  * @brief   这个函数打印邻居代价表的内容.
  * 
@@ -12,44 +12,79 @@
 #include "routingtable.h"
 
 
-int makehash(int node)
+int makehash(routingtable_t* routingtable, int node)
 {
-    return node % MAX_ROUTINGTABLE_SLOTS;
+    return node % routingtable->slotNum;
 }
 
 
-routingtable_t* routingtable_create()
+// 在路由表中查找目的节点的路由条目, 不存在时返回NULL
+static routingtable_entry_t* findentry(routingtable_t* routingtable, int destNodeID)
 {
-    routingtable_t* routingtable = (routingtable_t*)malloc(sizeof(routingtable_t));
-    for (int i = 0; i < MAX_ROUTINGTABLE_SLOTS; i++)
-        routingtable->hash[i] = NULL;
+    routingtable_entry_t* entry = routingtable->hash[makehash(routingtable, destNodeID)];
+    while (entry && entry->destNodeID != destNodeID)
+        entry = entry->next;
+    return entry;
+}
+
+
+// 查找目的节点的路由条目, 不存在时创建一个没有下一跳的条目并插入到槽的链表头
+static routingtable_entry_t* getentry(routingtable_t* routingtable, int destNodeID)
+{
+    routingtable_entry_t* entry = findentry(routingtable, destNodeID);
+    if (entry)
+        return entry;
+    int slotIdx = makehash(routingtable, destNodeID);
+    entry = (routingtable_entry_t*)malloc(sizeof(routingtable_entry_t));
+    entry->destNodeID = destNodeID;
+    entry->nextNodeID = -1;
+    entry->nextNum = 0;
+    entry->backupNodeID = -1;
+    entry->next = routingtable->hash[slotIdx];
+    routingtable->hash[slotIdx] = entry;
+    return entry;
+}
+
 
+routingtable_t* routingtable_create()
+{
     int nbrNum = topology_getNbrNum();
     int nodeNum = topology_getNodeNum();
+    routingtable_t* routingtable = (routingtable_t*)malloc(sizeof(routingtable_t));
+    routingtable->slotNum = nodeNum > MAX_ROUTINGTABLE_SLOTS ? nodeNum : MAX_ROUTINGTABLE_SLOTS;
+    routingtable->hash = (routingtable_entry_t**)calloc(routingtable->slotNum, sizeof(routingtable_entry_t*));
+
     printf("nbrNum: %d | nodeNum: %d\n", nbrNum, nodeNum);
     int* nbrArr = topology_getNbrArray();
-    for (int i = 0; i < topology_getNbrNum(); i++) {
-        int slotIdx = makehash(nbrArr[i]);
-        if (routingtable->hash[slotIdx] == NULL) {
-            routingtable->hash[slotIdx] = (routingtable_entry_t*)malloc(sizeof(routingtable_entry_t));
-            routingtable->hash[slotIdx]->destNodeID = nbrArr[i];
-            routingtable->hash[slotIdx]->nextNodeID = nbrArr[i];
-            routingtable->hash[slotIdx]->next = NULL;
-        } else {
-            routingtable_entry_t* entry = routingtable->hash[slotIdx];
-            routingtable->hash[slotIdx] = (routingtable_entry_t*)malloc(sizeof(routingtable_entry_t));
-            routingtable->hash[slotIdx]->destNodeID = nbrArr[i];
-            routingtable->hash[slotIdx]->nextNodeID = nbrArr[i];
-            routingtable->hash[slotIdx]->next = entry;
+    for (int i = 0; i < nbrNum; i++)
+        routingtable_setnextnode(routingtable, nbrArr[i], nbrArr[i]);
+    free(nbrArr);
+    return routingtable;
+}
+
+
+routingtable_t* routingtable_copy(routingtable_t* routingtable)
+{
+    routingtable_t* copy = (routingtable_t*)malloc(sizeof(routingtable_t));
+    copy->slotNum = routingtable->slotNum;
+    copy->hash = (routingtable_entry_t**)malloc(sizeof(routingtable_entry_t*) * copy->slotNum);
+    for (int i = 0; i < copy->slotNum; i++) {
+        // 保持槽中链表的顺序
+        routingtable_entry_t** tail = &copy->hash[i];
+        for (routingtable_entry_t* entry = routingtable->hash[i]; entry; entry = entry->next) {
+            *tail = (routingtable_entry_t*)malloc(sizeof(routingtable_entry_t));
+            memcpy(*tail, entry, sizeof(routingtable_entry_t));
+            tail = &(*tail)->next;
         }
+        *tail = NULL;
     }
-    return routingtable;
+    return copy;
 }
 
 
 void routingtable_destroy(routingtable_t* routingtable)
 {
-    for (int  i = 0; i < MAX_ROUTINGTABLE_SLOTS; i++) {
+    for (int  i = 0; i < routingtable->slotNum; i++) {
         if (routingtable->hash[i]) {
             routingtable_entry_t* entry = routingtable->hash[i];
             while (entry) {
@@ -59,63 +94,95 @@ void routingtable_destroy(routingtable_t* routingtable)
             }
         }
     }
+    free(routingtable->hash);
     free(routingtable);
 }
 
 
 void routingtable_setnextnode(routingtable_t* routingtable, int destNodeID, int nextNodeID)
 {
-    int slotIdx = makehash(destNodeID);
-    if (routingtable->hash[slotIdx] == NULL) {
-        routingtable->hash[slotIdx] = (routingtable_entry_t*)malloc(sizeof(routingtable_entry_t));
-        routingtable->hash[slotIdx]->destNodeID = destNodeID;
-        routingtable->hash[slotIdx]->nextNodeID = nextNodeID;
-        routingtable->hash[slotIdx]->next = NULL;
-    } else {
-        routingtable_entry_t* entry = routingtable->hash[slotIdx];
-        while (entry) {
-            if (entry->destNodeID == destNodeID) {
-                entry->nextNodeID = nextNodeID; 
-                return;
+    routingtable_setnextnodes(routingtable, destNodeID, &nextNodeID, nextNodeID == -1 ? 0 : 1);
+}
+
+
+void routingtable_setnextnodes(routingtable_t* routingtable, int destNodeID, int* nextNodeIDs, int nextNum)
+{
+    routingtable_entry_t* entry = getentry(routingtable, destNodeID);
+    entry->nextNum = nextNum < MAX_ECMP_PATHS ? nextNum : MAX_ECMP_PATHS;
+    for (int i = 0; i < entry->nextNum; i++)
+        entry->nextNodeIDs[i] = nextNodeIDs[i];
+    entry->nextNodeID = entry->nextNum > 0 ? entry->nextNodeIDs[0] : -1;
+}
+
+
+void routingtable_setbackup(routingtable_t* routingtable, int destNodeID, int backupNodeID)
+{
+    getentry(routingtable, destNodeID)->backupNodeID = backupNodeID;
+}
+
+
+int routingtable_failover(routingtable_t* routingtable, int nodeID)
+{
+    int n = 0;
+    for (int i = 0; i < routingtable->slotNum; i++) {
+        for (routingtable_entry_t* entry = routingtable->hash[i]; entry; entry = entry->next) {
+            int k = 0, changed = 0;
+            for (int m = 0; m < entry->nextNum; m++) {
+                if (entry->nextNodeIDs[m] == nodeID)
+                    changed = 1;
+                else
+                    entry->nextNodeIDs[k++] = entry->nextNodeIDs[m];
+            }
+            if (entry->backupNodeID == nodeID)
+                entry->backupNodeID = -1;
+            if (!changed)
+                continue;
+            // 所有等价的下一跳都断开了, 改用备份下一跳
+            if (k == 0 && entry->backupNodeID >= 0) {
+                entry->nextNodeIDs[k++] = entry->backupNodeID;
+                entry->backupNodeID = -1;
             }
-            entry = entry->next;
+            entry->nextNum = k;
+            entry->nextNodeID = k > 0 ? entry->nextNodeIDs[0] : -1;
+            n++;
         }
-        entry = routingtable->hash[slotIdx];
-        routingtable->hash[slotIdx] = (routingtable_entry_t*)malloc(sizeof(routingtable_entry_t));
-        routingtable->hash[slotIdx]->destNodeID = destNodeID;
-        routingtable->hash[slotIdx]->nextNodeID = nextNodeID;
-        routingtable->hash[slotIdx]->next = entry;
     }
+    return n;
 }
 
 
 int routingtable_getnextnode(routingtable_t* routingtable, int destNodeID)
 {
-    int slotIdx = makehash(destNodeID);
-    if (routingtable->hash[slotIdx]) {
-        routingtable_entry_t* entry = routingtable->hash[slotIdx];
-        while (entry) {
-            if (entry->destNodeID == destNodeID)
-                return entry->nextNodeID;
-            entry = entry->next;
-        }
-    }
-    return -1;
+    routingtable_entry_t* entry = findentry(routingtable, destNodeID);
+    return entry ? entry->nextNodeID : -1;
+}
+
+
+int routingtable_getflownextnode(routingtable_t* routingtable, int destNodeID, unsigned int flowHash)
+{
+    routingtable_entry_t* entry = findentry(routingtable, destNodeID);
+    if (entry == NULL || entry->nextNum == 0)
+        return -1;
+    return entry->nextNodeIDs[flowHash % entry->nextNum];
 }
 
 
 void routingtable_print(routingtable_t* routingtable)
 {
     printf("---------ROUTING TABLE PRINT---------\n");
-    for (int i = 0; i < MAX_ROUTINGTABLE_SLOTS; i++) {
+    for (int i = 0; i < routingtable->slotNum; i++) {
         printf("SRC[%d]: ", i + 1);
         if (routingtable->hash[i]) {
             routingtable_entry_t* entry = routingtable->hash[i];
-            while (entry->next) {
-                printf("[DEST: %d |NEXT: %d] -> ", entry->destNodeID, entry->nextNodeID);
+            while (entry) {
+                printf("[DEST: %d |NEXT: %d", entry->destNodeID, entry->nextNodeID);
+                for (int k = 1; k < entry->nextNum; k++)
+                    printf(",%d", entry->nextNodeIDs[k]);
+                if (entry->backupNodeID >= 0)
+                    printf(" |BACKUP: %d", entry->backupNodeID);
+                printf("]%s", entry->next ? " -> " : "\n");
                 entry = entry->next;
             }
-            printf("[DEST: %d |NEXT: %d]\n", entry->destNodeID, entry->nextNodeID);
         } else {
             printf("NULL\n");
         }
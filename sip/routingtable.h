@@ -12,15 +12,23 @@
 
 
 //routingtable_entry_t是包含在路由表中的路由条目.
+//到目的节点有多条代价相同的路径时, 条目包含所有这些路径的下一跳(等价多路径),
+//每个流按其哈希值固定使用其中一个下一跳, 这样同一个流的报文不会乱序.
+//条目还可以包含一个预先计算的无环备份下一跳, 下一跳的链路断开时立即改用它, 不必等待路由重新收敛.
 typedef struct routingtable_entry {
 	int destNodeID;		//目标节点ID
-	int nextNodeID;		//报文应该转发给的下一跳节点ID
+	int nextNodeID;		//报文应该转发给的下一跳节点ID, 有多个下一跳时是第一个, 没有路由时为-1
+	int nextNum;		//等价的下一跳数, 没有路由时为0
+	int nextNodeIDs[MAX_ECMP_PATHS];	//所有等价的下一跳节点ID
+	int backupNodeID;	//无环备份下一跳节点ID, 没有时为-1
 	struct routingtable_entry* next;	//指向在同一个路由表槽中的下一个routingtable_entry_t
 } routingtable_entry_t;
 
-//一个路由表是一个包含MAX_ROUTINGTABLE_SLOTS个槽的哈希表. 每个槽是一个路由条目的链表.
+//一个路由表是一个包含slotNum个槽的哈希表. 每个槽是一个路由条目的链表.
+//槽数至少为MAX_ROUTINGTABLE_SLOTS, 并随重叠网络的节点数增长, 使每个槽平均不超过一个条目.
 typedef struct routingtable {
-	routingtable_entry_t* hash[MAX_ROUTINGTABLE_SLOTS];
+	int slotNum;
+	routingtable_entry_t** hash;
 } routingtable_t;
 
 
@@ -28,10 +36,11 @@ typedef struct routingtable {
  * @brief   makehash()是由路由表使用的哈希函数.
  *          它将输入的目的节点ID作为哈希键,并返回针对这个目的节点ID的槽号作为哈希值.
  * 
+ * @param routingtable 
  * @param node 
  * @return int 
  */
-int makehash(int node); 
+int makehash(routingtable_t* routingtable, int node); 
 
 
 /**
@@ -44,6 +53,16 @@ int makehash(int node);
 routingtable_t* routingtable_create();
 
 
+/**
+ * @brief   这个函数复制路由表, 返回动态创建的副本.
+ *          SIP进程发布的路由表是只读的, 更新路由时先复制一份, 修改副本后再发布.
+ * 
+ * @param routingtable 
+ * @return routingtable_t* 
+ */
+routingtable_t* routingtable_copy(routingtable_t* routingtable);
+
+
 /**
  * @brief   这个函数删除路由表.
  *          所有为路由表动态分配的数据结构将被释放.
@@ -69,6 +88,43 @@ void routingtable_destroy(routingtable_t* routingtable);
 void routingtable_setnextnode(routingtable_t* routingtable, int destNodeID, int nextNodeID);
 
 
+/**
+ * @brief   这个函数把到目的节点的下一跳设置为nextNum个等价的下一跳nextNodeIDs.
+ *          nextNum为0表示没有到该目的节点的路由. 超过MAX_ECMP_PATHS个的下一跳被忽略.
+ *          其他行为与routingtable_setnextnode()相同.
+ * 
+ * @param routingtable 
+ * @param destNodeID 
+ * @param nextNodeIDs 
+ * @param nextNum 
+ */
+void routingtable_setnextnodes(routingtable_t* routingtable, int destNodeID, int* nextNodeIDs, int nextNum);
+
+
+/**
+ * @brief   这个函数设置到目的节点的无环备份下一跳, -1表示没有备份下一跳.
+ *          如果给定目的节点的路由条目不存在, 就添加一条没有下一跳的条目.
+ * 
+ * @param routingtable 
+ * @param destNodeID 
+ * @param backupNodeID 
+ */
+void routingtable_setbackup(routingtable_t* routingtable, int destNodeID, int backupNodeID);
+
+
+/**
+ * @brief   这个函数在到邻居nodeID的链路断开时调用, 从所有路由中去掉下一跳nodeID.
+ * @details 还有其他等价下一跳的路由继续使用它们, 只有这一个下一跳的路由改用备份下一跳,
+ *          没有备份下一跳时变为不可达. 只修改路由表, 不重新计算路由, 应在路由表的副本上调用.
+ *          返回被修改的路由数.
+ * 
+ * @param routingtable 
+ * @param nodeID 
+ * @return int 
+ */
+int routingtable_failover(routingtable_t* routingtable, int nodeID);
+
+
 /**
  * @brief   这个函数在路由表中查找指定的目标节点ID.
  *          为找到一个目的节点的路由条目, 你应该首先使用哈希函数makehash()获得槽号,
@@ -82,6 +138,18 @@ void routingtable_setnextnode(routingtable_t* routingtable, int destNodeID, int
 int routingtable_getnextnode(routingtable_t* routingtable, int destNodeID);
 
 
+/**
+ * @brief   这个函数在路由表中查找指定的目标节点ID, 并按流的哈希值flowHash在等价的下一跳中选择一个.
+ *          同一个流总是得到同一个下一跳. 如果没有到destNodeID的路由, 返回-1.
+ * 
+ * @param routingtable 
+ * @param destNodeID 
+ * @param flowHash 
+ * @return int 
+ */
+int routingtable_getflownextnode(routingtable_t* routingtable, int destNodeID, unsigned int flowHash);
+
+
 /**
  * @brief   这个函数打印路由表的内容
  * 
@@ -0,0 +1,159 @@
+/**
+ * @file    sip/rtreasm.c
+ * @brief   这个文件实现用于重组分片的路由更新报文的数据结构和函数.
+ * @date    2023-03-24
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "../common/constants.h"
+#include "../topology/topology.h"
+#include "rtreasm.h"
+
+
+
+rtreasm_t* rtreasm_create()
+{
+    int* nbrArr = topology_getNbrArray();
+    int* nodeArr = topology_getNodeArray();
+    rtreasm_t* rtreasm = (rtreasm_t*)malloc(sizeof(rtreasm_t));
+    assert(rtreasm != NULL);
+    rtreasm->nbrNum = topology_getNbrNum();
+    rtreasm->nodeNum = topology_getNodeNum();
+    // 分片数由发送方的节点数决定, 除了最后一个分片外每个分片至少包含perFrag个条目
+    int perFrag = ROUTEUPDATE_MAX_DATA / ROUTEUPDATE_MAX_ENTRY_LEN;
+    rtreasm->maxFrag = (rtreasm->nodeNum + perFrag - 1) / perFrag;
+    if (rtreasm->maxFrag < 1)
+        rtreasm->maxFrag = 1;
+
+    rtreasm->nbr = (rtreasm_entry_t*)malloc(sizeof(rtreasm_entry_t) * (rtreasm->nbrNum > 0 ? rtreasm->nbrNum : 1));
+    for (int i = 0; i < rtreasm->nbrNum; i++) {
+        rtreasm_entry_t* e = &rtreasm->nbr[i];
+        e->nodeID = nbrArr[i];
+        e->started = 0;
+        e->applied = 0;
+        e->appliedSeq = 0;
+        e->seq = 0;
+        e->fragNum = 0;
+        e->fragGot = 0;
+        e->got = (unsigned char*)calloc(rtreasm->maxFrag, 1);
+        e->entryNum = 0;
+        e->entry = (routeupdate_entry_t*)malloc(sizeof(routeupdate_entry_t) * (rtreasm->nodeNum > 0 ? rtreasm->nodeNum : 1));
+        e->slot = (int*)malloc(sizeof(int) * (rtreasm->nodeNum > 0 ? rtreasm->nodeNum : 1));
+        e->decoded = (routeupdate_entry_t*)malloc(sizeof(routeupdate_entry_t) * (ROUTEUPDATE_MAX_DATA / 2));
+        for (int k = 0; k < rtreasm->nodeNum; k++)
+            e->slot[k] = -1;
+    }
+    free(nbrArr);
+    free(nodeArr);
+    return rtreasm;
+}
+
+
+void rtreasm_destroy(rtreasm_t* rtreasm)
+{
+    for (int i = 0; i < rtreasm->nbrNum; i++) {
+        free(rtreasm->nbr[i].got);
+        free(rtreasm->nbr[i].entry);
+        free(rtreasm->nbr[i].slot);
+        free(rtreasm->nbr[i].decoded);
+    }
+    free(rtreasm->nbr);
+    free(rtreasm);
+}
+
+
+// 返回邻居nodeID的条目, 不是邻居时返回NULL
+static rtreasm_entry_t* findnbr(rtreasm_t* rtreasm, int nodeID)
+{
+    for (int i = 0; i < rtreasm->nbrNum; i++)
+        if (rtreasm->nbr[i].nodeID == nodeID)
+            return &rtreasm->nbr[i];
+    return NULL;
+}
+
+// 清空正在重组的条目
+static void clearentries(rtreasm_t* rtreasm, rtreasm_entry_t* e)
+{
+    for (int k = 0; k < e->entryNum; k++)
+        e->slot[topology_getNodeIndex(e->entry[k].nodeID)] = -1;
+    e->entryNum = 0;
+}
+
+
+int rtreasm_add(rtreasm_t* rtreasm, int fromNodeID, pkt_routeupdate_t* pkt_rp, int length, routeupdate_entry_t** entries)
+{
+    rtreasm_entry_t* e = findnbr(rtreasm, fromNodeID);
+    if (e == NULL)
+        return RTREASM_NOTNBR;
+    if (pkt_rp->fragNum == 0 || pkt_rp->fragNum > rtreasm->maxFrag || pkt_rp->fragIdx >= pkt_rp->fragNum)
+        return RTREASM_PENDING;
+    if (e->applied && pkt_rp->seq == e->appliedSeq)
+        return RTREASM_DUP;
+    // 一个分片最多包含ROUTEUPDATE_MAX_DATA/2个条目, 每个条目至少2字节
+    if (pkt_rp->entryNum > ROUTEUPDATE_MAX_DATA / 2)
+        return RTREASM_PENDING;
+    int n = pkt_rtdecode(pkt_rp, length, e->decoded);
+    if (n < 0)
+        return RTREASM_PENDING;
+
+    int full = (pkt_rp->flags & ROUTEUPDATE_FULL) != 0;
+    // 邻居重启后序号可能变小, 所以序号不同的完整距离矢量总是重新开始重组
+    if (!e->started || pkt_seqnewer(pkt_rp->seq, e->seq) || (full && pkt_rp->seq != e->seq)) {
+        // 开始重组新的路由更新, 丢弃上一次没有收齐的
+        clearentries(rtreasm, e);
+        e->started = 1;
+        e->seq = pkt_rp->seq;
+        e->fragNum = pkt_rp->fragNum;
+        e->fragGot = 0;
+        e->full = full;
+        e->base = pkt_rp->base;
+        memset(e->got, 0, rtreasm->maxFrag);
+    } else if (pkt_rp->seq != e->seq || e->fragNum == 0 || pkt_rp->fragNum != e->fragNum) {
+        // 过时的分片, 或者这次路由更新已经收齐了
+        return RTREASM_PENDING;
+    }
+    if (e->got[pkt_rp->fragIdx])
+        return RTREASM_PENDING;
+    e->got[pkt_rp->fragIdx] = 1;
+    e->fragGot++;
+
+    for (int k = 0; k < n; k++) {
+        int idx = topology_getNodeIndex(e->decoded[k].nodeID);
+        if (idx < 0)
+            continue;
+        if (e->slot[idx] < 0) {
+            e->slot[idx] = e->entryNum;
+            e->entry[e->entryNum++].nodeID = e->decoded[k].nodeID;
+        }
+        e->entry[e->slot[idx]].cost = e->decoded[k].cost;
+    }
+    if (e->fragGot < e->fragNum)
+        return RTREASM_PENDING;
+
+    // 收齐了. 增量只能用在它的基准版本或者更新的版本上: 发送方的增量包含了基准版本之后改变过的所有条目
+    e->fragNum = 0;
+    n = e->entryNum;
+    clearentries(rtreasm, e);
+    if (!e->full && (!e->applied || pkt_seqnewer(e->base, e->appliedSeq)))
+        return RTREASM_RESYNC;
+    e->applied = 1;
+    e->appliedSeq = e->seq;
+    *entries = e->entry;
+    return n;
+}
+
+
+void rtreasm_reset(rtreasm_t* rtreasm, int nbrNodeID)
+{
+    rtreasm_entry_t* e = findnbr(rtreasm, nbrNodeID);
+    if (e == NULL)
+        return;
+    clearentries(rtreasm, e);
+    e->started = 0;
+    e->fragNum = 0;
+    e->applied = 0;
+}
@@ -0,0 +1,93 @@
+/**
+ * @file    sip/rtreasm.h
+ * @brief   这个文件定义用于重组分片的路由更新报文的数据结构和函数.
+ * @date    2023-03-24
+ */
+
+
+#ifndef RTREASM_H
+#define RTREASM_H
+
+#include "../common/pkt.h"
+
+
+//rtreasm_add()的返回值
+#define RTREASM_NOTNBR -1       //发送方不是邻居
+#define RTREASM_PENDING -2      //路由更新还没有收齐, 或者分片是重复的, 过时的或非法的
+#define RTREASM_RESYNC -3       //收齐了一个增量, 但它的基准版本不是已经使用的版本, 应请求完整的距离矢量
+#define RTREASM_DUP -4          //收到了已经使用过的路由更新的分片(确认丢失了), 应再次确认
+
+//路由更新重组表条目, 每个邻居一个.
+//一个邻居的路由更新可能分成多个分片, 收齐同一个序号的所有分片后才作为一次更新交给距离矢量表.
+//更新的路由更新开始时, 上一次没有收齐的路由更新被丢弃: 它没有被确认, 发送方会把其中的条目放进之后的增量中.
+//每个目的节点最多保留一个条目, 占用的内存不超过节点数.
+typedef struct rtreasmentry {
+	int nodeID;                     //邻居的节点ID
+	int started;                    //是否收到过这个邻居的路由更新
+	unsigned int seq;               //正在重组的(或最近收齐的)路由更新的序号
+	int fragNum;                    //正在重组的路由更新的分片数, 没有正在重组的路由更新时为0
+	int fragGot;                    //已经收到的分片数
+	unsigned char* got;             //got[i]为1表示已经收到了第i个分片
+	int full;                       //正在重组的路由更新是否是完整的距离矢量
+	unsigned int base;              //正在重组的增量的基准版本
+	int applied;                    //是否已经使用了这个邻居的路由更新, 距离矢量表中它的行与版本appliedSeq一致
+	unsigned int appliedSeq;        //最近使用的路由更新的序号
+	int entryNum;                   //已经收到的条目数
+	routeupdate_entry_t* entry;     //已经收到的条目
+	int* slot;                      //slot[k]是第k个节点的条目在entry中的下标, 还没有收到时为-1
+	routeupdate_entry_t* decoded;   //rtreasm_add()使用: 解码的一个分片中的条目
+} rtreasm_entry_t;
+
+typedef struct rtreasm {
+	int nbrNum;                     //邻居数
+	int nodeNum;                    //重叠网络中总的节点数
+	int maxFrag;                    //一次路由更新最多的分片数
+	rtreasm_entry_t* nbr;           //每个邻居一个条目
+} rtreasm_t;
+
+
+/**
+ * @brief   这个函数动态创建路由更新重组表, 每个邻居一个条目.
+ *
+ * @return rtreasm_t*
+ */
+rtreasm_t* rtreasm_create();
+
+
+/**
+ * @brief   这个函数删除路由更新重组表.
+ *          它释放所有为路由更新重组表动态分配的内存.
+ *
+ * @param rtreasm
+ */
+void rtreasm_destroy(rtreasm_t* rtreasm);
+
+
+/**
+ * @brief   这个函数把邻居fromNodeID发来的一个数据长度为length的路由更新分片加入重组表.
+ * @details 如果这个分片使一次路由更新收齐了, 并且它是完整的距离矢量, 或者它的基准版本不比已经使用的版本新,
+ *          就把它记为已经使用, 通过entries返回这次路由更新的所有条目并返回条目数(可以为0),
+ *          entries在下一次对同一个邻居调用这个函数之前有效. 调用者应把条目写入距离矢量表并确认这个序号.
+ *          收齐的增量不能使用时返回RTREASM_RESYNC, 已经使用过的序号返回RTREASM_DUP,
+ *          还没有收齐或者分片被忽略时返回RTREASM_PENDING, fromNodeID不是邻居时返回RTREASM_NOTNBR.
+ *
+ * @param rtreasm
+ * @param fromNodeID
+ * @param pkt_rp
+ * @param length
+ * @param entries
+ * @return int
+ */
+int rtreasm_add(rtreasm_t* rtreasm, int fromNodeID, pkt_routeupdate_t* pkt_rp, int length, routeupdate_entry_t** entries);
+
+
+/**
+ * @brief   这个函数丢弃邻居nbrNodeID的重组状态和已经使用的版本, 在距离矢量表中它的行失效后调用.
+ *          之后这个邻居的增量不再被使用, 直到收到完整的距离矢量.
+ *
+ * @param rtreasm
+ * @param nbrNodeID
+ */
+void rtreasm_reset(rtreasm_t* rtreasm, int nbrNodeID);
+
+#endif
@@ -19,65 +19,933 @@
 #include <sys/utsname.h>
 #include <pthread.h>
 #include <unistd.h>
+#include <errno.h>
 #include "../common/constants.h"
 #include "../common/pkt.h"
 #include "../common/seg.h"
 #include "../common/tcp.h"
+#include "../common/uring.h"
+#include "../common/pktqueue.h"
+#include "../common/rcu.h"
 #include "../topology/topology.h"
 #include "sip.h"
 #include "nbrcosttable.h"
 #include "dvtable.h"
 #include "routingtable.h"
+#include "credittable.h"
+#include "lsdb.h"
+#include "rtreasm.h"
+#include "adverttable.h"
+#include "ctrlqueue.h"
+#include "fwdpool.h"
+#include "mcasttable.h"
+#include "snapshot.h"
+#include "apptable.h"
+#include "holdqueue.h"
 
 
-//SIP层等待这段时间让SIP路由协议建立路由路径. 
+//SIP层最多等待这段时间让SIP路由协议建立到所有节点的路由路径. 路由收敛后立即开始接受STCP进程的连接
 #define SIP_WAITTIME 60
 
 /* 声明全局变量 */
 int son_conn; 							//到重叠网络的连接
-int stcp_conn;							//到STCP的连接
+pktqueue_t* sonq;						//发往SON进程的报文帧队列, 它的写线程是唯一写son_conn的线程
+apptable_t* apps;						//连接到SIP进程的所有STCP进程和它们注册的端口, 由stcp_mutex保护
 nbr_cost_entry_t* nct;					//邻居代价表
 dv_t* dv;								//距离矢量表
-pthread_mutex_t* dv_mutex;				//距离矢量表互斥量
-routingtable_t* routingtable;			//路由表
-pthread_mutex_t* routingtable_mutex;	//路由表互斥量
+pthread_mutex_t* dv_mutex;				//距离矢量表和链路状态数据库互斥量
+pthread_cond_t* dv_cond;				//本节点的距离矢量变化或路由改变时通知路由更新线程和等待路由的线程
+int linkState;							//为1时使用链路状态路由, 否则使用距离矢量路由
+lsdb_t* lsdb;							//链路状态数据库, 只在使用链路状态路由时创建
+rtreasm_t* rtreasm;						//路由更新重组表, 由dv_mutex保护
+adverttable_t* adverts;					//路由通告表, 记录每个邻居确认的版本, 由dv_mutex保护
+ctrlqueue_t* ctrlq;						//接收线程交给控制线程的路由报文
+fwdpool_t* fwdpool;						//转发线程池, 数据报文按流分给转发线程
+unsigned int routeupdateSeq;			//本节点下一次路由更新的序号
+int dvChanged;							//本节点的距离矢量在上次路由更新后是否变化了, 由dv_mutex保护
+mcasttable_t* mcasts;					//组播组成员表, 成员关系由dv_mutex保护
+struct timespec routesChanged;			//最近一次路由改变的时刻(单调时钟), 由dv_mutex保护
+int snapshotDirty;						//路由在上次保存快照后改变了, 由dv_mutex保护
+int snapshotRestored;					//链路状态路由还没有在恢复快照后计算过最短路径, 由dv_mutex保护
+int mcastChanged;						//本节点加入或离开了组播组, 还没有发送组成员报告, 由dv_mutex保护
+routingtable_t* _Atomic routingtable;	//路由表的当前版本. 发布后只读, 更新路由时发布新版本, 写者持有dv_mutex
+rcu_t* routingtable_rcu;				//转发线程无锁读取路由表, 旧版本在没有读者后回收
+credit_entry_t* ct;						//下一跳信用表
+pthread_mutex_t* credittable_mutex;		//下一跳信用表互斥量
+holdqueue_t* hq;						//暂存路由收敛期间还没有路由的数据报文
+pthread_mutex_t* stcp_mutex;			//本地STCP进程表互斥量, 向一个STCP进程转交段时使用它的sendMutex
+uring_t* ring;							//接收来自SON进程的报文的io_uring, 为NULL时使用阻塞接收
+uring_t* appRing;						//接收来自STCP进程的段的io_uring, 为NULL时用select()和阻塞接收
+int appUring;							//为1时新连接的STCP进程的段由io_uring接收
+int appArmed[SIP_MAX_APPS];				//为1时这个STCP进程的段由io_uring接收, waitSTCP()不再读它的连接
+segstream_t appStreams[SIP_MAX_APPS];	//每个STCP进程的段帧流, 只在stcphandler线程中使用
+
+//控制线程处理一个路由报文后的动作
+#define CTRL_ACK 1						//确认路由更新
+#define CTRL_RESYNC 2					//请求完整的距离矢量
+#define CTRL_FLOOD 3					//继续泛洪更新的LSA
 
 /* 实现SIP的函数 */
 
 int connectToSON() 
 {
-	return tcp_client_conn_a("127.0.0.1", SON_PORT);
+	// SON进程会给新连接的SIP进程初始信用, 在此之前不能发送报文
+	pthread_mutex_lock(credittable_mutex);
+	credittable_reset(ct);
+	pthread_mutex_unlock(credittable_mutex);
+	int conn = tcp_client_conn_a("127.0.0.1", SON_PORT);
+	if (conn > 0)
+		pktqueue_setconn(sonq, conn);
+	return conn;
+}
+
+
+// 消耗下一跳nextNodeID的一个信用, 没有信用时返回-1
+static int takecredit(int nextNodeID)
+{
+	pthread_mutex_lock(credittable_mutex);
+	int n = credittable_take(ct, nextNodeID);
+	pthread_mutex_unlock(credittable_mutex);
+	return n;
+}
+
+
+// 把消耗了一个信用的数据报文交给SON进程发往下一跳nextNodeID.
+// 到SON进程的队列已满而丢弃报文时交还信用并返回0, 连接断开时返回-1
+static int sendtonext(int nextNodeID, sip_pkt_t* pkt)
+{
+	int n = pktqueue_sendnext(sonq, nextNodeID, pkt);
+	if (n < 0) {
+		son_conn = -1;
+	} else if (n == 0) {
+		pthread_mutex_lock(credittable_mutex);
+		credittable_grant(ct, nextNodeID, 1);
+		pthread_mutex_unlock(credittable_mutex);
+	}
+	return n;
+}
+
+
+// 把来自节点nodeID的段交给注册了它的目的端口的STCP进程. 返回1, 这个STCP进程的发送缓存已满而丢弃段时返回0,
+// 目的端口没有注册时返回-1
+static int sendtoapp(int nodeID, seg_t* seg)
+{
+	pthread_mutex_lock(stcp_mutex);
+	int i = apptable_lookup(apps, seg->header.dest_port);
+	if (i < 0) {
+		apps->unbound++;
+		pthread_mutex_unlock(stcp_mutex);
+		return -1;
+	}
+	// 只在转交期间持有这个STCP进程的锁, 转交只是放入它的发送缓存并用非阻塞写写出,
+	// 读得慢的STCP进程既不会阻塞转发线程, 也不会阻塞发往其他STCP进程的段
+	stcp_app_t* app = &apps->app[i];
+	pthread_mutex_lock(&app->sendMutex);
+	pthread_mutex_unlock(stcp_mutex);
+	// 连接断开由waitSTCP()发现并删除这个STCP进程, 缓存中剩余的段由waitSTCP()在连接可写时写出
+	int queued = apptable_send(apps, i, nodeID, seg);
+	pthread_mutex_unlock(&app->sendMutex);
+	if (!queued) {
+		printf("SIP: STCP PROCESS[%d] IS TOO SLOW, DROP A SEGMENT FROM NODE %d\n", i, nodeID);
+		return 0;
+	}
+	return 1;
+}
+
+
+void stcp_sendbusy(int dest_nodeID, seg_t* seg)
+{
+	// BUSY段看起来像是来自目的端点, 这样STCP进程可以找到发送该段的连接
+	seg_t busy;
+	memset(&busy, 0, sizeof(busy));
+	busy.header.type = BUSY;
+	busy.header.src_port = seg->header.dest_port;
+	busy.header.dest_port = seg->header.src_port;
+	busy.header.ack_num = seg->header.seq_num;
+	busy.header.length = 0;
+	busy.header.checksum = checksum(&busy);
+	sendtoapp(dest_nodeID, &busy);
+}
+
+
+// 计算from之后ms毫秒的时刻
+static void timeafter(struct timespec* ts, const struct timespec* from, long ms)
+{
+	ts->tv_sec = from->tv_sec + ms / 1000;
+	ts->tv_nsec = from->tv_nsec + (ms % 1000) * 1000000L;
+	ts->tv_sec += ts->tv_nsec / 1000000000L;
+	ts->tv_nsec %= 1000000000L;
+}
+
+
+// 单调时钟的当前时刻, 以毫秒为单位
+static long monotonicms()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000L + now.tv_nsec / 1000000L;
+}
+
+
+// 本节点的距离矢量改变了, 通知路由更新线程. 调用者应持有dv_mutex.
+static void dvchanged()
+{
+	dvChanged = 1;
+	pthread_cond_broadcast(dv_cond);
+}
+
+
+// 把报文广播给所有邻居, 成功时返回1, 否则返回-1
+static int sendbroadcast(sip_pkt_t* pkt)
+{
+	if (son_conn <= 0 && (son_conn = connectToSON()) <= 0)
+		return -1;
+	// 路由报文总是发送, 即使这会使某些邻居的信用小于0
+	pthread_mutex_lock(credittable_mutex);
+	credittable_takeall(ct);
+	pthread_mutex_unlock(credittable_mutex);
+	if (pktqueue_sendnext(sonq, BROADCAST_NODEID, pkt) < 0) {
+		son_conn = -1;
+		return -1;
+	}
+	return 1;
+}
+
+
+// 把报文发给邻居nbrNodeID, 成功时返回1, 否则返回-1
+static int sendtonbr(int nbrNodeID, sip_pkt_t* pkt)
+{
+	if (son_conn <= 0 && (son_conn = connectToSON()) <= 0)
+		return -1;
+	// 与广播一样, 路由报文总是发送, 即使这会使这个邻居的信用小于0
+	pthread_mutex_lock(credittable_mutex);
+	credittable_grant(ct, nbrNodeID, -1);
+	pthread_mutex_unlock(credittable_mutex);
+	if (pktqueue_sendnext(sonq, nbrNodeID, pkt) < 0) {
+		son_conn = -1;
+		return -1;
+	}
+	return 1;
+}
+
+
+// 把entryNum个条目作为序号为seq, 基准版本为base的路由更新发给邻居nbrNodeID, full为1时是完整的距离矢量.
+// 条目多时分成多个分片. 所有分片都发送了返回1, 否则返回-1
+static int sendrouteupdate(int nbrNodeID, unsigned int seq, unsigned int base, int full, routeupdate_entry_t* entries, int entryNum)
+{
+	pkt_routeupdate_t pkt_rp;
+	sip_pkt_t pkt;
+	// 变长编码的条目长度不同, 先计算分片数
+	int fragNum = 0, first = 0;
+	do {
+		pkt_rtencode(&pkt_rp, entries + first, entryNum - first);
+		first += pkt_rp.entryNum;
+		fragNum++;
+	} while (first < entryNum);
+	pkt_rp.seq = seq;
+	pkt_rp.base = base;
+	pkt_rp.fragNum = fragNum;
+	pkt_rp.flags = full ? ROUTEUPDATE_FULL : 0;
+	pkt.header.src_nodeID = topology_getMyNodeID();
+	pkt.header.dest_nodeID = nbrNodeID;
+	pkt.header.type = ROUTE_UPDATE;
+	pkt.header.ttl = 1;
+	first = 0;
+	for (int f = 0; f < fragNum; f++) {
+		pkt_rp.fragIdx = f;
+		int len = pkt_rtencode(&pkt_rp, entries + first, entryNum - first);
+		first += pkt_rp.entryNum;
+		pkt.header.length = ROUTEUPDATE_LEN(len);
+		memcpy(pkt.data, &pkt_rp, pkt.header.length);
+		if (sendtonbr(nbrNodeID, &pkt) < 0)
+			return -1;
+	}
+	return 1;
+}
+
+
+// 确认邻居nbrNodeID序号为seq的路由更新, resync为1时请求完整的距离矢量
+static void sendrouteack(int nbrNodeID, unsigned int seq, int resync)
+{
+	sip_pkt_t pkt;
+	pkt_routeack_t ack;
+	ack.seq = seq;
+	ack.resync = resync;
+	pkt.header.src_nodeID = topology_getMyNodeID();
+	pkt.header.dest_nodeID = nbrNodeID;
+	pkt.header.type = ROUTE_ACK;
+	pkt.header.ttl = 1;
+	pkt.header.length = sizeof(ack);
+	memcpy(pkt.data, &ack, sizeof(ack));
+	sendtonbr(nbrNodeID, &pkt);
+}
+
+
+static void setroutes(int* dests, int n);
+static int hasroute(int nodeID);
+static void releasepkt(fwd_item_t* item);
+
+
+// 使长时间没有发来路由更新的邻居的路由失效. 调用者应持有dv_mutex.
+static void expireroutes(long now)
+{
+	int dests[dv->nodeNum], nextNodes[dv->nodeNum];
+	// 失效的邻居的行不再与它的任何版本一致, 双方都从完整的距离矢量重新开始
+	for (int i = 0; i < dv->rowNum - 1; i++) {
+		if (dv->heard[i] != 0 && now - dv->heard[i] >= ROUTE_TIMEOUT) {
+			rtreasm_reset(rtreasm, dv->rowID[i]);
+			adverttable_reset(adverts, dv->rowID[i]);
+		}
+	}
+	int n = dvtable_expire(dv, now, ROUTE_TIMEOUT, dests, nextNodes);
+	if (n > 0) {
+		setroutes(dests, n);
+		dvchanged();
+	}
+}
+
+
+// 重新生成本节点的LSA并放入报文. 调用者应持有dv_mutex.
+static void makelsa(sip_pkt_t* pkt)
+{
+	pkt_lsa_t lsa;
+	lsdb_originate(lsdb, nct, &lsa);
+	pkt->header.type = LSA;
+	pkt->header.ttl = 1;
+	pkt->header.length = LSA_LEN(lsa.linkNum);
+	memcpy(pkt->data, &lsa, pkt->header.length);
+}
+
+
+// 保存路由快照. 调用者应持有dv_mutex, 路由表只在dv_mutex内发布, 所以生成快照期间不会被替换.
+// 在锁外写入文件, 返回时仍持有dv_mutex
+static void savesnapshot()
+{
+	size_t size;
+	void* snapshot = snapshot_build(dv, nct, atomic_load(&routingtable), &size);
+	snapshotDirty = 0;
+	pthread_mutex_unlock(dv_mutex);
+	if (snapshot == NULL || snapshot_write(SIP_SNAPSHOT_FILE, snapshot, size) < 0)
+		printf("SIP: CAN'T SAVE ROUTE SNAPSHOT TO %s\n", SIP_SNAPSHOT_FILE);
+	free(snapshot);
+	pthread_mutex_lock(dv_mutex);
+}
+
+
+// 生成本节点的组成员报告并放入报文, 返回本节点加入的组数. 调用者应持有dv_mutex.
+static int makereport(sip_pkt_t* pkt)
+{
+	pkt_groupreport_t report;
+	int n = mcasttable_report(mcasts, &report);
+	pkt->header.src_nodeID = topology_getMyNodeID();
+	pkt->header.dest_nodeID = BROADCAST_NODEID;
+	pkt->header.type = GROUP_REPORT;
+	pkt->header.ttl = 1;
+	pkt->header.length = GROUPREPORT_LEN(n);
+	memcpy(pkt->data, &report, pkt->header.length);
+	return n;
 }
 
 
 void* routeupdate_daemon(void* arg) 
 {
+	struct timespec lastSent = {0, 0}, lastRefresh = {0, 0}, now, until, tick;
+	long lastReport = 0, lastSnapshot = 0;
+	int nbrNum = dv->rowNum - 1;
+	// 每个邻居的路由更新不同, 在锁内生成全部增量, 在锁外发送
+	routeupdate_entry_t* advert = (routeupdate_entry_t*)malloc(sizeof(routeupdate_entry_t) * dv->nodeNum);
+	routeupdate_entry_t* entries = (routeupdate_entry_t*)malloc(sizeof(routeupdate_entry_t) * dv->nodeNum * (nbrNum > 0 ? nbrNum : 1));
+	int entryNum[nbrNum > 0 ? nbrNum : 1], full[nbrNum > 0 ? nbrNum : 1];
+	unsigned int base[nbrNum > 0 ? nbrNum : 1];
+	pthread_mutex_lock(dv_mutex);
 	while (1) {
-		select(0, 0, 0, 0, &(struct timeval){.tv_sec = ROUTEUPDATE_INTERVAL});
-		
-		if (son_conn < 0 && (son_conn = connectToSON()) < 0)
-			continue;
+		// 等待距离矢量变化, 最多等待ROUTEUPDATE_INTERVAL秒后周期性刷新. 触发更新和重传只发给部分邻居, 不推迟刷新
+		timeafter(&until, &lastRefresh, ROUTEUPDATE_INTERVAL * 1000L);
+		int refresh = 0, retransmit = 0;
+		while (!dvChanged && !mcastChanged) {
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			mcasttable_expire(mcasts, now.tv_sec, ROUTE_TIMEOUT);
+			// 路由不只在控制线程中改变, 每秒也交回一次已经有路由的暂存报文
+			holdqueue_release(hq, monotonicms(), hasroute, releasepkt);
+			holdqueue_expire(hq, monotonicms());
+			// 路由稳定下来后保存快照, 两次保存至少间隔SIP_SNAPSHOT_INTERVAL秒
+			if (snapshotDirty && now.tv_sec - lastSnapshot >= SIP_SNAPSHOT_INTERVAL) {
+				lastSnapshot = now.tv_sec;
+				savesnapshot();
+				continue;
+			}
+			// 距离矢量路由每秒检查一次邻居是否超时
+			if (!linkState)
+				expireroutes(now.tv_sec);
+			if (dvChanged)
+				break;
+			if (now.tv_sec > until.tv_sec || (now.tv_sec == until.tv_sec && now.tv_nsec >= until.tv_nsec)) {
+				refresh = 1;
+				break;
+			}
+			// 以及是否有邻居的重传计时器到期. 不确认的邻居按自己的计时器退避, 不影响其他邻居
+			if (!linkState && adverttable_due(adverts, monotonicms()) > 0) {
+				retransmit = 1;
+				break;
+			}
+			timeafter(&tick, &now, 1000);
+			pthread_cond_timedwait(dv_cond, dv_mutex, tick.tv_sec < until.tv_sec ? &tick : &until);
+		}
+		// 抑制计时器: 两次路由更新至少间隔ROUTEUPDATE_HOLDDOWN毫秒, 期间的变化合并到一个报文中
+		timeafter(&until, &lastSent, ROUTEUPDATE_HOLDDOWN);
+		while (pthread_cond_timedwait(dv_cond, dv_mutex, &until) != ETIMEDOUT)
+			;
+		int sent = 1, changed = dvChanged, routes = dvChanged || refresh || retransmit;
+		dvChanged = 0;
+		clock_gettime(CLOCK_MONOTONIC, &lastSent);
+		if (refresh)
+			lastRefresh = lastSent;
+
+		// 组成员关系改变时, 以及本节点在某个组中时每ROUTEUPDATE_INTERVAL秒, 泛洪组成员报告
+		sip_pkt_t report;
+		int reportNum = -1;
+		if (mcastChanged || lastSent.tv_sec - lastReport >= ROUTEUPDATE_INTERVAL) {
+			reportNum = makereport(&report);
+			if (reportNum == 0 && !mcastChanged)
+				reportNum = -1;
+			else
+				lastReport = lastSent.tv_sec;
+			mcastChanged = 0;
+		}
+
+		if (!routes) {
+			pthread_mutex_unlock(dv_mutex);
+		} else if (linkState) {
+			sip_pkt_t pkt;
+			makelsa(&pkt);
+			pthread_mutex_unlock(dv_mutex);
+			pkt.header.src_nodeID = topology_getMyNodeID();
+			pkt.header.dest_nodeID = BROADCAST_NODEID;
+			sent = sendbroadcast(&pkt) > 0;
+		} else {
+			// 每个邻居收到过滤后的距离矢量与它确认的版本之间的增量, 同一轮路由更新使用同一个序号.
+			// 没有变化的邻居只在周期性刷新时收到空的增量, 让它知道这个节点还活着. 只是重传时只发给计时器到期的邻居
+			unsigned int seq = routeupdateSeq++;
+			long sentAt = monotonicms();
+			for (int i = 0; i < nbrNum; i++) {
+				// 链路已经断开的邻居不再发送
+				if (dv->link[i] >= INFINITE_COST) {
+					entryNum[i] = -1;
+					continue;
+				}
+				dvtable_getadvert(dv, dv->rowID[i], SIP_POISON_REVERSE, advert);
+				entryNum[i] = adverttable_delta(adverts, dv->rowID[i], advert, entries + (size_t)i * dv->nodeNum, &base[i], &full[i]);
+				if ((entryNum[i] == 0 && !refresh) || (!changed && !refresh && !adverttable_isdue(adverts, dv->rowID[i], sentAt)))
+					entryNum[i] = -1;
+				else
+					adverttable_sent(adverts, dv->rowID[i], advert, seq, sentAt);
+			}
+			// 在锁外发送, 发送期间不阻塞处理进入的路由更新
+			pthread_mutex_unlock(dv_mutex);
+			for (int i = 0; i < nbrNum; i++)
+				if (entryNum[i] >= 0 && sendrouteupdate(dv->rowID[i], seq, base[i], full[i], entries + (size_t)i * dv->nodeNum, entryNum[i]) < 0)
+					sent = 0;
+		}
+
+		int reported = reportNum < 0 || sendbroadcast(&report) > 0;
 
 		pthread_mutex_lock(dv_mutex);
-		int myNodeID = topology_getMyNodeID();
-		int* nodeArr = topology_getNodeArray();
+		// 没有发送出去, 抑制计时器到期后重试
+		if (!sent)
+			dvChanged = 1;
+		if (!reported)
+			mcastChanged = 1;
+	}
+}
+
+
+// 把除本节点外的所有目的节点写入dests, 返回目的节点数. 用于按路由协议的状态重新发布整个路由表
+static int alldests(int* dests)
+{
+	int n = 0, myNodeID = topology_getMyNodeID();
+	int nodeNum = linkState ? lsdb->nodeNum : dv->nodeNum;
+	for (int i = 0; i < nodeNum; i++) {
+		int nodeID = linkState ? lsdb->nodeID[i] : dv->colID[i];
+		if (nodeID != myNodeID)
+			dests[n++] = nodeID;
+	}
+	return n;
+}
+
+
+// 路由表中是否有到nodeID的路由
+static int hasroute(int nodeID)
+{
+	rcu_read_lock(routingtable_rcu);
+	int next = routingtable_getnextnode(atomic_load(&routingtable), nodeID);
+	rcu_read_unlock(routingtable_rcu);
+	return next != -1;
+}
+
+
+// 时刻a是否不早于b
+static int timenotbefore(const struct timespec* a, const struct timespec* b)
+{
+	return a->tv_sec > b->tv_sec || (a->tv_sec == b->tv_sec && a->tv_nsec >= b->tv_nsec);
+}
+
+
+// 等待路由收敛: 到所有节点都有路由, 并且最近SIP_STABLE_WINDOW毫秒内路由没有改变. 最多等待timeout秒, 收敛时返回1
+static int waitconverged(int timeout)
+{
+	struct timespec now, until, stable;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	timeafter(&until, &now, timeout * 1000L);
+	int myNodeID = topology_getMyNodeID();
+	pthread_mutex_lock(dv_mutex);
+	while (1) {
+		// 两种路由协议都把路由写入路由表, 所以检查路由表
+		int reachable = 1;
+		for (int i = 0; i < dv->nodeNum && reachable; i++)
+			if (dv->colID[i] != myNodeID && !hasroute(dv->colID[i]))
+				reachable = 0;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		timeafter(&stable, &routesChanged, SIP_STABLE_WINDOW);
+		if (reachable && timenotbefore(&now, &stable))
+			break;
+		if (timenotbefore(&now, &until)) {
+			pthread_mutex_unlock(dv_mutex);
+			return 0;
+		}
+		// 路由都建立了只需要等到稳定窗口结束, 否则等待路由改变
+		pthread_cond_timedwait(dv_cond, dv_mutex, reachable && !timenotbefore(&stable, &until) ? &stable : &until);
+	}
+	pthread_mutex_unlock(dv_mutex);
+	return 1;
+}
+
+
+// 释放旧版本的路由表
+static void freeroutingtable(void* rt)
+{
+	routingtable_destroy((routingtable_t*)rt);
+}
+
+
+// 用所有等价的下一跳更新路由表中到dests的路由, 不可达的目的节点没有下一跳. 调用者应持有dv_mutex.
+// 一批更新在路由表的副本上完成后一次发布, 转发线程不会看到更新了一半的路由表.
+static void setroutes(int* dests, int n)
+{
+	int hops[MAX_ECMP_PATHS];
+	routingtable_t* old = atomic_load(&routingtable);
+	routingtable_t* rt = routingtable_copy(old);
+	for (int i = 0; i < n; i++) {
+		int hopNum = linkState ? lsdb_getnexthops(lsdb, dests[i], hops) : dvtable_getnexthops(dv, dests[i], hops);
+		routingtable_setnextnodes(rt, dests[i], hops, hopNum);
+		routingtable_setbackup(rt, dests[i], linkState ? -1 : dvtable_getbackup(dv, dests[i]));
+	}
+	snapshotDirty = 1;
+	clock_gettime(CLOCK_MONOTONIC, &routesChanged);
+	atomic_store(&routingtable, rt);
+	rcu_retire(routingtable_rcu, old, freeroutingtable);
+}
+
+
+// 到邻居nodeID的链路断开了, 立即发布去掉这个下一跳的路由表, 只有这一个下一跳的路由改用备份下一跳.
+// 在接收线程中执行, 只修改路由表, 不等待控制线程重新计算路由
+static void failover(int nodeID)
+{
+	pthread_mutex_lock(dv_mutex);
+	routingtable_t* old = atomic_load(&routingtable);
+	routingtable_t* rt = routingtable_copy(old);
+	int n = routingtable_failover(rt, nodeID);
+	snapshotDirty = 1;
+	clock_gettime(CLOCK_MONOTONIC, &routesChanged);
+	atomic_store(&routingtable, rt);
+	rcu_retire(routingtable_rcu, old, freeroutingtable);
+	pthread_mutex_unlock(dv_mutex);
+	printf("SIP: LINK TO NEIGHBOR[%d] IS DOWN, %d ROUTES FAILED OVER\n", nodeID, n);
+}
+
+
+// 计算STCP流(源节点, 目的节点, 源端口, 目的端口)的哈希值, 用于在等价的下一跳中选择一个.
+// 同一个流的段总是经过同一条路径, 不会乱序.
+static unsigned int flowhash(int src_nodeID, int dest_nodeID, seg_t* seg)
+{
+	unsigned int key[4] = {src_nodeID, dest_nodeID, seg->header.src_port, seg->header.dest_port};
+	unsigned int h = 2166136261u;
+	for (int i = 0; i < 4; i++) {
+		h ^= key[i];
+		h *= 16777619u;
+	}
+	return h ^ (h >> 16);
+}
+
+
+// 按流的哈希值查找下一跳
+static int flownextnode(int src_nodeID, int dest_nodeID, seg_t* seg)
+{
+	// 不加锁, 不会被路由更新阻塞
+	rcu_read_lock(routingtable_rcu);
+	int next = routingtable_getflownextnode(atomic_load(&routingtable), dest_nodeID, flowhash(src_nodeID, dest_nodeID, seg));
+	rcu_read_unlock(routingtable_rcu);
+	return next;
+}
+
+
+// 把收到的段按目的端口交给本节点的STCP进程
+static void delivertoSTCP(fwd_worker_t* w, int src_nodeID, void* data, int length)
+{
+	seg_t seg;
+	memcpy(&seg, data, length);
+	if (sendtoapp(src_nodeID, &seg) > 0)
+		w->delivered++;
+}
+
+
+// 跳数限制: 转发前减1, 减到0的报文在环路中转了太多次, 丢弃. 返回报文是否可以继续转发
+static int hoplimit(fwd_worker_t* w, sip_pkt_t* pkt)
+{
+	if (pkt->header.src_nodeID == topology_getMyNodeID())
+		w->looped++;
+	if (pkt->header.ttl <= 1) {
+		w->expired++;
+		printf("SIP: TTL EXPIRED, DROP PKT FROM NODE[%d] TO NODE[%d]\n", pkt->header.src_nodeID, pkt->header.dest_nodeID);
+		return 0;
+	}
+	pkt->header.ttl--;
+	return 1;
+}
+
+
+// 转发线程处理一个组播报文: 本节点是成员时交给STCP进程,
+// 其余成员按单播路由的下一跳分组, 每个下一跳发送一个只包含经过它的成员的副本.
+// 与单播报文一样, 到达本节点的报文即使跳数已经用完也交付, 跳数限制只作用于转发的副本
+static void forwardmcast(fwd_worker_t* w, fwd_item_t* item)
+{
+	sip_pkt_t* pkt = &item->pkt;
+	pkt_mcast_t* mc = (pkt_mcast_t*)pkt->data;
+	int mapLen = mcasts->mapLen;
+	int segLen = pkt->header.length - (int)MCAST_LEN(mapLen, 0);
+	if (mc->mapLen != mapLen || segLen < (int)sizeof(stcp_hdr_t) || segLen > (int)sizeof(seg_t))
+		return;
+	unsigned char* map = mc->data;
+	unsigned char* segData = mc->data + mapLen;
+	int self = mcasts->self;
+	if (self >= 0 && (map[self / 8] & (1 << (self % 8)))) {
+		if (!item->local)
+			delivertoSTCP(w, pkt->header.src_nodeID, segData, segLen);
+		map[self / 8] &= ~(1 << (self % 8));
+	}
+	// 没有其他成员时不需要转发, 也不算作跳数用完
+	int others = 0;
+	for (int k = 0; k < mapLen && !others; k++)
+		others = map[k] != 0;
+	if (!others || (!item->local && !hoplimit(w, pkt)))
+		return;
+
+	// 组播报文的所有副本使用同一个流哈希值, 同一个组播流的报文经过相同的树
+	stcp_hdr_t hdr;
+	memcpy(&hdr, segData, sizeof(hdr));
+	unsigned int hash = flowhash(pkt->header.src_nodeID, pkt->header.dest_nodeID, &(seg_t){.header = hdr});
+	int nbrNum = topology_getNbrNum(), noroute;
+	int branch[nbrNum > 0 ? nbrNum : 1];
+	unsigned char branchMap[nbrNum > 0 ? nbrNum : 1][mapLen];
+	rcu_read_lock(routingtable_rcu);
+	int branchNum = mcasttable_partition(mcasts, map, atomic_load(&routingtable), hash, branch, &branchMap[0][0], nbrNum, &noroute);
+	rcu_read_unlock(routingtable_rcu);
+	w->noroute += noroute;
+
+	for (int b = 0; b < branchNum; b++) {
+		if (takecredit(branch[b]) < 0) {
+			w->busy++;
+			printf("SIP: NEXT NODE[%d] IS BUSY, DROP MCAST PKT FROM NODE[%d] TO GROUP[%d]\n", branch[b], pkt->header.src_nodeID, mc->group);
+			continue;
+		}
+		memcpy(map, branchMap[b], mapLen);
+		if (sendtonext(branch[b], pkt) == 0)
+			w->busy++;
+		else
+			w->forwarded++;
+	}
+}
+
+
+// 暂存没有路由的报文, 成功时返回1
+static int holdpkt(fwd_item_t* item)
+{
+	// 交回后报文会再次经过跳数限制, 在这里恢复这一跳减去的跳数
+	if (!item->local)
+		item->pkt.header.ttl++;
+	return holdqueue_put(hq, item, monotonicms()) > 0;
+}
+
+
+// 把路由出现后的暂存报文交回转发线程, 同一个流的报文仍然由同一个转发线程按顺序处理
+static void releasepkt(fwd_item_t* item)
+{
+	sip_pkt_t* pkt = &item->pkt;
+	if (fwdpool_put(fwdpool, flowhash(pkt->header.src_nodeID, pkt->header.dest_nodeID, (seg_t*)pkt->data), pkt, item->local) < 0)
+		printf("SIP: FORWARDING WORKER IS BUSY, DROP HELD PKT TO NODE[%d]\n", pkt->header.dest_nodeID);
+}
+
+
+// 转发线程处理一个数据报文: 交给本节点的STCP进程, 或者按流查找下一跳转发
+static void forwardpkt(fwd_worker_t* w, fwd_item_t* item)
+{
+	sip_pkt_t* pkt = &item->pkt;
+	seg_t seg;
+
+	if (pkt->header.type == MCAST) {
+		forwardmcast(w, item);
+		return;
+	}
+	// 发往本节点的段, 包括本节点的STCP进程之间的段
+	if (pkt->header.dest_nodeID == topology_getMyNodeID()) {
+		delivertoSTCP(w, pkt->header.src_nodeID, pkt->data, pkt->header.length);
+		return;
+	}
+	if (!item->local && !hoplimit(w, pkt))
+		return;
+	// 到目的节点已经有暂存的报文时也暂存, 保持原来的顺序
+	int next_NodeID = holdqueue_held(hq, pkt->header.dest_nodeID) > 0 ? -1 : flownextnode(pkt->header.src_nodeID, pkt->header.dest_nodeID, (seg_t*)pkt->data);
+	if (next_NodeID == -1) {
+		if (!holdpkt(item))
+			w->noroute++;
+		// 控制线程可能在查找路由之后, 暂存之前发布了路由并交回了暂存报文, 这时由转发线程自己交回
+		else if (hasroute(pkt->header.dest_nodeID))
+			holdqueue_release(hq, monotonicms(), hasroute, releasepkt);
+		return;
+	}
+	// 下一跳拥塞时丢弃报文, 不阻塞发往其他下一跳的报文. 本节点发出的段还要通知STCP进程暂停发送
+	if (takecredit(next_NodeID) < 0) {
+		w->busy++;
+		if (item->local) {
+			printf("SIP: NEXT NODE[%d] IS BUSY, DROP SEG TO NODE[%d]\n", next_NodeID, pkt->header.dest_nodeID);
+			memcpy(&seg, pkt->data, pkt->header.length);
+			stcp_sendbusy(pkt->header.dest_nodeID, &seg);
+		} else {
+			printf("SIP: NEXT NODE[%d] IS BUSY, DROP PKT FROM NODE[%d] TO NODE[%d]\n", next_NodeID, pkt->header.src_nodeID, pkt->header.dest_nodeID);
+		}
+		return;
+	}
+	if (!item->local)
+		printf("SIP: FROWARD PKT FROM NODE[%d] TO NODE[%d]\n", pkt->header.src_nodeID, pkt->header.dest_nodeID);
+	if (sendtonext(next_NodeID, pkt) == 0)
+		w->busy++;
+	else
+		w->forwarded++;
+}
+
+
+// 处理一个来自SON进程的报文
+static void handlepkt(sip_pkt_t* pkt)
+{
+	if (pkt->header.type == SIP) {
+		// 同一个流的报文由同一个转发线程按顺序处理
+		seg_t* seg = (seg_t*)pkt->data;
+		fwdpool_put(fwdpool, flowhash(pkt->header.src_nodeID, pkt->header.dest_nodeID, seg), pkt, 0);
+	} else if (pkt->header.type == MCAST && pkt->header.length >= MCAST_LEN(0, sizeof(stcp_hdr_t))) {
+		// 段首部在成员位图之后, 可能没有对齐
+		pkt_mcast_t* mc = (pkt_mcast_t*)pkt->data;
+		seg_t seg;
+		if (pkt->header.length >= MCAST_LEN(mc->mapLen, sizeof(stcp_hdr_t))) {
+			memcpy(&seg.header, mc->data + mc->mapLen, sizeof(stcp_hdr_t));
+			fwdpool_put(fwdpool, flowhash(pkt->header.src_nodeID, pkt->header.dest_nodeID, &seg), pkt, 0);
+		}
+	} else if (((pkt->header.type == ROUTE_UPDATE || pkt->header.type == ROUTE_ACK) && !linkState)
+			|| (pkt->header.type == LSA && linkState) || pkt->header.type == GROUP_REPORT) {
+		// 路由报文和组成员报告交给控制线程, 不在转发路径上重新计算路由
+		ctrlqueue_put(ctrlq, pkt);
+	} else if (pkt->header.type == CREDIT) {
+		pkt_credit_t credit;
+		memcpy(&credit, pkt->data, sizeof(pkt_credit_t));
+		pthread_mutex_lock(credittable_mutex);
+		credittable_grant(ct, credit.nodeID, credit.credits);
+		pthread_mutex_unlock(credittable_mutex);
+	} else if (pkt->header.type == LINK_DOWN && pkt->header.length >= sizeof(pkt_linkdown_t)) {
+		// 先切换到备份下一跳, 再由控制线程重新计算路由
+		pkt_linkdown_t down;
+		memcpy(&down, pkt->data, sizeof(pkt_linkdown_t));
+		failover(down.nodeID);
+		ctrlqueue_put(ctrlq, pkt);
+	}
+}
+
+
+// 处理一个路由报文, 返回报文处理后要执行的动作(发送确认或继续泛洪). 调用者应持有dv_mutex.
+// 距离矢量只写入邻居的行, 受影响的目的节点由调用者一起重新计算. 更新的LSA记在*spf中.
+static int ctrlpkt(sip_pkt_t* pkt, long now, int* spf)
+{
+	int src_nodeID = pkt->header.src_nodeID;
+	if (pkt->header.type == ROUTE_UPDATE) {
 		pkt_routeupdate_t pkt_rp;
-		pkt_rp.entryNum = 0;
-		for (int i = 0; i < topology_getNodeNum(); i++) {
-			pkt_rp.entry[pkt_rp.entryNum].nodeID = nodeArr[i];
-			pkt_rp.entry[pkt_rp.entryNum].cost = dvtable_getcost(dv, myNodeID, nodeArr[i]);
-			pkt_rp.entryNum++;
+		routeupdate_entry_t* entries;
+		memcpy(&pkt_rp, pkt->data, pkt->header.length < sizeof(pkt_rp) ? pkt->header.length : sizeof(pkt_rp));
+		if (pkt->header.length < ROUTEUPDATE_LEN(0))
+			return 0;
+		dvtable_heard(dv, src_nodeID, now);
+		// 收齐一次路由更新的所有分片后, 把条目写入距离向量表
+		int entryNum = rtreasm_add(rtreasm, src_nodeID, &pkt_rp, pkt->header.length, &entries);
+		if (entryNum > 0)
+			dvtable_apply(dv, src_nodeID, entries, entryNum);
+		// 使用了的(或者重复的)路由更新被确认, 不能使用的增量请求完整的距离矢量
+		if (entryNum >= 0 || entryNum == RTREASM_DUP)
+			return CTRL_ACK;
+		if (entryNum == RTREASM_RESYNC)
+			return CTRL_RESYNC;
+	} else if (pkt->header.type == ROUTE_ACK) {
+		pkt_routeack_t ack;
+		if (pkt->header.length < sizeof(ack))
+			return 0;
+		memcpy(&ack, pkt->data, sizeof(ack));
+		// 确认也说明邻居还活着
+		dvtable_heard(dv, src_nodeID, now);
+		adverttable_ack(adverts, src_nodeID, ack.seq, ack.resync);
+		// 邻居需要完整的距离矢量, 尽快发送
+		if (ack.resync)
+			dvchanged();
+	} else if (pkt->header.type == LSA) {
+		pkt_lsa_t lsa;
+		memcpy(&lsa, pkt->data, pkt->header.length < sizeof(lsa) ? pkt->header.length : sizeof(lsa));
+		if (pkt->header.length < LSA_LEN(0) || pkt->header.length < LSA_LEN(lsa.linkNum))
+			return 0;
+		// 继续泛洪更新的LSA, 重复的和过时的LSA到此为止
+		if (lsdb_install(lsdb, &lsa)) {
+			*spf = 1;
+			return CTRL_FLOOD;
+		}
+	} else if (pkt->header.type == GROUP_REPORT) {
+		pkt_groupreport_t report;
+		memcpy(&report, pkt->data, pkt->header.length < sizeof(report) ? pkt->header.length : sizeof(report));
+		// 和LSA一样, 只继续泛洪更新的报告
+		if (mcasttable_install(mcasts, &report, pkt->header.length, now))
+			return CTRL_FLOOD;
+	} else if (pkt->header.type == LINK_DOWN) {
+		pkt_linkdown_t down;
+		memcpy(&down, pkt->data, sizeof(pkt_linkdown_t));
+		nbrcosttable_setcost(nct, down.nodeID, INFINITE_COST);
+		if (linkState) {
+			// 本节点的LSA不再包含这条链路, 路由更新线程会泛洪新的LSA
+			sip_pkt_t lsa;
+			makelsa(&lsa);
+			*spf = 1;
+			dvchanged();
+			return 0;
 		}
+		// 邻居的距离矢量不再可用, 链路恢复后双方从完整的距离矢量重新开始
+		int dests[dv->nodeNum], nextNodes[dv->nodeNum];
+		rtreasm_reset(rtreasm, down.nodeID);
+		adverttable_reset(adverts, down.nodeID);
+		int n = dvtable_setlinkcost(dv, down.nodeID, INFINITE_COST, dests, nextNodes);
+		if (n > 0) {
+			setroutes(dests, n);
+			dvchanged();
+		}
+	}
+	return 0;
+}
+
+
+void* control_daemon(void* arg)
+{
+	int nodeNum = linkState && lsdb->nodeNum > dv->nodeNum ? lsdb->nodeNum : dv->nodeNum;
+	int* dests = (int*)malloc(sizeof(int) * nodeNum);
+	int* nextNodes = (int*)malloc(sizeof(int) * nodeNum);
+	while (1) {
+		ctrl_node_t* list = ctrlqueue_take(ctrlq, SIP_CONTROL_WINDOW);
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		int spf = 0, n;
+
+		pthread_mutex_lock(dv_mutex);
+		struct timespec before = routesChanged;
+		for (ctrl_node_t* c = list; c; c = c->next)
+			c->result = ctrlpkt(&c->pkt, now.tv_sec, &spf);
+		// 整批报文只重新计算一次路由, 路由表只发布一次
+		if (linkState) {
+			if (spf && ((n = lsdb_spf(lsdb, dests, nextNodes)) > 0 || snapshotRestored)) {
+				// 恢复快照后的第一次计算重新发布所有目的节点, 撤销最短路径计算认为不可达的快照路由
+				if (snapshotRestored) {
+					snapshotRestored = 0;
+					n = alldests(dests);
+				}
+				setroutes(dests, n);
+				pthread_cond_broadcast(dv_cond);
+			}
+		} else if ((n = dvtable_recompute(dv, dests, nextNodes)) > 0) {
+			setroutes(dests, n);
+			dvchanged();
+		}
+		int changed = routesChanged.tv_sec != before.tv_sec || routesChanged.tv_nsec != before.tv_nsec;
 		pthread_mutex_unlock(dv_mutex);
 
-		sip_pkt_t pkt;
-		pkt.header.src_nodeID = myNodeID;
-		pkt.header.dest_nodeID = BROADCAST_NODEID;
-		pkt.header.type = ROUTE_UPDATE;
-		pkt.header.length = sizeof(pkt_rp);
-		memcpy(pkt.data, &pkt_rp, pkt.header.length);
-		if (son_sendpkt(BROADCAST_NODEID, &pkt, son_conn) < 0) {
-			son_conn = -1;
+		// 路由改变后, 把已经有路由的目的节点的暂存报文交回转发线程
+		if (changed)
+			holdqueue_release(hq, monotonicms(), hasroute, releasepkt);
+
+		// 在锁外发送确认和泛洪
+		for (ctrl_node_t* c = list; c; c = c->next) {
+			if (c->result == CTRL_ACK || c->result == CTRL_RESYNC) {
+				pkt_routeupdate_t* pkt_rp = (pkt_routeupdate_t*)c->pkt.data;
+				sendrouteack(c->pkt.header.src_nodeID, pkt_rp->seq, c->result == CTRL_RESYNC);
+			} else if (c->result == CTRL_FLOOD) {
+				sendbroadcast(&c->pkt);
+			}
+		}
+		ctrlqueue_free(list);
+	}
+}
+
+
+// 用io_uring接收来自SON进程的报文. 在son_conn上提交多发接收请求, 
+// 每次系统调用收取一批完成事件, 从中取出所有完整的报文帧逐个处理.
+// 如果内核不支持多发接收, 返回并由调用者使用阻塞接收.
+static void pkthandler_uring()
+{
+	uring_cqe_t cqes[URING_BATCH];
+	pktstream_t stream;
+	sip_pkt_t pkt;
+	int armed = -1, streamConn = -1, n;
+
+	while (1) {
+		if (son_conn < 0) {
+			armed = -1;
+			streamConn = -1;
+			select(0, 0, 0, 0, &(struct timeval){.tv_usec = 1e5});
+			continue;
+		}
+		if (armed != son_conn) {
+			// 只在SON连接是新建立的时候重新开始组帧, 重新提交接收请求时保留已经收到的部分报文帧
+			if (streamConn != son_conn) {
+				pktstream_init(&stream, son_conn, "SON_CONN");
+				streamConn = son_conn;
+			}
+			if (uring_recv_multishot(ring, son_conn, son_conn) < 0)
+				return;
+			armed = son_conn;
+		}
+		if ((n = uring_wait(ring, cqes, URING_BATCH, 100)) < 0)
+			return;
+		for (int i = 0; i < n; i++) {
+			uring_cqe_t* cqe = &cqes[i];
+			char* data = uring_buf(ring, cqe);
+			if ((int)cqe->user_data == armed && cqe->res > 0 && data) {
+				for (int off = 0; off < cqe->res; ) {
+					off += pktstream_push(&stream, data + off, cqe->res - off);
+					while (pktstream_next(&stream, &pkt) > 0)
+						handlepkt(&pkt);
+				}
+			}
+			uring_recycle(ring, cqe);
+			if ((cqe->flags & IORING_CQE_F_MORE) || (int)cqe->user_data != armed)
+				continue;
+			// 多发接收请求已经结束
+			if (cqe->res == -EINVAL) {
+				printf("SIP: IO_URING MULTISHOT RECV IS NOT SUPPORTED\n");
+				return;
+			} else if (cqe->res > 0 || cqe->res == -ENOBUFS) {
+				armed = -1;
+			} else {
+				son_conn = -1;
+				armed = -1;
+				streamConn = -1;
+			}
 		}
 	}
 }
@@ -86,58 +954,17 @@ void* routeupdate_daemon(void* arg)
 void* pkthandler(void* arg) 
 {
 	sip_pkt_t pkt;
-	seg_t seg;
-	pkt_routeupdate_t pkt_rp;
 	int n;
 
+	if (ring) {
+		pkthandler_uring();
+		printf("SIP: FALL BACK TO BLOCKING RECV FROM SON\n");
+	}
 	while (1) {
 		if (son_conn < 0) continue;
 
 		if ((n = son_recvpkt(&pkt, son_conn)) > 0) {
-			if (pkt.header.type == SIP) {
-				if (pkt.header.dest_nodeID == topology_getMyNodeID()) {
-					memcpy(&seg, pkt.data, pkt.header.length);
-					if (stcp_conn > 0)
-						if (forwardsegToSTCP(stcp_conn, pkt.header.src_nodeID, &seg) < 0)
-							stcp_conn = -1;
-				} else {
-					pthread_mutex_lock(routingtable_mutex);
-					int next_NodeID = routingtable_getnextnode(routingtable, pkt.header.dest_nodeID);
-					pthread_mutex_unlock(routingtable_mutex);
-					if (next_NodeID != -1) {
-						printf("SIP: FROWARD PKT FROM NODE[%d] TO NODE[%d]\n", pkt.header.src_nodeID, pkt.header.dest_nodeID);
-						if (son_sendpkt(next_NodeID, &pkt, son_conn) < 0)
-							son_conn = -1;
-					}
-				}
-			} else if (pkt.header.type == ROUTE_UPDATE) {
-				int src_nodeID = pkt.header.src_nodeID;
-				memcpy(&pkt_rp, pkt.data, pkt.header.length);
-				pthread_mutex_lock(dv_mutex);
-				for (int i = 0; i < pkt_rp.entryNum; i++) {
-					dvtable_setcost(dv, src_nodeID, pkt_rp.entry[i].nodeID, pkt_rp.entry[i].cost);
-				}
-				int* nbrArr = topology_getNbrArray();
-				int* nodeArr = topology_getNodeArray();
-				int x = topology_getMyNodeID();
-				// 更新距离向量
-				for (int i = 0; i < topology_getNodeNum(); i++) {
-					int y = nodeArr[i];
-					for (int j = 0; j < topology_getNbrNum(); j++) {
-						int v = nbrArr[j];
-						int cost_xv = dvtable_getcost(dv, x, v);
-						int cost_vy = dvtable_getcost(dv, v, y);
-						if (cost_xv + cost_vy < dvtable_getcost(dv, x, y)) {
-							dvtable_setcost(dv, x, y, cost_xv + cost_vy);
-							// 更新路由表
-							pthread_mutex_lock(routingtable_mutex);
-							routingtable_setnextnode(routingtable, y, v);
-							pthread_mutex_unlock(routingtable_mutex);
-						}
-					}
-				}
-				pthread_mutex_unlock(dv_mutex);
-			}
+			handlepkt(&pkt);
 		} else if (n <= 0) {
 			son_conn = -1;
 		}
@@ -145,6 +972,160 @@ void* pkthandler(void* arg)
 }
 
 
+// 处理STCP进程发往组播组group的段: 加入或离开组, 或者把段封装为组播报文发往组的所有其他成员
+static void sendmcast(int group, seg_t* seg)
+{
+	if (seg->header.type == MJOIN || seg->header.type == MLEAVE) {
+		pthread_mutex_lock(dv_mutex);
+		if (mcasttable_join(mcasts, group, seg->header.type == MJOIN) > 0) {
+			// 由路由更新线程泛洪新的组成员报告
+			mcastChanged = 1;
+			pthread_cond_broadcast(dv_cond);
+		}
+		pthread_mutex_unlock(dv_mutex);
+		return;
+	}
+
+	sip_pkt_t pkt;
+	pkt_mcast_t* mc = (pkt_mcast_t*)pkt.data;
+	// STCP连接只是单播的, 只有不可靠的组播数据段发往组的成员
+	if (seg->header.type != MDATA) {
+		printf("SIP: ONLY MDATA SEGS CAN BE SENT TO GROUP[%d], DROP SEG OF TYPE %d\n", group, seg->header.type);
+		return;
+	}
+	int mapLen = mcasts->mapLen, segLen = sizeof(stcp_hdr_t) + seg->header.length;
+	if (MCAST_LEN(mapLen, segLen) > MAX_PKT_LEN) {
+		printf("SIP: SEG TO GROUP[%d] IS TOO LONG, DROP IT\n", group);
+		return;
+	}
+	pthread_mutex_lock(dv_mutex);
+	int n = mcasttable_getmembers(mcasts, group, mc->data);
+	pthread_mutex_unlock(dv_mutex);
+	if (n <= 0) {
+		printf("SIP: GROUP[%d] HAS NO OTHER MEMBERS, DROP SEG\n", group);
+		return;
+	}
+	mc->group = group;
+	mc->mapLen = mapLen;
+	memcpy(mc->data + mapLen, seg, segLen);
+	pkt.header.src_nodeID = topology_getMyNodeID();
+	pkt.header.dest_nodeID = MCAST_BASE + group;
+	pkt.header.length = MCAST_LEN(mapLen, segLen);
+	pkt.header.type = MCAST;
+	pkt.header.ttl = SIP_TTL;
+	if (fwdpool_put(fwdpool, flowhash(pkt.header.src_nodeID, pkt.header.dest_nodeID, seg), &pkt, 1) < 0)
+		printf("SIP: FORWARDING WORKER IS BUSY, DROP SEG TO GROUP[%d]\n", group);
+}
+
+
+// 处理STCP进程idx发来的一个段: 注册端口, 加入组播组, 或者交给转发线程
+static void handleseg(int idx, int dest_nodeID, seg_t* seg)
+{
+	pthread_mutex_lock(stcp_mutex);
+	apps->app[idx].segsIn++;
+	if (seg->header.type == BIND || seg->header.type == UNBIND) {
+		int ok = seg->header.type == BIND ? apptable_bind(apps, idx, seg->header.src_port) : apptable_unbind(apps, idx, seg->header.src_port);
+		pthread_mutex_unlock(stcp_mutex);
+		if (ok < 0)
+			printf("SIP: PORT %u IS USED BY ANOTHER STCP PROCESS\n", seg->header.src_port);
+		return;
+	}
+	// STCP进程发出段时自动注册源端口, 这样没有注册端口的STCP进程也能收到回复
+	if (seg->header.type != MJOIN && seg->header.type != MLEAVE)
+		apptable_bind(apps, idx, seg->header.src_port);
+	pthread_mutex_unlock(stcp_mutex);
+
+	if (dest_nodeID >= MCAST_BASE && dest_nodeID < MCAST_BASE + MCAST_MAX_GROUPS) {
+		sendmcast(dest_nodeID - MCAST_BASE, seg);
+		return;
+	}
+	sip_pkt_t pkt;
+	pkt.header.src_nodeID = topology_getMyNodeID();
+	pkt.header.dest_nodeID = dest_nodeID;
+	pkt.header.length = sizeof(stcp_hdr_t) + seg->header.length;
+	pkt.header.type = SIP;
+	pkt.header.ttl = SIP_TTL;
+	memcpy(pkt.data, seg, pkt.header.length);
+	// 转发线程的缓冲区满了与下一跳拥塞一样处理
+	if (fwdpool_put(fwdpool, flowhash(pkt.header.src_nodeID, dest_nodeID, seg), &pkt, 1) < 0) {
+		printf("SIP: FORWARDING WORKER IS BUSY, DROP SEG TO NODE[%d]\n", dest_nodeID);
+		stcp_sendbusy(dest_nodeID, seg);
+	}
+}
+
+
+// 删除断开的STCP进程. 等待正在向它转交的段完成后再关闭连接
+static void removeapp(int idx)
+{
+	pthread_mutex_lock(stcp_mutex);
+	pthread_mutex_lock(&apps->app[idx].sendMutex);
+	int conn = apptable_remove(apps, idx);
+	pthread_mutex_unlock(&apps->app[idx].sendMutex);
+	pthread_mutex_unlock(stcp_mutex);
+	close(conn);
+	printf("SIP: STCP PROCESS[%d] IS DISCONNECTED\n", idx);
+}
+
+
+// 返回io_uring接收的连接conn所属的STCP进程的下标, 没有时返回-1
+static int armedapp(int conn)
+{
+	int idx = -1;
+	pthread_mutex_lock(stcp_mutex);
+	for (int i = 0; i < SIP_MAX_APPS && idx < 0; i++)
+		if (appArmed[i] && apps->app[i].conn == conn)
+			idx = i;
+	pthread_mutex_unlock(stcp_mutex);
+	return idx;
+}
+
+
+// 使用io_uring时, 这个线程接收所有STCP进程发来的段. 每个STCP进程的连接上有一个多发接收请求,
+// 每次系统调用收取一批完成事件, 从中取出所有完整的段逐个处理. STCP进程断开时删除它.
+void* stcphandler(void* arg)
+{
+	uring_cqe_t cqes[URING_BATCH];
+	seg_t seg;
+	int dest_nodeID, n;
+	while ((n = uring_wait(appRing, cqes, URING_BATCH, 1000)) >= 0) {
+		for (int i = 0; i < n; i++) {
+			uring_cqe_t* cqe = &cqes[i];
+			int conn = (int)cqe->user_data, idx = armedapp(conn);
+			char* data = uring_buf(appRing, cqe);
+			if (idx >= 0 && cqe->res > 0 && data) {
+				for (int off = 0; off < cqe->res; ) {
+					off += segstream_push(&appStreams[idx], data + off, cqe->res - off);
+					while (segstream_next(&appStreams[idx], &dest_nodeID, &seg) > 0)
+						handleseg(idx, dest_nodeID, &seg);
+				}
+			}
+			uring_recycle(appRing, cqe);
+			if ((cqe->flags & IORING_CQE_F_MORE) || idx < 0)
+				continue;
+			// 多发接收请求已经结束
+			if (cqe->res == -EINVAL) {
+				// 内核不支持多发接收, 这个和以后的STCP进程都由waitSTCP()接收
+				printf("SIP: IO_URING MULTISHOT RECV IS NOT SUPPORTED, USE SELECT FOR STCP PROCESSES\n");
+				appUring = 0;
+				appArmed[idx] = 0;
+			} else if (cqe->res > 0 || cqe->res == -ENOBUFS) {
+				// 重新提交, 保留已经收到的部分段帧
+				if (uring_recv_multishot(appRing, conn, conn) < 0)
+					appArmed[idx] = 0;
+			} else {
+				removeapp(idx);
+				appArmed[idx] = 0;
+			}
+		}
+	}
+	printf("SIP: IO_URING WAIT FAILED, USE SELECT FOR STCP PROCESSES\n");
+	appUring = 0;
+	for (int i = 0; i < SIP_MAX_APPS; i++)
+		appArmed[i] = 0;
+	pthread_exit(NULL);
+}
+
+
 void waitSTCP() 
 {
 	printf("SIP: WAIT STCP...\n");
@@ -154,65 +1135,187 @@ void waitSTCP()
 		pthread_exit(NULL);
 	}
 
-	sip_pkt_t pkt;
 	seg_t seg;
-	int dest_nodeID, n;
-	fd_set readmask, allreads;
-	FD_ZERO(&allreads);
-	FD_SET(stcp_listenfd, &allreads);
+	int dest_nodeID, n, next = 0;
+	fd_set readmask, writemask;
+	// 只有这个线程增加STCP进程, 只有接收一个STCP进程的段的线程删除它, 所以读连接不需要加锁.
+	// 由io_uring接收的STCP进程在stcphandler线程中处理, 这里只接受新的连接
 	while (1) {
-		if (stcp_conn <= 0) {
-			readmask = allreads;
-			select(stcp_listenfd + 1, &readmask, NULL, NULL, &(struct timeval){.tv_usec = 1e5});
-			if (FD_ISSET(stcp_listenfd, &readmask)) {
-				struct sockaddr_in client_addr;
-				socklen_t client_len = sizeof(client_addr);
-				if ((stcp_conn = accept(stcp_listenfd, (struct sockaddr *) &client_addr, &client_len)) < 0) {
-					printf("SIP: SERVER ACCEPT FAILED\n");
+		FD_ZERO(&readmask);
+		FD_ZERO(&writemask);
+		FD_SET(stcp_listenfd, &readmask);
+		int maxfd = stcp_listenfd;
+		for (int i = 0; i < SIP_MAX_APPS; i++) {
+			if (apps->app[i].conn < 0)
+				continue;
+			if (!appArmed[i])
+				FD_SET(apps->app[i].conn, &readmask);
+			// 发送缓存中还有段时等待连接可写, 包括由io_uring接收的STCP进程
+			pthread_mutex_lock(&apps->app[i].sendMutex);
+			if (apps->app[i].outLen > 0)
+				FD_SET(apps->app[i].conn, &writemask);
+			pthread_mutex_unlock(&apps->app[i].sendMutex);
+			if (apps->app[i].conn > maxfd)
+				maxfd = apps->app[i].conn;
+		}
+		// stcphandler线程可能把STCP进程交回这个线程, 所以定期重新检查
+		if (select(maxfd + 1, &readmask, &writemask, NULL, &(struct timeval){.tv_usec = 1e5}) <= 0)
+			continue;
+		for (int i = 0; i < SIP_MAX_APPS; i++) {
+			if (apps->app[i].conn >= 0 && FD_ISSET(apps->app[i].conn, &writemask)) {
+				pthread_mutex_lock(&apps->app[i].sendMutex);
+				apptable_flush(apps, i);
+				pthread_mutex_unlock(&apps->app[i].sendMutex);
+			}
+		}
+		if (FD_ISSET(stcp_listenfd, &readmask)) {
+			struct sockaddr_in client_addr;
+			socklen_t client_len = sizeof(client_addr);
+			int conn = accept(stcp_listenfd, (struct sockaddr *) &client_addr, &client_len);
+			if (conn < 0) {
+				printf("SIP: SERVER ACCEPT FAILED\n");
+			} else {
+				pthread_mutex_lock(stcp_mutex);
+				int idx = apptable_add(apps, conn);
+				pthread_mutex_unlock(stcp_mutex);
+				if (idx < 0) {
+					printf("SIP: TOO MANY STCP PROCESSES, REJECT ONE\n");
+					close(conn);
 				} else {
-					printf("SIP: STCP PROCESS IS ACCEPTED\n");
+					printf("SIP: STCP PROCESS[%d] IS ACCEPTED\n", idx);
+					if (appUring) {
+						segstream_init(&appStreams[idx], conn);
+						appArmed[idx] = 1;
+						if (uring_recv_multishot(appRing, conn, conn) < 0)
+							appArmed[idx] = 0;
+					}
 				}
 			}
 		}
-		if (stcp_conn <= 0) continue;
-
-		if ((n = getsegToSend(stcp_conn, &dest_nodeID, &seg)) > 0) {
-			pthread_mutex_lock(routingtable_mutex);
-			int next_nodeID = routingtable_getnextnode(routingtable, dest_nodeID);
-			pthread_mutex_unlock(routingtable_mutex);
-			if (next_nodeID != -1) {
-				pkt.header.src_nodeID = topology_getMyNodeID();
-				pkt.header.dest_nodeID = dest_nodeID;
-				pkt.header.length = sizeof(stcp_hdr_t) + seg.header.length;
-				pkt.header.type = SIP;
-				memcpy(pkt.data, &seg, pkt.header.length);
-				if (son_sendpkt(next_nodeID, &pkt, son_conn) < 0)
-					son_conn = -1;
-			}
-		} else if (n <= 0) {
-			printf("SIP: STCP PROCESS IS DISCONNECTED\n");
-			stcp_conn = -1;
+		// 轮流从每个有段的STCP进程读一个段, 起点每轮后移, 一个发送很快的STCP进程不会独占转发
+		for (int k = 0; k < SIP_MAX_APPS; k++) {
+			int i = (next + k) % SIP_MAX_APPS;
+			if (appArmed[i] || apps->app[i].conn < 0 || !FD_ISSET(apps->app[i].conn, &readmask))
+				continue;
+			if ((n = getsegToSend(apps->app[i].conn, &dest_nodeID, &seg)) > 0)
+				handleseg(i, dest_nodeID, &seg);
+			else
+				removeapp(i);
 		}
+		next = (next + 1) % SIP_MAX_APPS;
 	}
 }
 
 
+// 打印邻居代价表, 所用路由协议的状态和路由表
+static void printroutes()
+{
+	nbrcosttable_print(nct);
+	pthread_mutex_lock(dv_mutex);
+	if (linkState)
+		lsdb_print(lsdb);
+	else
+		dvtable_print(dv);
+	mcasttable_print(mcasts);
+	pthread_mutex_unlock(dv_mutex);
+	rcu_read_lock(routingtable_rcu);
+	routingtable_print(atomic_load(&routingtable));
+	rcu_read_unlock(routingtable_rcu);
+}
+
+
+// 从上次保存的路由快照热启动. 加载的路由立即可用, 之后由邻居的完整距离矢量或LSA修正:
+// 重组表和通告表没有恢复, 邻居的增量会被要求重新发送完整的距离矢量
+static void loadsnapshot()
+{
+	int dests[dv->nodeNum], nextNodes[dv->nodeNum];
+	pthread_mutex_lock(dv_mutex);
+	routingtable_t* old = atomic_load(&routingtable);
+	routingtable_t* rt = routingtable_copy(old);
+	int n = snapshot_load(SIP_SNAPSHOT_FILE, dv, nct, SIP_SNAPSHOT_MAXAGE, rt);
+	if (n < 0) {
+		routingtable_destroy(rt);
+	} else {
+		atomic_store(&routingtable, rt);
+		rcu_retire(routingtable_rcu, old, freeroutingtable);
+		// 距离矢量路由用恢复的邻居距离矢量重新计算, 与当前的直接链路代价一致.
+		// 重新计算只报告与之前的计算结果不同的目的节点, 所以重新发布所有目的节点, 撤销不再可达的快照路由.
+		// 链路状态路由在收到LSA后的第一次最短路径计算时同样处理
+		if (linkState) {
+			snapshotRestored = 1;
+		} else {
+			dvtable_recompute(dv, dests, nextNodes);
+			setroutes(dests, alldests(dests));
+		}
+		printf("SIP: RESTORED %d ROUTES FROM %s\n", n, SIP_SNAPSHOT_FILE);
+	}
+	pthread_mutex_unlock(dv_mutex);
+}
+
+
 void sip_stop()
 {
 	printf("SIP: CLOSE SON_CONN AND STCP_CONN\n");
 	close(son_conn);
-	close(stcp_conn);
+	for (int i = 0; i < SIP_MAX_APPS; i++)
+		if (apps->app[i].conn >= 0)
+			close(apps->app[i].conn);
+	apptable_print(apps);
+	credittable_print(ct);
+	pktqueue_print(sonq);
+	printf("SIP: CONTROL QUEUE: %lu PKTS IN %lu BATCHES, %lu DROPPED\n", ctrlq->pkts, ctrlq->batches, ctrlq->dropped);
+	fwdpool_print(fwdpool);
+	holdqueue_print(hq);
+	// 退出前保存最新的路由, 马上重启时使用. 其他线程持有锁时放弃, 使用上一次周期性保存的快照
+	if (pthread_mutex_trylock(dv_mutex) == 0) {
+		size_t size;
+		void* snapshot = snapshot_build(dv, nct, atomic_load(&routingtable), &size);
+		pthread_mutex_unlock(dv_mutex);
+		if (snapshot)
+			snapshot_write(SIP_SNAPSHOT_FILE, snapshot, size);
+		free(snapshot);
+	}
+	pktqueue_destroy(sonq);
 	nbrcosttable_destroy(nct);
 	dvtable_destroy(dv);
-	routingtable_destroy(routingtable);
+	rtreasm_destroy(rtreasm);
+	adverttable_destroy(adverts);
+	mcasttable_destroy(mcasts);
+	if (lsdb)
+		lsdb_destroy(lsdb);
+	routingtable_destroy(atomic_load(&routingtable));
+	rcu_destroy(routingtable_rcu);
+	credittable_destroy(ct);
+	apptable_destroy(apps);
 	free(dv_mutex);
-	free(routingtable_mutex);
+	free(dv_cond);
+	free(credittable_mutex);
+	free(stcp_mutex);
 	exit(0);
 }
 
 
 int main(int argc, char *argv[]) 
 {
+	//命令行参数uring/threads选择接收来自SON进程的报文的方式, dv/ls选择路由协议, workers=N设置转发线程数
+	int useUring = IO_URING, workers = SIP_WORKERS;
+	linkState = SIP_LINKSTATE;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "uring") == 0)
+			useUring = 1;
+		else if (strcmp(argv[i], "threads") == 0)
+			useUring = 0;
+		else if (strcmp(argv[i], "ls") == 0)
+			linkState = 1;
+		else if (strcmp(argv[i], "dv") == 0)
+			linkState = 0;
+		else if (strncmp(argv[i], "workers=", 8) == 0)
+			workers = atoi(argv[i] + 8);
+	}
+	if (workers < 1)
+		workers = 1;
+	if (workers > SIP_MAX_WORKERS)
+		workers = SIP_MAX_WORKERS;
 
 	printf("SIP: SIP LAYER IS STARTING, PLEASE WAIT...\n");
 
@@ -222,17 +1325,48 @@ int main(int argc, char *argv[])
 	//初始化全局变量
 	nct = nbrcosttable_create();
 	dv = dvtable_create();
+	rtreasm = rtreasm_create();
+	adverts = adverttable_create(dv->nodeNum);
+	mcasts = mcasttable_create();
+	//序号从当前时间开始, 这样重启后的路由更新不会被邻居当作过时的
+	routeupdateSeq = (unsigned int)time(NULL);
+	if (linkState)
+		lsdb = lsdb_create(nct);
 	dv_mutex = (pthread_mutex_t*)malloc(sizeof(pthread_mutex_t));
 	pthread_mutex_init(dv_mutex,NULL);
+	//路由更新线程等待距离矢量变化, 使用单调时钟计时
+	dv_cond = (pthread_cond_t*)malloc(sizeof(pthread_cond_t));
+	pthread_condattr_t condattr;
+	pthread_condattr_init(&condattr);
+	pthread_condattr_setclock(&condattr, CLOCK_MONOTONIC);
+	pthread_cond_init(dv_cond, &condattr);
+	pthread_condattr_destroy(&condattr);
+	//启动后立即发送第一个路由更新报文或LSA
+	dvChanged = 1;
 	routingtable = routingtable_create();
-	routingtable_mutex = (pthread_mutex_t*)malloc(sizeof(pthread_mutex_t));
-	pthread_mutex_init(routingtable_mutex,NULL);
+	routingtable_rcu = rcu_create();
+	loadsnapshot();
+	ct = credittable_create();
+	credittable_mutex = (pthread_mutex_t*)malloc(sizeof(pthread_mutex_t));
+	pthread_mutex_init(credittable_mutex,NULL);
+	stcp_mutex = (pthread_mutex_t*)malloc(sizeof(pthread_mutex_t));
+	pthread_mutex_init(stcp_mutex,NULL);
 	son_conn = -1;
-	stcp_conn = -1;
+	apps = apptable_create();
+	hq = holdqueue_create(SIP_HOLD_PKTS, SIP_HOLD_TIME);
+	sonq = pktqueue_create(-1, "SON_CONN");
+	ctrlq = ctrlqueue_create(SIP_CONTROL_QUEUE);
+	fwdpool = fwdpool_create(workers, SIP_WORKER_QUEUE, forwardpkt);
+	if (useUring && (ring = uring_create(URING_ENTRIES, URING_BUFS, URING_BUF_SIZE)) == NULL)
+		printf("SIP: IO_URING IS NOT AVAILABLE, USE BLOCKING RECV\n");
+	//STCP进程的段用另一个io_uring接收, 由stcphandler线程处理
+	if (ring && (appRing = uring_create(URING_ENTRIES, URING_BUFS, URING_BUF_SIZE)) != NULL) {
+		appUring = 1;
+		pthread_t stcp_handler_thread;
+		pthread_create(&stcp_handler_thread, NULL, stcphandler, (void*)0);
+	}
 
-	nbrcosttable_print(nct);
-	dvtable_print(dv);
-	routingtable_print(routingtable);
+	printroutes();
 
 	//注册用于终止进程的信号句柄
 	signal(SIGINT, sip_stop);
@@ -250,18 +1384,23 @@ int main(int argc, char *argv[])
 	pthread_t pkt_handler_thread; 
 	pthread_create(&pkt_handler_thread, NULL, pkthandler, (void*)0);
 
+	//启动处理路由报文的控制线程
+	pthread_t control_thread;
+	pthread_create(&control_thread, NULL, control_daemon, (void*)0);
+
 	//启动路由更新线程 
 	pthread_t routeupdate_thread;
 	pthread_create(&routeupdate_thread, NULL, routeupdate_daemon, (void*)0);	
 
 
 	printf("SIP: SIP LAYER IS STARTED...\n");
-	printf("SIP: WAITING FOR ROUTES TO BE ESTABLISHED\n");
-	sleep(SIP_WAITTIME / 2);
+	printf("SIP: WAITING FOR ROUTES TO CONVERGE\n");
+	if (waitconverged(SIP_WAITTIME / 2))
+		printf("SIP: ROUTES CONVERGED\n");
+	else
+		printf("SIP: ROUTES HAVE NOT CONVERGED IN %d SECONDS\n", SIP_WAITTIME / 2);
 	//打印建立好的路由信息
-	nbrcosttable_print(nct);
-	dvtable_print(dv);
-	routingtable_print(routingtable);
+	printroutes();
 
 
 	//等待来自STCP进程的连接
@@ -8,6 +8,8 @@
 #ifndef NETWORK_H
 #define NETWORK_H
 
+#include "../common/seg.h"
+
 
 /**
  * @brief   SIP进程使用这个函数连接到本地SON进程的端口SON_PORT
@@ -19,9 +21,10 @@ int connectToSON();
 
 
 /**
- * @brief   这个线程每隔ROUTEUPDATE_INTERVAL时间就发送一条路由更新报文
- *          在本实验中, 这个线程只广播空的路由更新报文给所有邻居, 
- *          通过设置SIP报文首部中的dest_nodeID为BROADCAST_NODEID来发送广播
+ * @brief   这个线程在本节点的距离矢量变化时发送路由更新报文(触发更新),
+ *          两次路由更新至少间隔ROUTEUPDATE_HOLDDOWN毫秒, 期间的变化合并到一次路由更新中.
+ *          距离矢量没有变化时, 每隔ROUTEUPDATE_INTERVAL时间发送一次作为刷新.
+ *          每个邻居收到与它确认的版本之间的增量, 使用链路状态路由时广播本节点的LSA.
  * 
  * @param arg 
  * @return void* 
@@ -32,7 +35,8 @@ void* routeupdate_daemon(void* arg);
 /**
  * @brief   这个线程处理来自SON进程的进入报文
  *          它通过调用son_recvpkt()接收来自SON进程的报文
- *          在本实验中, 这个线程在接收到报文后, 只是显示报文已接收到的信息, 并不处理报文
+ *          数据报文和信用报文在这个线程中处理, 路由报文放入控制报文队列交给控制线程,
+ *          这样重新计算路由时数据报文仍然用之前的路由表转发.
  * 
  * @param arg 
  * @return void* 
@@ -40,6 +44,40 @@ void* routeupdate_daemon(void* arg);
 void* pkthandler(void* arg); 
 
 
+/**
+ * @brief   这个线程处理路由报文(路由更新, 确认和LSA).
+ *          它每次从控制报文队列中取出SIP_CONTROL_WINDOW毫秒内到达的所有报文,
+ *          在一次加锁中处理它们, 受影响的路由只重新计算和发布一次.
+ * 
+ * @param arg 
+ * @return void* 
+ */
+void* control_daemon(void* arg);
+
+
+/**
+ * @brief   使用io_uring时, 这个线程接收所有本地STCP进程发来的段.
+ *          waitSTCP()接受STCP进程的连接后在它上面提交一个多发接收请求,
+ *          这个线程每次系统调用收取所有STCP进程上的一批完成事件, 从段帧流中取出完整的段处理,
+ *          并删除断开的STCP进程. 内核不支持多发接收时, STCP进程交回waitSTCP()用select()接收.
+ * 
+ * @param arg 
+ * @return void* 
+ */
+void* stcphandler(void* arg);
+
+
+/**
+ * @brief   这个函数向STCP进程发送BUSY段, 表示STCP进程发往dest_nodeID的段seg
+ *          因为下一跳没有信用(拥塞)而被丢弃了. 
+ *          BUSY段的端口号与seg相反, ack_num为seg的序号, STCP发送方据此暂停发送新段.
+ * 
+ * @param dest_nodeID 
+ * @param seg 
+ */
+void stcp_sendbusy(int dest_nodeID, seg_t* seg);
+
+
 /**
  * @brief   这个函数终止SIP进程, 当SIP进程收到信号SIGINT时会调用这个函数 
  *          它关闭所有连接, 释放所有动态分配的内存
@@ -0,0 +1,214 @@
+/**
+ * @file    sip/snapshot.c
+ * @brief   这个文件实现用于保存和加载路由快照的数据结构和函数.
+ * @date    2023-03-31
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../common/constants.h"
+#include "../topology/topology.h"
+#include "snapshot.h"
+
+
+// 快照各部分的位置
+typedef struct snapshotlayout {
+    size_t nbr, col, row, route, size;
+} snapshot_layout_t;
+
+static void layout(snapshot_layout_t* l, int nbrNum, int nodeNum, int routeNum)
+{
+    l->nbr = sizeof(snapshot_hdr_t);
+    l->col = l->nbr + sizeof(snapshot_nbr_t) * nbrNum;
+    l->row = l->col + sizeof(int) * nodeNum;
+    l->route = l->row + sizeof(unsigned int) * nbrNum * nodeNum;
+    l->size = l->route + sizeof(snapshot_route_t) * routeNum;
+}
+
+// 首部之后所有数据的FNV-1a校验和, 用于发现不完整或损坏的文件
+static unsigned int checksum(const unsigned char* data, size_t len)
+{
+    unsigned int h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= data[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+
+void* snapshot_build(dv_t* dv, nbr_cost_entry_t* nct, routingtable_t* rt, size_t* size)
+{
+    int nbrNum = dv->rowNum - 1, routeNum = 0;
+    for (int i = 0; i < rt->slotNum; i++)
+        for (routingtable_entry_t* e = rt->hash[i]; e; e = e->next)
+            if (e->nextNum > 0)
+                routeNum++;
+    snapshot_layout_t l;
+    layout(&l, nbrNum, dv->nodeNum, routeNum);
+    unsigned char* buf = (unsigned char*)calloc(l.size, 1);
+    if (buf == NULL)
+        return NULL;
+
+    snapshot_nbr_t* nbr = (snapshot_nbr_t*)(buf + l.nbr);
+    unsigned int* row = (unsigned int*)(buf + l.row);
+    for (int i = 0; i < nbrNum; i++) {
+        nbr[i].nodeID = dv->rowID[i];
+        nbr[i].cost = nbrcosttable_getcost(nct, dv->rowID[i]);
+        memcpy(row + (size_t)i * dv->nodeNum, dv->cost + (size_t)i * dv->stride, sizeof(unsigned int) * dv->nodeNum);
+    }
+    memcpy(buf + l.col, dv->colID, sizeof(int) * dv->nodeNum);
+    snapshot_route_t* route = (snapshot_route_t*)(buf + l.route);
+    for (int i = 0; i < rt->slotNum; i++) {
+        for (routingtable_entry_t* e = rt->hash[i]; e; e = e->next) {
+            if (e->nextNum <= 0)
+                continue;
+            route->destNodeID = e->destNodeID;
+            route->nextNum = e->nextNum;
+            memcpy(route->nextNodeIDs, e->nextNodeIDs, sizeof(route->nextNodeIDs));
+            route->backupNodeID = e->backupNodeID;
+            route++;
+        }
+    }
+
+    snapshot_hdr_t* hdr = (snapshot_hdr_t*)buf;
+    hdr->magic = SNAPSHOT_MAGIC;
+    hdr->version = SNAPSHOT_VERSION;
+    hdr->nodeID = topology_getMyNodeID();
+    hdr->nbrNum = nbrNum;
+    hdr->nodeNum = dv->nodeNum;
+    hdr->routeNum = routeNum;
+    hdr->savedAt = (long long)time(NULL);
+    hdr->checksum = checksum(buf + sizeof(snapshot_hdr_t), l.size - sizeof(snapshot_hdr_t));
+    *size = l.size;
+    return buf;
+}
+
+
+int snapshot_write(const char* path, void* snapshot, size_t size)
+{
+    char tmp[256];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return -1;
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = write(fd, (char*)snapshot + done, size - done);
+        if (n <= 0) {
+            close(fd);
+            unlink(tmp);
+            return -1;
+        }
+        done += n;
+    }
+    close(fd);
+    // 重命名是原子的, 进程在写入期间退出也不会留下不完整的快照
+    if (rename(tmp, path) < 0) {
+        unlink(tmp);
+        return -1;
+    }
+    return 1;
+}
+
+
+// 节点nodeID是否是当前的邻居(距离矢量表中除最后一行外的源节点)
+static int isnbr(dv_t* dv, int nodeID)
+{
+    int j = topology_getNodeIndex(nodeID);
+    return j >= 0 && dv->rowOf[j] >= 0 && dv->rowOf[j] < dv->rowNum - 1;
+}
+
+
+// 检查快照是否可以在当前拓扑中使用
+static int usable(const unsigned char* buf, size_t size, const snapshot_layout_t* l, dv_t* dv, nbr_cost_entry_t* nct, long maxAge)
+{
+    const snapshot_hdr_t* hdr = (const snapshot_hdr_t*)buf;
+    long long age = (long long)time(NULL) - hdr->savedAt;
+    if (size != l->size || age < 0 || age > maxAge)
+        return 0;
+    if (hdr->checksum != checksum(buf + sizeof(snapshot_hdr_t), size - sizeof(snapshot_hdr_t)))
+        return 0;
+    if (memcmp(buf + l->col, dv->colID, sizeof(int) * dv->nodeNum) != 0)
+        return 0;
+    const snapshot_nbr_t* nbr = (const snapshot_nbr_t*)(buf + l->nbr);
+    for (int i = 0; i < hdr->nbrNum; i++) {
+        if (nbr[i].nodeID != dv->rowID[i])
+            return 0;
+        if (nbr[i].cost < INFINITE_COST && nbr[i].cost != nbrcosttable_getcost(nct, nbr[i].nodeID))
+            return 0;
+    }
+    return 1;
+}
+
+
+int snapshot_load(const char* path, dv_t* dv, nbr_cost_entry_t* nct, long maxAge, routingtable_t* rt)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(snapshot_hdr_t)) {
+        close(fd);
+        return -1;
+    }
+    size_t size = st.st_size;
+    unsigned char* buf = (unsigned char*)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (buf == MAP_FAILED)
+        return -1;
+
+    const snapshot_hdr_t* hdr = (const snapshot_hdr_t*)buf;
+    snapshot_layout_t l;
+    int n = -1;
+    if (hdr->magic != SNAPSHOT_MAGIC || hdr->version != SNAPSHOT_VERSION || hdr->nodeID != topology_getMyNodeID()
+            || hdr->nbrNum != dv->rowNum - 1 || hdr->nodeNum != dv->nodeNum || hdr->routeNum < 0 || hdr->routeNum > dv->nodeNum)
+        goto out;
+    layout(&l, hdr->nbrNum, hdr->nodeNum, hdr->routeNum);
+    if (!usable(buf, size, &l, dv, nct, maxAge))
+        goto out;
+
+    // 邻居的行像收到了它们的完整距离矢量一样写入, 由调用者一起重新计算
+    const unsigned int* row = (const unsigned int*)(buf + l.row);
+    routeupdate_entry_t* entries = (routeupdate_entry_t*)malloc(sizeof(routeupdate_entry_t) * (dv->nodeNum > 0 ? dv->nodeNum : 1));
+    for (int i = 0; i < hdr->nbrNum; i++) {
+        for (int j = 0; j < dv->nodeNum; j++) {
+            entries[j].nodeID = dv->colID[j];
+            entries[j].cost = row[(size_t)i * dv->nodeNum + j];
+        }
+        dvtable_apply(dv, dv->rowID[i], entries, dv->nodeNum);
+    }
+    free(entries);
+
+    // 下一跳必须仍然是邻居
+    const snapshot_route_t* route = (const snapshot_route_t*)(buf + l.route);
+    n = 0;
+    for (int k = 0; k < hdr->routeNum; k++, route++) {
+        int hops[MAX_ECMP_PATHS], hopNum = 0;
+        if (topology_getNodeIndex(route->destNodeID) < 0)
+            continue;
+        for (int h = 0; h < route->nextNum && h < MAX_ECMP_PATHS; h++) {
+            int next = route->nextNodeIDs[h];
+            if (isnbr(dv, next))
+                hops[hopNum++] = next;
+        }
+        if (hopNum == 0)
+            continue;
+        int backup = route->backupNodeID;
+        if (!isnbr(dv, backup))
+            backup = -1;
+        routingtable_setnextnodes(rt, route->destNodeID, hops, hopNum);
+        routingtable_setbackup(rt, route->destNodeID, backup);
+        n++;
+    }
+out:
+    munmap(buf, size);
+    return n;
+}
@@ -0,0 +1,93 @@
+/**
+ * @file    sip/snapshot.h
+ * @brief   这个文件定义用于保存和加载路由快照的数据结构和函数.
+ * @date    2023-03-31
+ */
+
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stddef.h>
+#include "../common/constants.h"
+#include "dvtable.h"
+#include "nbrcosttable.h"
+#include "routingtable.h"
+
+
+#define SNAPSHOT_MAGIC 0x53495053     //"SIPS"
+#define SNAPSHOT_VERSION 1
+
+/* 路由快照文件格式
+  快照文件是一块连续的内存映像, 加载时直接mmap, 不需要解析:
+  首部之后依次是nbrNum个邻居条目, nodeNum个列的节点ID, nbrNum行每行nodeNum个邻居的距离矢量, 以及routeNum个路由条目.
+  所有字段都是4字节或8字节对齐的, 快照只在同一台主机上重启时使用, 不考虑字节序. */
+typedef struct snapshothdr {
+	unsigned int magic;         //SNAPSHOT_MAGIC
+	unsigned int version;       //SNAPSHOT_VERSION
+	int nodeID;                 //保存快照的节点ID
+	int nbrNum;                 //邻居数
+	int nodeNum;                //重叠网络中总的节点数
+	int routeNum;               //路由条目数
+	long long savedAt;          //保存快照的时刻(墙上时间, 秒)
+	unsigned int checksum;      //首部之后所有数据的校验和
+	unsigned int pad;
+} snapshot_hdr_t;
+
+//邻居条目: 保存快照时的直接链路代价, INFINITE_COST表示链路已经断开
+typedef struct snapshotnbr {
+	int nodeID;
+	unsigned int cost;
+} snapshot_nbr_t;
+
+//路由条目, 与routingtable_entry_t相同但没有链表指针
+typedef struct snapshotroute {
+	int destNodeID;
+	int nextNum;
+	int nextNodeIDs[MAX_ECMP_PATHS];
+	int backupNodeID;
+} snapshot_route_t;
+
+
+/**
+ * @brief   这个函数把距离矢量表dv中邻居的行, 邻居代价表nct和路由表rt编码为一个快照, 返回动态分配的快照, 大小写入*size.
+ *          调用者应保证生成快照期间这三个表不被修改, 并用free()释放返回的快照.
+ *
+ * @param dv
+ * @param nct
+ * @param rt
+ * @param size
+ * @return void*
+ */
+void* snapshot_build(dv_t* dv, nbr_cost_entry_t* nct, routingtable_t* rt, size_t* size);
+
+
+/**
+ * @brief   这个函数把大小为size的快照写入文件path. 先写入临时文件再重命名, 所以path总是一个完整的快照.
+ *          成功时返回1, 失败时返回-1.
+ *
+ * @param path
+ * @param snapshot
+ * @param size
+ * @return int
+ */
+int snapshot_write(const char* path, void* snapshot, size_t size);
+
+
+/**
+ * @brief   这个函数从文件path加载快照: 把邻居的距离矢量写入dv(调用者之后调用dvtable_recompute()), 把路由写入rt.
+ * @details 只有本节点保存的, 不超过maxAge秒的, 节点和邻居与当前拓扑相同的完整快照才会被加载.
+ *          保存时链路正常的邻居的代价必须与当前的直接链路代价相同, 否则拓扑已经改变, 快照被丢弃.
+ *          直接链路代价总是使用topology.dat中的值, 保存时已经断开的链路在重启后重新开始.
+ *          返回加载的路由条目数, 没有可用的快照时返回-1.
+ *
+ * @param path
+ * @param dv
+ * @param nct
+ * @param maxAge
+ * @param rt
+ * @return int
+ */
+int snapshot_load(const char* path, dv_t* dv, nbr_cost_entry_t* nct, long maxAge, routingtable_t* rt);
+
+#endif
@@ -0,0 +1,180 @@
+/**
+ * @file    son/egress.c
+ * @brief   这个文件实现邻居链路出口合并缓冲区
+ * @date    2023-03-02
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include "../common/constants.h"
+#include "../common/pkt.h"
+#include "egress.h"
+
+
+// 发送线程: 等待合并时间预算用完后, 用一次写操作发送缓冲区中所有的帧
+static void* egress_daemon(void* arg)
+{
+	nbr_egress_t* egress = (nbr_egress_t*)arg;
+	pthread_mutex_lock(&egress->mutex);
+	while (1) {
+		while (egress->len == 0 && !egress->stop)
+			pthread_cond_wait(&egress->ready, &egress->mutex);
+		if (egress->len == 0)
+			break;
+		while (!egress->flush && !egress->stop) {
+			if (pthread_cond_timedwait(&egress->ready, &egress->mutex, &egress->deadline) == ETIMEDOUT)
+				break;
+		}
+		// 交换缓冲区, 入队者可以在写出的同时继续合并
+		char* out = egress->buf;
+		int len = egress->len;
+		int nframes = egress->nframes;
+		egress->buf = egress->spare;
+		egress->spare = out;
+		egress->len = 0;
+		egress->nframes = 0;
+		egress->flush = 0;
+		egress->writes++;
+		pthread_cond_broadcast(&egress->space);
+		int conn = egress->nbr->conn;
+		pthread_mutex_unlock(&egress->mutex);
+
+		// UDP链路把每个帧作为一个数据报, 用一次sendmmsg()批量发送
+		if (conn > 0 && egress->nbr->udp && sendframes_dgram(out, len, conn) < 0)
+			egress->nbr->conn = -1;
+		else if (conn > 0 && !egress->nbr->udp && sendframes(out, len, conn) < 0)
+			egress->nbr->conn = -1;
+		if (egress->sent)
+			egress->sent(egress->nbr, nframes);
+
+		pthread_mutex_lock(&egress->mutex);
+		egress->inflight -= nframes;
+	}
+	pthread_mutex_unlock(&egress->mutex);
+	return NULL;
+}
+
+
+nbr_egress_t* egress_create(nbr_entry_t* nbr)
+{
+	nbr_egress_t* egress = (nbr_egress_t*)malloc(sizeof(nbr_egress_t));
+	assert(egress != NULL);
+	egress->nbr = nbr;
+	egress->buf = (char*)malloc(SON_EGRESS_BUF_SIZE);
+	egress->spare = (char*)malloc(SON_EGRESS_BUF_SIZE);
+	assert(egress->buf != NULL && egress->spare != NULL);
+	egress->len = 0;
+	egress->nframes = 0;
+	egress->inflight = 0;
+	egress->flush = 0;
+	egress->stop = 0;
+	egress->sent = NULL;
+	egress->frames = 0;
+	egress->writes = 0;
+	pthread_mutex_init(&egress->mutex, NULL);
+	// 截止时间使用单调时钟, 不受系统时间调整的影响
+	pthread_condattr_t attr;
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&egress->ready, &attr);
+	pthread_condattr_destroy(&attr);
+	pthread_cond_init(&egress->space, NULL);
+	pthread_create(&egress->thread, NULL, egress_daemon, (void*)egress);
+	return egress;
+}
+
+
+void egress_destroy(nbr_egress_t* egress)
+{
+	if (!egress)
+		return;
+	pthread_mutex_lock(&egress->mutex);
+	// 停止时不再返还信用
+	egress->sent = NULL;
+	egress->stop = 1;
+	pthread_cond_signal(&egress->ready);
+	pthread_mutex_unlock(&egress->mutex);
+	pthread_join(egress->thread, NULL);
+
+	pthread_mutex_destroy(&egress->mutex);
+	pthread_cond_destroy(&egress->ready);
+	pthread_cond_destroy(&egress->space);
+	free(egress->buf);
+	free(egress->spare);
+	free(egress);
+}
+
+
+int egress_sendpkt(nbr_egress_t* egress, sip_pkt_t* pkt)
+{
+	if (pkt->header.length > MAX_PKT_LEN)
+		return -1;
+	// 在入队之前压缩, 不占用缓冲区互斥量
+	sip_pkt_t zipPkt;
+	if (linkcodec_compress(&egress->nbr->codec, pkt, &zipPkt) > 0)
+		pkt = &zipPkt;
+	int len = PKT_FRAME_OVERHEAD + pkt->header.length;
+
+	pthread_mutex_lock(&egress->mutex);
+	// 缓冲区放不下这个帧, 要求发送线程立即发送并等待它取走缓冲区
+	while (egress->len + len > SON_EGRESS_BUF_SIZE && egress->nbr->conn > 0) {
+		egress->flush = 1;
+		pthread_cond_signal(&egress->ready);
+		pthread_cond_wait(&egress->space, &egress->mutex);
+	}
+	if (egress->nbr->conn <= 0) {
+		pthread_mutex_unlock(&egress->mutex);
+		return -1;
+	}
+
+	if (egress->len == 0) {
+		clock_gettime(CLOCK_MONOTONIC, &egress->deadline);
+		egress->deadline.tv_nsec += SON_COALESCE_USEC * 1000L;
+		egress->deadline.tv_sec += egress->deadline.tv_nsec / 1000000000L;
+		egress->deadline.tv_nsec %= 1000000000L;
+	}
+	pkt_frame(pkt, egress->buf + egress->len);
+	egress->len += len;
+	egress->nframes++;
+	egress->inflight++;
+	egress->frames++;
+	if (SON_COALESCE_USEC == 0 || len > SON_COALESCE_MAXFRAME)
+		egress->flush = 1;
+	// 只有第一个帧入队或要求立即发送时才需要唤醒发送线程
+	if (egress->len == len || egress->flush)
+		pthread_cond_signal(&egress->ready);
+	pthread_mutex_unlock(&egress->mutex);
+	return 1;
+}
+
+
+void egress_flush(nbr_egress_t* egress)
+{
+	pthread_mutex_lock(&egress->mutex);
+	if (egress->len > 0) {
+		egress->flush = 1;
+		pthread_cond_signal(&egress->ready);
+	}
+	pthread_mutex_unlock(&egress->mutex);
+}
+
+
+int egress_inflight(nbr_egress_t* egress)
+{
+	pthread_mutex_lock(&egress->mutex);
+	int inflight = egress->inflight;
+	pthread_mutex_unlock(&egress->mutex);
+	return inflight;
+}
+
+
+void egress_print(nbr_egress_t* egress)
+{
+	printf("SON: NEIGHBOR[%d] EGRESS [FRAMES: %lu | WRITES: %lu | FRAMES/WRITE: %.2f]\n",
+		egress->nbr->nodeID, egress->frames, egress->writes,
+		egress->writes ? (double)egress->frames / egress->writes : 0.0);
+}
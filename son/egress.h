@@ -0,0 +1,98 @@
+/**
+ * @file    son/egress.h
+ * @brief   这个文件定义邻居链路出口合并缓冲区的数据结构和API
+ * @date    2023-03-02
+ */
+
+
+#ifndef EGRESS_H
+#define EGRESS_H
+
+#include <pthread.h>
+#include <time.h>
+#include "../common/pkt.h"
+#include "neighbortable.h"
+
+//每个邻居有一个出口合并缓冲区和一个发送线程.
+//SON进程把要发给该邻居的报文组帧后追加到缓冲区中, 发送线程在第一个帧入队SON_COALESCE_USEC微秒后,
+//或者缓冲区将满/要求立即发送时, 用一次写操作把缓冲区中所有的帧发送出去.
+//发送线程写出一个缓冲区的同时, 入队者可以继续向另一个缓冲区追加帧.
+//UDP链路上每个帧作为一个数据报, 缓冲区中的帧用sendmmsg()批量发送.
+
+typedef struct nbregress {
+	nbr_entry_t* nbr;            //所属的邻居表条目
+	char* buf;                   //正在合并帧的缓冲区
+	char* spare;                 //由发送线程写出的缓冲区
+	int len;                     //buf中已合并的字节数
+	int nframes;                 //buf中已合并的帧数
+	int inflight;                //已入队但还没有被写出的帧数
+	int flush;                   //为1时发送线程不再等待, 立即发送
+	int stop;                    //为1时发送线程在发送完剩余的帧后退出
+	struct timespec deadline;    //buf中第一个帧最迟的发送时间
+	unsigned long frames;        //已入队的帧数
+	unsigned long writes;        //发送线程执行的写操作次数
+	pthread_mutex_t mutex;       //缓冲区互斥量
+	pthread_cond_t ready;        //有帧入队或要求发送时通知发送线程
+	pthread_cond_t space;        //缓冲区被发送线程取走后通知等待的入队者
+	pthread_t thread;            //发送线程
+	void (*sent)(nbr_entry_t* nbr, int frames);  //每次写出(或因连接断开而丢弃)若干帧后调用, 可以为NULL
+} nbr_egress_t;
+
+
+/**
+ * @brief   这个函数为邻居表条目nbr创建出口合并缓冲区, 并启动该邻居的发送线程.
+ *          发送线程使用nbr中的conn字段发送, 因此可以在连接建立之前创建.
+ * 
+ * @param nbr 
+ * @return nbr_egress_t* 
+ */
+nbr_egress_t* egress_create(nbr_entry_t* nbr);
+
+
+/**
+ * @brief   这个函数发送缓冲区中剩余的帧, 停止发送线程, 并释放出口合并缓冲区.
+ * 
+ * @param egress 
+ */
+void egress_destroy(nbr_egress_t* egress);
+
+
+/**
+ * @brief   这个函数将报文组帧后追加到邻居的出口合并缓冲区中.
+ *          如果链路协商启用了压缩, 报文在入队之前被压缩.
+ *          长度超过SON_COALESCE_MAXFRAME的帧会使缓冲区立即被发送.
+ *          如果缓冲区已满, 这个函数等待发送线程取走缓冲区.
+ *          入队成功返回1, 如果到该邻居的连接已断开或报文非法, 返回-1.
+ * 
+ * @param egress 
+ * @param pkt 
+ * @return int 
+ */
+int egress_sendpkt(nbr_egress_t* egress, sip_pkt_t* pkt);
+
+
+/**
+ * @brief   这个函数要求发送线程立即发送缓冲区中已合并的帧, 不再等待合并时间预算.
+ * 
+ * @param egress 
+ */
+void egress_flush(nbr_egress_t* egress);
+
+
+/**
+ * @brief   这个函数返回已入队但还没有被写出的帧数.
+ * 
+ * @param egress 
+ * @return int 
+ */
+int egress_inflight(nbr_egress_t* egress);
+
+
+/**
+ * @brief   这个函数打印出口合并缓冲区的统计信息.
+ * 
+ * @param egress 
+ */
+void egress_print(nbr_egress_t* egress);
+
+#endif
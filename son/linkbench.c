@@ -0,0 +1,314 @@
+/**
+ * @file    son/linkbench.c
+ * @brief   这个文件实现邻居链路的基准测试程序. 
+ *          它在本机回环地址上建立一条TCP或UDP链路, 通过出口合并缓冲区发送数据报文, 
+ *          并在链路之上运行与STCP相同窗口大小(GBN_WINDOW)的回退N步(GBN)重传, 测量有效吞吐量和重传次数.
+ *          链路损伤在进程内模拟, 不需要root权限: 每个接收方向上的帧以丢包率丢失, 并加上单向时延.
+ *          UDP链路上丢失的帧直接丢弃, 由GBN重传; TCP链路上丢失的帧由TCP自己重传, 
+ *          它在额外的恢复时间后才交付, 后面的帧都要等它(队头阻塞).
+ *          丢包率默认是STCP使用的PKT_LOSS_RATE. linkbench.sh用同样的损伤比较两种链路.
+ *          用法: ./son/linkbench tcp|udp [报文数] [数据长度] [超时毫秒数] [丢包率] [单向时延毫秒数] [TCP恢复毫秒数] > /dev/null
+ *          TCP恢复时间默认是一个往返时间加1毫秒, 即快速重传的情况. 结果输出到标准错误.
+ * @date    2023-03-08
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "../common/constants.h"
+#include "../common/pkt.h"
+#include "../common/tcp.h"
+#include "neighbortable.h"
+#include "egress.h"
+
+//基准测试使用的本地端口
+#define BENCH_PORT 6700
+//每个接收方向的延迟队列能容纳的帧数
+#define DELAY_SLOTS 1024
+
+//链路两端: data为发送方, ack为接收方
+nbr_entry_t data, ack;
+//发送窗口状态
+int total, pktLen;
+int base = 0;
+unsigned long retransmits = 0;
+pthread_mutex_t bench_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t bench_cond;
+//链路损伤: 丢包率, 单向时延和TCP恢复一个丢失的帧的时间, 时间单位为秒
+double lossRate = PKT_LOSS_RATE, delay = 0, tcpRecover;
+
+//链路的一个接收方向: 读线程从套接字接收帧, 施加损伤后放入延迟队列, 帧到期后才交给接收者
+typedef struct delayline {
+	nbr_entry_t* nbr;               //接收帧的链路端点
+	sip_pkt_t pkts[DELAY_SLOTS];    //环形延迟队列
+	double due[DELAY_SLOTS];        //每个帧的交付时间
+	unsigned long head, tail;       //出队和入队计数
+	double lastDue;                 //上一个入队帧的交付时间, 帧按序交付
+	unsigned long lost;             //丢失的帧数
+	unsigned int seed;              //丢包的随机数种子
+	int closed;                     //为1时读线程已结束
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+} delayline_t;
+
+//发往接收方和发往发送方的两个方向
+delayline_t toAck, toData;
+
+
+static double now_sec()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+// 接收链路上的一批报文, 返回报文数
+static int recvbatch(nbr_entry_t* nbr, sip_pkt_t* pkts)
+{
+	if (nbr->udp)
+		return recvpkts_dgram(pkts, SON_UDP_BATCH, nbr->conn);
+	return recvpkt(&pkts[0], nbr->conn) > 0 ? 1 : -1;
+}
+
+// 读线程: 接收链路上的帧, 按丢包率丢失, 加上时延后放入延迟队列
+static void* impair(void* arg)
+{
+	delayline_t* dl = (delayline_t*)arg;
+	sip_pkt_t pkts[SON_UDP_BATCH];
+	int n;
+	while ((n = recvbatch(dl->nbr, pkts)) >= 0) {
+		double now = now_sec();
+		pthread_mutex_lock(&dl->mutex);
+		for (int i = 0; i < n; i++) {
+			double due = now + delay;
+			if (rand_r(&dl->seed) < lossRate * ((double)RAND_MAX + 1)) {
+				dl->lost++;
+				// UDP链路上丢失的帧由GBN重传, TCP链路上由TCP重传, 在此之前后面的帧都不能交付
+				if (dl->nbr->udp)
+					continue;
+				due += tcpRecover;
+			}
+			if (due < dl->lastDue)
+				due = dl->lastDue;
+			dl->lastDue = due;
+			while (dl->tail - dl->head == DELAY_SLOTS)
+				pthread_cond_wait(&dl->cond, &dl->mutex);
+			dl->pkts[dl->tail % DELAY_SLOTS] = pkts[i];
+			dl->due[dl->tail % DELAY_SLOTS] = due;
+			dl->tail++;
+		}
+		pthread_cond_broadcast(&dl->cond);
+		pthread_mutex_unlock(&dl->mutex);
+	}
+	pthread_mutex_lock(&dl->mutex);
+	dl->closed = 1;
+	pthread_cond_broadcast(&dl->cond);
+	pthread_mutex_unlock(&dl->mutex);
+	return NULL;
+}
+
+// 从延迟队列中取出一批已到期的帧, 返回帧数. 读线程已结束并且队列为空时返回-1
+static int linkrecv(delayline_t* dl, sip_pkt_t* pkts)
+{
+	pthread_mutex_lock(&dl->mutex);
+	while (dl->head == dl->tail || dl->due[dl->head % DELAY_SLOTS] > now_sec()) {
+		if (dl->head == dl->tail && dl->closed) {
+			pthread_mutex_unlock(&dl->mutex);
+			return -1;
+		}
+		if (dl->head == dl->tail) {
+			pthread_cond_wait(&dl->cond, &dl->mutex);
+		} else {
+			double wait = dl->due[dl->head % DELAY_SLOTS] - now_sec();
+			pthread_mutex_unlock(&dl->mutex);
+			if (wait > 0)
+				usleep(wait * 1e6);
+			pthread_mutex_lock(&dl->mutex);
+		}
+	}
+	int n = 0;
+	while (n < SON_UDP_BATCH && dl->head != dl->tail && dl->due[dl->head % DELAY_SLOTS] <= now_sec()) {
+		pkts[n++] = dl->pkts[dl->head % DELAY_SLOTS];
+		dl->head++;
+	}
+	pthread_cond_broadcast(&dl->cond);
+	pthread_mutex_unlock(&dl->mutex);
+	return n;
+}
+
+// 为链路端点nbr的接收方向初始化延迟队列并启动读线程
+static void startline(delayline_t* dl, nbr_entry_t* nbr, unsigned int seed)
+{
+	dl->nbr = nbr;
+	dl->head = dl->tail = 0;
+	dl->lastDue = 0;
+	dl->lost = 0;
+	dl->seed = seed;
+	dl->closed = 0;
+	pthread_mutex_init(&dl->mutex, NULL);
+	pthread_cond_init(&dl->cond, NULL);
+	pthread_t impair_thread;
+	pthread_create(&impair_thread, NULL, impair, (void*)dl);
+}
+
+// 接收方: 按序接收数据报文, 每收到一个报文就发送累积确认
+static void* receiver(void* arg)
+{
+	sip_pkt_t pkts[SON_UDP_BATCH], reply;
+	int expect = 0, n;
+	memset(&reply, 0, sizeof(reply));
+	reply.header.type = SIP;
+	reply.header.length = sizeof(int);
+	while (expect < total && (n = linkrecv(&toAck, pkts)) >= 0) {
+		for (int i = 0; i < n; i++) {
+			int seq;
+			memcpy(&seq, pkts[i].data, sizeof(int));
+			if (seq == expect)
+				expect++;
+			memcpy(reply.data, &expect, sizeof(int));
+			egress_sendpkt(ack.egress, &reply);
+		}
+	}
+	egress_flush(ack.egress);
+	return NULL;
+}
+
+// 发送方的确认接收线程: 收到累积确认后移动窗口
+static void* acker(void* arg)
+{
+	sip_pkt_t pkts[SON_UDP_BATCH];
+	int n;
+	while ((n = linkrecv(&toData, pkts)) >= 0) {
+		pthread_mutex_lock(&bench_mutex);
+		for (int i = 0; i < n; i++) {
+			int acked;
+			memcpy(&acked, pkts[i].data, sizeof(int));
+			if (acked > base)
+				base = acked;
+		}
+		pthread_cond_signal(&bench_cond);
+		int done = base >= total;
+		pthread_mutex_unlock(&bench_mutex);
+		if (done)
+			break;
+	}
+	return NULL;
+}
+
+// 建立本机回环链路
+static int setuplink(int udp)
+{
+	data.udp = ack.udp = udp;
+	if (udp) {
+		in_addr_t lo = inet_addr("127.0.0.1");
+		data.conn = udp_conn_n(lo, BENCH_PORT, BENCH_PORT + 1);
+		ack.conn = udp_conn_n(lo, BENCH_PORT + 1, BENCH_PORT);
+		int rcvbuf = SON_UDP_RCVBUF;
+		setsockopt(data.conn, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+		setsockopt(ack.conn, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+	} else {
+		int listenfd = tcp_server_listen(BENCH_PORT);
+		if (listenfd < 0)
+			return -1;
+		data.conn = tcp_client_conn_a("127.0.0.1", BENCH_PORT);
+		ack.conn = accept(listenfd, NULL, NULL);
+		close(listenfd);
+	}
+	return data.conn > 0 && ack.conn > 0 ? 1 : -1;
+}
+
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2 || (strcmp(argv[1], "tcp") != 0 && strcmp(argv[1], "udp") != 0)) {
+		fprintf(stderr, "usage: %s tcp|udp [packets] [length] [timeout_ms] [loss] [delay_ms] [tcp_recover_ms]\n", argv[0]);
+		exit(1);
+	}
+	int udp = strcmp(argv[1], "udp") == 0;
+	total = argc > 2 ? atoi(argv[2]) : 10000;
+	pktLen = argc > 3 ? atoi(argv[3]) : MAX_SEG_LEN;
+	double timeout = (argc > 4 ? atoi(argv[4]) : 50) / 1000.0;
+	lossRate = argc > 5 ? atof(argv[5]) : PKT_LOSS_RATE;
+	delay = (argc > 6 ? atof(argv[6]) : 0) / 1000.0;
+	tcpRecover = argc > 7 ? atof(argv[7]) / 1000.0 : 2 * delay + 0.001;
+	if (pktLen < (int)sizeof(int) || pktLen > MAX_PKT_LEN) {
+		fprintf(stderr, "length must be in [%d, %d]\n", (int)sizeof(int), MAX_PKT_LEN);
+		exit(1);
+	}
+	if (lossRate < 0 || lossRate >= 1 || delay < 0 || tcpRecover < 0) {
+		fprintf(stderr, "loss must be in [0, 1), delay and recovery time must not be negative\n");
+		exit(1);
+	}
+
+	pthread_condattr_t attr;
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&bench_cond, &attr);
+
+	if (setuplink(udp) < 0) {
+		fprintf(stderr, "can't set up %s link\n", argv[1]);
+		exit(1);
+	}
+	linkcodec_init(&data.codec);
+	linkcodec_init(&ack.codec);
+	data.egress = egress_create(&data);
+	ack.egress = egress_create(&ack);
+	startline(&toAck, &ack, 1);
+	startline(&toData, &data, 2);
+
+	pthread_t recv_thread, ack_thread;
+	pthread_create(&recv_thread, NULL, receiver, NULL);
+	pthread_create(&ack_thread, NULL, acker, NULL);
+
+	// 回退N步发送
+	sip_pkt_t pkt;
+	memset(&pkt, 0, sizeof(pkt));
+	pkt.header.type = SIP;
+	pkt.header.length = pktLen;
+	double start = now_sec(), lastProgress = start;
+	int next = 0, lastBase = 0;
+	pthread_mutex_lock(&bench_mutex);
+	while (base < total) {
+		if (base != lastBase) {
+			lastBase = base;
+			lastProgress = now_sec();
+		}
+		if (next < base)
+			next = base;
+		if (now_sec() - lastProgress > timeout) {
+			// 超时, 从窗口起点重传
+			retransmits += next - base;
+			next = base;
+			lastProgress = now_sec();
+		}
+		if (next < base + GBN_WINDOW && next < total) {
+			int seq = next++;
+			pthread_mutex_unlock(&bench_mutex);
+			memcpy(pkt.data, &seq, sizeof(int));
+			egress_sendpkt(data.egress, &pkt);
+			pthread_mutex_lock(&bench_mutex);
+			continue;
+		}
+		egress_flush(data.egress);
+		struct timespec until;
+		clock_gettime(CLOCK_MONOTONIC, &until);
+		until.tv_nsec += 1000000;
+		until.tv_sec += until.tv_nsec / 1000000000L;
+		until.tv_nsec %= 1000000000L;
+		pthread_cond_timedwait(&bench_cond, &bench_mutex, &until);
+	}
+	pthread_mutex_unlock(&bench_mutex);
+	double elapsed = now_sec() - start;
+
+	fprintf(stderr, "LINK[%s] LOSS: %.3f | DELAY: %.1fms | PACKETS: %d | LENGTH: %d | TIME: %.3fs | GOODPUT: %.2f Mbit/s | LOST: %lu | RETRANSMITS: %lu | DATA FRAMES/WRITE: %.2f | ACK FRAMES/WRITE: %.2f\n",
+		argv[1], lossRate, delay * 1000, total, pktLen, elapsed, total * (double)pktLen * 8 / elapsed / 1e6, 
+		toAck.lost + toData.lost, retransmits,
+		data.egress->writes ? (double)data.egress->frames / data.egress->writes : 0.0,
+		ack.egress->writes ? (double)ack.egress->frames / ack.egress->writes : 0.0);
+	return 0;
+}
@@ -0,0 +1,17 @@
+#!/bin/sh
+# 比较TCP和UDP邻居链路在丢包和时延下的有效吞吐量.
+# 链路损伤由linkbench在进程内模拟, 不需要root权限.
+# 用法: ./son/linkbench.sh [丢包率, 默认为PKT_LOSS_RATE] [单向时延毫秒数] [报文数] [GBN超时毫秒数]
+cd "$(dirname "$0")/.." || exit 1
+LOSS=${1:-$(sed -n 's/^#define PKT_LOSS_RATE //p' common/constants.h)}
+DELAY=${2:-5}
+PACKETS=${3:-5000}
+TIMEOUT=${4:-50}
+LENGTH=$(sed -n 's/^#define MAX_SEG_LEN *//p' common/constants.h)
+
+make son/linkbench >/dev/null || exit 1
+
+echo "IMPAIRMENT: LOSS $LOSS | DELAY ${DELAY}ms"
+for mode in tcp udp; do
+	./son/linkbench $mode "$PACKETS" "$LENGTH" "$TIMEOUT" "$LOSS" "$DELAY" > /dev/null
+done
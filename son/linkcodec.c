@@ -0,0 +1,146 @@
+/**
+ * @file    son/linkcodec.c
+ * @brief   这个文件实现邻居链路压缩的协商, 压缩/解压缩函数和统计信息
+ * @date    2023-03-04
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include "../common/constants.h"
+#include "../common/lz4.h"
+#include "linkcodec.h"
+
+//协商消息的开始标志
+static const char* HELLO_FLAG = "!H";
+
+
+// 当前线程已使用的CPU时间, 单位为纳秒
+static unsigned long threadtime()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+
+// 接收一条3字节的协商消息, 最多等待SON_HELLO_TIMEOUT秒
+static int recvhello(int conn, char* hello)
+{
+	struct timeval tv = {.tv_sec = SON_HELLO_TIMEOUT};
+	setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	int n = recv(conn, hello, 3, MSG_WAITALL);
+	tv.tv_sec = 0;
+	setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	if (n != 3 || memcmp(hello, HELLO_FLAG, 2) != 0)
+		return -1;
+	return 1;
+}
+
+
+void linkcodec_init(linkcodec_t* codec)
+{
+	codec->codec = LINK_CODEC_NONE;
+	atomic_init(&codec->zipPkts, 0);
+	atomic_init(&codec->rawBytes, 0);
+	atomic_init(&codec->zipBytes, 0);
+	atomic_init(&codec->skipPkts, 0);
+	atomic_init(&codec->zipNsec, 0);
+	atomic_init(&codec->unzipPkts, 0);
+	atomic_init(&codec->unzipNsec, 0);
+}
+
+
+int linkcodec_offer(int conn, linkcodec_t* codec)
+{
+	char hello[3] = {'!', 'H', SON_COMPRESS ? LINK_CODEC_LZ4 : LINK_CODEC_NONE};
+	if (send(conn, hello, 3, 0) != 3) {
+		printf("NEXT_CONN[%d] ERROR: [SON] CAN'T [SEND] [HELLO]\n", conn);
+		return -1;
+	}
+	if (recvhello(conn, hello) < 0 || (hello[2] != LINK_CODEC_NONE && hello[2] != LINK_CODEC_LZ4)) {
+		printf("NEXT_CONN[%d] ERROR: [SON] CAN'T [RECV] [HELLO]\n", conn);
+		return -1;
+	}
+	codec->codec = hello[2];
+	return 1;
+}
+
+
+int linkcodec_accept(int conn, linkcodec_t* codec)
+{
+	char hello[3];
+	if (recvhello(conn, hello) < 0) {
+		printf("NEXT_CONN[%d] ERROR: [SON] CAN'T [RECV] [HELLO]\n", conn);
+		return -1;
+	}
+	// 只有双方都启用了压缩才使用压缩
+	hello[2] = SON_COMPRESS && hello[2] == LINK_CODEC_LZ4 ? LINK_CODEC_LZ4 : LINK_CODEC_NONE;
+	if (send(conn, hello, 3, 0) != 3) {
+		printf("NEXT_CONN[%d] ERROR: [SON] CAN'T [SEND] [HELLO]\n", conn);
+		return -1;
+	}
+	codec->codec = hello[2];
+	return 1;
+}
+
+
+int linkcodec_compress(linkcodec_t* codec, sip_pkt_t* pkt, sip_pkt_t* out)
+{
+	if (codec->codec != LINK_CODEC_LZ4 || pkt->header.length < SON_COMPRESS_THRESHOLD)
+		return 0;
+
+	// 压缩后的数据: 2字节原始长度, 然后是LZ4块
+	unsigned long start = threadtime();
+	unsigned short rawLen = pkt->header.length;
+	int zipLen = lz4_compress(pkt->data, rawLen, out->data + 2, rawLen - 3);
+	atomic_fetch_add(&codec->zipNsec, threadtime() - start);
+	if (zipLen <= 0) {
+		atomic_fetch_add(&codec->skipPkts, 1);
+		return 0;
+	}
+	memcpy(out->data, &rawLen, 2);
+	out->header = pkt->header;
+	out->header.type |= PKT_COMPRESSED;
+	out->header.length = zipLen + 2;
+	atomic_fetch_add(&codec->zipPkts, 1);
+	atomic_fetch_add(&codec->rawBytes, rawLen);
+	atomic_fetch_add(&codec->zipBytes, out->header.length);
+	return 1;
+}
+
+
+int linkcodec_decompress(linkcodec_t* codec, sip_pkt_t* pkt)
+{
+	if (!(pkt->header.type & PKT_COMPRESSED))
+		return 1;
+	if (pkt->header.length < 2)
+		return -1;
+
+	unsigned long start = threadtime();
+	char zip[MAX_PKT_LEN];
+	unsigned short rawLen;
+	memcpy(&rawLen, pkt->data, 2);
+	memcpy(zip, pkt->data + 2, pkt->header.length - 2);
+	int n = lz4_decompress(zip, pkt->header.length - 2, pkt->data, MAX_PKT_LEN);
+	atomic_fetch_add(&codec->unzipNsec, threadtime() - start);
+	if (n != rawLen)
+		return -1;
+	pkt->header.type &= ~PKT_COMPRESSED;
+	pkt->header.length = rawLen;
+	atomic_fetch_add(&codec->unzipPkts, 1);
+	return 1;
+}
+
+
+void linkcodec_print(linkcodec_t* codec, int nodeID)
+{
+	unsigned long rawBytes = atomic_load(&codec->rawBytes);
+	printf("SON: NEIGHBOR[%d] CODEC[%s] [ZIPPED: %lu | SKIPPED: %lu | RATIO: %.3f | ZIP CPU: %.6fs | UNZIPPED: %lu | UNZIP CPU: %.6fs]\n",
+		nodeID, codec->codec == LINK_CODEC_LZ4 ? "LZ4" : "NONE",
+		atomic_load(&codec->zipPkts), atomic_load(&codec->skipPkts),
+		rawBytes ? (double)atomic_load(&codec->zipBytes) / rawBytes : 1.0,
+		1e-9 * atomic_load(&codec->zipNsec), atomic_load(&codec->unzipPkts), 1e-9 * atomic_load(&codec->unzipNsec));
+}
\ No newline at end of file
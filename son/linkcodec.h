@@ -0,0 +1,99 @@
+/**
+ * @file    son/linkcodec.h
+ * @brief   这个文件定义邻居链路压缩的协商, 压缩/解压缩函数和统计信息
+ * @date    2023-03-04
+ */
+
+
+#ifndef LINKCODEC_H
+#define LINKCODEC_H
+
+#include <stdatomic.h>
+#include "../common/pkt.h"
+
+//链路压缩算法
+#define LINK_CODEC_NONE 0
+#define LINK_CODEC_LZ4 1
+
+//每条邻居链路的压缩状态. 压缩在发送报文的线程中进行, 解压缩在接收报文的线程中进行.
+//接收线程可能从io_uring线程退回到listen_to_neighbor线程, 链路重新建立时也会换一个线程,
+//统计信息还由son_stop()读取, 所以都是原子变量.
+typedef struct linkcodec {
+	int codec;                  //连接建立时协商得到的压缩算法
+	atomic_ulong zipPkts;       //压缩后发送的报文数
+	atomic_ulong rawBytes;      //这些报文压缩前的数据字节数
+	atomic_ulong zipBytes;      //这些报文压缩后的数据字节数
+	atomic_ulong skipPkts;      //达到压缩阈值但压缩后没有变小, 按原样发送的报文数
+	atomic_ulong zipNsec;       //压缩所用的CPU时间, 单位为纳秒
+	atomic_ulong unzipPkts;     //接收并解压缩的报文数
+	atomic_ulong unzipNsec;     //解压缩所用的CPU时间, 单位为纳秒
+} linkcodec_t;
+
+
+/**
+ * @brief   这个函数初始化链路压缩状态, 压缩算法为LINK_CODEC_NONE, 统计信息清零.
+ * 
+ * @param codec 
+ */
+void linkcodec_init(linkcodec_t* codec);
+
+
+/**
+ * @brief   这个函数由主动连接邻居的一方在TCP连接建立后调用.
+ *          它发送'!H'和本节点提议的压缩算法, 然后等待邻居回复'!H'和选定的压缩算法.
+ *          协商成功返回1, 否则返回-1.
+ * 
+ * @param conn 
+ * @param codec 
+ * @return int 
+ */
+int linkcodec_offer(int conn, linkcodec_t* codec);
+
+
+/**
+ * @brief   这个函数由接受邻居连接的一方在accept()之后调用.
+ *          它接收邻居提议的压缩算法, 只有双方都启用了压缩时才选用LINK_CODEC_LZ4, 并回复选定的算法.
+ *          协商成功返回1, 否则返回-1.
+ * 
+ * @param conn 
+ * @param codec 
+ * @return int 
+ */
+int linkcodec_accept(int conn, linkcodec_t* codec);
+
+
+/**
+ * @brief   这个函数在报文发送到邻居之前调用.
+ *          如果链路启用了压缩, 并且报文数据长度不小于SON_COMPRESS_THRESHOLD, 就将压缩后的报文写入out,
+ *          设置报文类型中的PKT_COMPRESSED标志, 返回1. 
+ *          如果没有压缩(未启用, 太短或压缩后没有变小), 返回0, 此时应发送原报文.
+ * 
+ * @param codec 
+ * @param pkt 
+ * @param out 
+ * @return int 
+ */
+int linkcodec_compress(linkcodec_t* codec, sip_pkt_t* pkt, sip_pkt_t* out);
+
+
+/**
+ * @brief   这个函数在接收到来自邻居的报文之后调用. 
+ *          如果报文设置了PKT_COMPRESSED标志, 就原地解压缩并清除该标志.
+ *          成功返回1, 如果压缩数据损坏, 返回-1.
+ * 
+ * @param codec 
+ * @param pkt 
+ * @return int 
+ */
+int linkcodec_decompress(linkcodec_t* codec, sip_pkt_t* pkt);
+
+
+/**
+ * @brief   这个函数打印链路的压缩比和压缩/解压缩所用的CPU时间.
+ * 
+ * @param codec 
+ * @param nodeID 
+ */
+void linkcodec_print(linkcodec_t* codec, int nodeID);
+
+#endif
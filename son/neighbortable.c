@@ -6,6 +6,7 @@
 
 
 #include "neighbortable.h"
+#include "egress.h"
 #include "../topology/topology.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -13,30 +14,45 @@
 #include <unistd.h>
 
 
-//这个函数首先动态创建一个邻居表. 然后解析文件topology/topology.dat, 填充所有条目中的nodeID和nodeIP字段, 将conn字段初始化为-1.
-//返回创建的邻居表.
+//这个函数首先动态创建一个邻居表. 然后解析文件topology/topology.dat, 填充所有条目中的nodeID和nodeIP字段, 将conn字段初始化为-1,
+//并为每个邻居创建出口合并缓冲区.
+//返回创建的邻居表. 有邻居的地址不能解析时返回NULL.
 nbr_entry_t* nt_create()
 {    
     int nbrNum = topology_getNbrNum();
     if (nbrNum <= 0)
         return NULL;
+    in_addr_t* nbrIP = topology_getNbrIPArray();
+    if (nbrIP == NULL)
+        return NULL;
     nbr_entry_t* nt = (nbr_entry_t*)malloc(sizeof(nbr_entry_t) * nbrNum);
     int* nbrID = topology_getNbrArray();
-    in_addr_t* nbrIP = topology_getNbrIPArray();
     for (int i = 0; i < nbrNum; i++) {
         nt[i].nodeID = nbrID[i];
         nt[i].nodeIP = nbrIP[i];
         nt[i].conn = -1;
+        nt[i].udp = 0;
+        nt[i].creditDebt = 0;
+        atomic_init(&nt[i].heard, 0);
+        atomic_init(&nt[i].dead, 0);
+        linkcodec_init(&nt[i].codec);
+        nt[i].egress = egress_create(&nt[i]);
     }
+    free(nbrID);
+    free(nbrIP);
     return nt;
 }
 
-//这个函数删除一个邻居表. 它关闭所有连接, 释放所有动态分配的内存.
+//这个函数删除一个邻居表. 它发送出口合并缓冲区中剩余的帧, 关闭所有连接, 释放所有动态分配的内存.
 void nt_destroy(nbr_entry_t* nt)
 {
     int nbrNum = topology_getNbrNum();
-    for (int i = 0; i < nbrNum; i++)
+    for (int i = 0; i < nbrNum; i++) {
+        egress_print(nt[i].egress);
+        linkcodec_print(&nt[i].codec, nt[i].nodeID);
+        egress_destroy(nt[i].egress);
         close(nt[i].conn);
+    }
     if (nt)
         free(nt);
 }
@@ -8,6 +8,8 @@
 #ifndef NEIGHBORTABLE_H 
 #define NEIGHBORTABLE_H
 #include <arpa/inet.h>
+#include <stdatomic.h>
+#include "linkcodec.h"
 
 //邻居表条目定义
 //一张邻居表包含n个条目, 其中n是邻居的数量
@@ -16,7 +18,13 @@
 typedef struct neighborentry {
   int nodeID;	        //邻居的节点ID
   in_addr_t nodeIP;     //邻居的IP地址
-  int conn;	            //针对这个邻居的TCP连接套接字描述符
+  int conn;	            //针对这个邻居的TCP连接套接字描述符, UDP链路时是连接到这个邻居的UDP套接字
+  int udp;              //为1时到这个邻居的链路使用UDP
+  struct nbregress* egress;  //针对这个邻居的出口合并缓冲区
+  linkcodec_t codec;    //针对这个邻居的链路压缩状态
+  int creditDebt;       //SIP进程重新连接时仍在出口合并缓冲区中的帧数, 以及HELLO报文数, 这些帧写出后不再返还信用
+  atomic_long heard;    //最近一次收到这个邻居的帧的时刻(毫秒), 为0时还没有开始计时
+  atomic_int dead;      //为1时这个邻居在SON_DEAD_INTERVAL毫秒内没有发来任何帧, 链路已经被关闭
 } nbr_entry_t;
 
 
@@ -24,7 +32,8 @@ typedef struct neighborentry {
  * @brief   这个函数首先动态创建一个邻居表. 
  *          然后解析文件topology/topology.dat, 
  *          填充所有条目中的nodeID和nodeIP字段, 
- *          将conn字段初始化为-1, 返回创建的邻居表.
+ *          将conn字段初始化为-1, 为每个邻居创建出口合并缓冲区, 返回创建的邻居表.
+ *          没有邻居, 或者有邻居的地址不能解析时返回NULL.
  * 
  * @return nbr_entry_t* 
  */
@@ -32,7 +41,7 @@ nbr_entry_t* nt_create();
 
 
 /**
- * @brief   这个函数删除一个邻居表. 它关闭所有连接, 
+ * @brief   这个函数删除一个邻居表. 它发送出口合并缓冲区中剩余的帧, 关闭所有连接, 
  *          释放所有动态分配的内存.
  * 
  * @param nt 
@@ -18,13 +18,18 @@
 #include <signal.h>
 #include <sys/utsname.h>
 #include <assert.h>
+#include <errno.h>
+#include <time.h>
 
 #include "../common/constants.h"
 #include "../common/pkt.h"
 #include "../common/tcp.h"
+#include "../common/uring.h"
+#include "../common/pktqueue.h"
 #include "son.h"
 #include "../topology/topology.h"
 #include "neighbortable.h"
+#include "egress.h"
 
 // 在这个时间段内启动所有重叠网络节点上的SON进程
 #define SON_START_DELAY 60
@@ -36,15 +41,149 @@ nbr_entry_t* nt;
 // 将与SIP进程之间的TCP连接声明为一个全局变量
 int sip_conn; 
 int listenfd;
-// 全局变量访问锁
+// 发往SIP进程的报文帧队列, 它的写线程是唯一写sip_conn的线程
+pktqueue_t* sipq;
+// 全局变量访问锁, 保护邻居表中的creditDebt
 pthread_mutex_t son_mutex;
+// 为1时邻居链路使用UDP
+int linkUDP = SON_LINK_UDP;
+// 为1时用io_uring接收邻居链路上的报文
+int useUring = IO_URING;
+// 接收所有邻居链路的io_uring, 为NULL时每个邻居使用一个listen_to_neighbor线程
+uring_t* ring;
+// 每个邻居链路的报文帧流
+pktstream_t* streams;
+// 为1时sip_conn上的报文也由io_uring线程接收, waitSIP()只等待新的SIP进程连接
+int sipUring;
+// sip_conn的报文帧流, 只在io_uring线程中使用
+pktstream_t sipStream;
+
+// sip_conn上的接收请求的user_data是这个标志加上连接的套接字描述符, 邻居链路上的是邻居的下标
+#define URING_SIP_TAG (1ULL << 32)
+// 要求io_uring线程在邻居链路上提交接收请求的空请求的user_data是这个标志加上邻居的下标
+#define URING_ARM_TAG (1ULL << 33)
 
 /* 实现重叠网络函数 */
 
+// 返回单调时钟的当前时刻(毫秒)
+static long monotonicms()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+// 通过信用报文把发往邻居nodeID的credits个信用返还给SIP进程. 调用者应持有son_mutex.
+static void sendcredit(int nodeID, int credits)
+{
+	sip_pkt_t pkt;
+	pkt_credit_t credit = {.nodeID = nodeID, .credits = credits};
+	pkt.header.src_nodeID = topology_getMyNodeID();
+	pkt.header.dest_nodeID = pkt.header.src_nodeID;
+	pkt.header.type = CREDIT;
+	pkt.header.ttl = 1;
+	pkt.header.length = sizeof(pkt_credit_t);
+	memcpy(pkt.data, &credit, sizeof(pkt_credit_t));
+	if (sip_conn > 0 && pktqueue_sendpkt(sipq, &pkt) < 0)
+		sip_conn = -1;
+}
+
+// 出口合并缓冲区写出(或丢弃)了frames个发往邻居nbr的帧, 把同样数量的信用返还给SIP进程
+void son_returncredit(nbr_entry_t* nbr, int frames)
+{
+	pthread_mutex_lock(&son_mutex);
+	// 先抵扣SIP进程重新连接之前入队的帧
+	int debt = frames < nbr->creditDebt ? frames : nbr->creditDebt;
+	nbr->creditDebt -= debt;
+	frames -= debt;
+	if (frames > 0)
+		sendcredit(nbr->nodeID, frames);
+	pthread_mutex_unlock(&son_mutex);
+}
+
+// 到邻居idx的链路断开了, 通过链路断开报文通知SIP进程, 它立即把经过这个邻居的路由切换到备份下一跳
+static void nbrdown(int idx)
+{
+	sip_pkt_t pkt;
+	pkt_linkdown_t down = {.nodeID = nt[idx].nodeID};
+	nt[idx].conn = -1;
+	pkt.header.src_nodeID = topology_getMyNodeID();
+	pkt.header.dest_nodeID = pkt.header.src_nodeID;
+	pkt.header.type = LINK_DOWN;
+	pkt.header.ttl = 1;
+	pkt.header.length = sizeof(pkt_linkdown_t);
+	memcpy(pkt.data, &down, sizeof(pkt_linkdown_t));
+	if (sip_conn > 0 && pktqueue_sendpkt(sipq, &pkt) < 0)
+		sip_conn = -1;
+}
+
+// 解压缩从邻居idx收到的报文并放入发往SIP进程的队列. HELLO报文只用来说明邻居还活着, 不交给SIP进程
+static void nbrforward(int idx, sip_pkt_t* pkt)
+{
+	atomic_store(&nt[idx].heard, monotonicms());
+	if (pkt->header.type == HELLO)
+		return;
+	if (linkcodec_decompress(&nt[idx].codec, pkt) < 0) {
+		printf("SON: NEIGHBOR[%d] SENT A CORRUPTED COMPRESSED PACKET\n", nt[idx].nodeID);
+		return;
+	}
+	if (sip_conn > 0 && pktqueue_sendpkt(sipq, pkt) < 0)
+		sip_conn = -1;
+}
+
+// 为邻居idx启动listen_to_neighbor线程
+static void nbrlisten_thread(int idx)
+{
+	int* arg = (int*)malloc(sizeof(int));
+	*arg = idx;
+	pthread_t nbr_listen_thread;
+	pthread_create(&nbr_listen_thread, NULL, listen_to_neighbor, (void*)arg);
+}
+
+// 开始接收邻居idx的报文: 使用io_uring时在其连接上提交多发接收请求, 否则启动listen_to_neighbor线程
+static void nbrlisten(int idx)
+{
+	// UDP链路在第一次收到邻居的帧后才开始计时
+	atomic_store(&nt[idx].heard, nt[idx].udp ? 0 : monotonicms());
+	if (ring) {
+		pktstream_init(&streams[idx], nt[idx].conn, "NEXT_CONN");
+		if (uring_recv_multishot(ring, nt[idx].conn, idx) > 0)
+			return;
+		printf("SON: CAN'T SUBMIT IO_URING RECV FOR NEIGHBOR[%d], USE A THREAD\n", nt[idx].nodeID);
+	}
+	nbrlisten_thread(idx);
+}
+
+// 这个线程与接受的邻居协商链路压缩算法, 成功后开始接收这个邻居的报文.
+// 每个进入连接使用一个线程, 一个沉默的邻居最多让自己的连接等待SON_HELLO_TIMEOUT秒, 不会阻塞其他邻居的连接
+static void* nbraccept(void* arg)
+{
+	int idx = ((int*)arg)[0], connfd = ((int*)arg)[1];
+	free(arg);
+	if (linkcodec_accept(connfd, &nt[idx].codec) < 0) {
+		close(connfd);
+		pthread_exit(NULL);
+	}
+	nt[idx].conn = connfd;
+	// 内核在这个线程退出时会取消它提交的接收请求, 所以由io_uring线程在这个连接上提交接收请求
+	if (!ring) {
+		nbrlisten(idx);
+	} else if (uring_nop(ring, URING_ARM_TAG | idx) < 0) {
+		atomic_store(&nt[idx].heard, monotonicms());
+		nbrlisten_thread(idx);
+	}
+	printf("SON: NODE[%d] IS ACCEPTED NEIGHBOR[%d] [CODEC: %d]\n", topology_getMyNodeID(), nt[idx].nodeID, nt[idx].codec.codec);
+	// 打印邻居表
+	for(int i = 0; i < topology_getNbrNum(); i++) {
+		printf("OVERLAY NETWORK: NEIGHBOR[%d] | NODEID[%d] | NODEIP[%8d] | CONN[%d]\n", 
+			i + 1, nt[i].nodeID, nt[i].nodeIP, nt[i].conn);
+	}
+	pthread_exit(NULL);
+}
+
 // 这个线程打开TCP端口CONNECTION_PORT, 等待节点ID比自己大的所有邻居的进入连接
 void* waitNbrs(void* arg) 
 {
-	int myNodeID = topology_getMyNodeID();
 	int nbrNum = topology_getNbrNum();
 	listenfd = tcp_server_listen(CONNECTION_PORT);
 	if (listenfd == -1) {
@@ -64,22 +203,20 @@ void* waitNbrs(void* arg)
 			if ((connfd = accept(listenfd, (struct sockaddr *) &client_addr, &client_len)) < 0) {
 				printf("SON: SERVER ACCEPT FAILED\n");
 			} else {
-				// 成功连接请求，则建立监听线程
-				for (int i = 0; i < nbrNum; i++) {
+				// 成功连接请求，则在一个新线程中协商链路压缩算法并建立监听
+				int known = 0;
+				for (int i = 0; i < nbrNum && !known; i++) {
 					if (nt[i].nodeIP == client_addr.sin_addr.s_addr) {
-						nt[i].conn = connfd;
-						int* idx = (int*)malloc(sizeof(int));
-						*idx = i;
-						pthread_t nbr_listen_thread;
-						pthread_create(&nbr_listen_thread, NULL, listen_to_neighbor, (void*)idx);
-						printf("SON: NODE[%d] IS ACCEPTED NEIGHBOR[%d]\n", myNodeID, nt[i].nodeID);
+						int* arg = (int*)malloc(sizeof(int) * 2);
+						arg[0] = i;
+						arg[1] = connfd;
+						pthread_t accept_thread;
+						pthread_create(&accept_thread, NULL, nbraccept, (void*)arg);
+						known = 1;
 					}
 				}
-				// 打印邻居表
-				for(int i = 0; i < nbrNum; i++) {
-					printf("OVERLAY NETWORK: NEIGHBOR[%d] | NODEID[%d] | NODEIP[%8d] | CONN[%d]\n", 
-						i + 1, nt[i].nodeID, nt[i].nodeIP, nt[i].conn);
-				}		
+				if (!known)
+					close(connfd);
 			}
 		}
 	}
@@ -96,13 +233,15 @@ int connectNbrs()
 			printf("SON: NODE[%d] PREPARE TO CONNECT NODE[%d]...\n", myNodeID, nt[i].nodeID);
 			if ((nt[i].conn = tcp_client_conn_n(nt[i].nodeIP, CONNECTION_PORT)) < 0) {
 				return -1;
+			} else if (linkcodec_offer(nt[i].conn, &nt[i].codec) < 0) {
+				// 协商链路压缩算法失败
+				close(nt[i].conn);
+				nt[i].conn = -1;
+				return -1;
 			} else {
-				// 请求成功，建立监听线程
-				int* idx = (int*)malloc(sizeof(int));
-				*idx = i;
-				pthread_t nbr_listen_thread;
-				pthread_create(&nbr_listen_thread, NULL, listen_to_neighbor, (void*)idx);
-				printf("SON: NODE[%d] CONNECT TO NEIGHBOR[%d]\n", myNodeID, nt[i].nodeID);
+				// 请求成功，开始接收邻居的报文
+				nbrlisten(i);
+				printf("SON: NODE[%d] CONNECT TO NEIGHBOR[%d] [CODEC: %d]\n", myNodeID, nt[i].nodeID, nt[i].codec.codec);
 			}
 		}
 	}
@@ -110,26 +249,241 @@ int connectNbrs()
 	return 1;
 }
 
+// 这个函数为每个邻居创建一个绑定到CONNECTION_PORT并连接到该邻居IP地址的UDP套接字,
+// 内核按源地址把数据报分发到对应邻居的套接字. 然后为每个邻居启动listen_to_neighbor线程.
+int connectNbrs_udp()
+{
+	int myNodeID = topology_getMyNodeID();
+	int nbrNum = topology_getNbrNum();
+	int rcvbuf = SON_UDP_RCVBUF;
+	for (int i = 0; i < nbrNum; i++) {
+		if ((nt[i].conn = udp_conn_n(nt[i].nodeIP, CONNECTION_PORT, CONNECTION_PORT)) < 0)
+			return -1;
+		setsockopt(nt[i].conn, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+		nt[i].udp = 1;
+		// 每个节点都能解压缩, UDP链路直接使用本节点的压缩设置
+		nt[i].codec.codec = SON_COMPRESS ? LINK_CODEC_LZ4 : LINK_CODEC_NONE;
+		nbrlisten(i);
+		printf("SON: NODE[%d] LINK TO NEIGHBOR[%d] OVER UDP\n", myNodeID, nt[i].nodeID);
+	}
+	printf("SON: CONNECT NBRS IS OVER..\n");
+	return 1;
+}
+
+// 返回一个空闲的splice管道, 写出失败的管道中有残留数据, 重建后再使用. 没有空闲的管道时返回NULL
+static splicepipe_t* freepipe(splicepipe_t* pipes)
+{
+	for (int i = 0; i < SON_SPLICE_PIPES; i++) {
+		if (atomic_load(&pipes[i].busy) == -1) {
+			close(pipes[i].fd[0]);
+			close(pipes[i].fd[1]);
+			if (pipe(pipes[i].fd) < 0)
+				pipes[i].fd[0] = pipes[i].fd[1] = -1;
+			atomic_store(&pipes[i].busy, 0);
+		}
+		if (pipes[i].fd[0] >= 0 && atomic_load(&pipes[i].busy) == 0)
+			return &pipes[i];
+	}
+	return NULL;
+}
+
+// UDP链路的listen_to_neighbor: 用recvmmsg()批量接收数据报, 将其中的报文转发给SIP进程.
+static void listen_to_neighbor_udp(int idx)
+{
+	sip_pkt_t pkts[SON_UDP_BATCH];
+	int n;
+	// keepalive线程关闭失效邻居的链路后, recvmmsg()不再等待, 由dead标志结束循环
+	while (!atomic_load(&nt[idx].dead) && (n = recvpkts_dgram(pkts, SON_UDP_BATCH, nt[idx].conn)) >= 0) {
+		for (int i = 0; i < n; i++)
+			nbrforward(idx, &pkts[i]);
+	}
+	printf("SON: NEIGHBOR[%d] UDP LINK IS BROKEN\n", nt[idx].nodeID);
+	nbrdown(idx);
+}
+
 //每个listen_to_neighbor线程持续接收来自一个邻居的报文. 它将接收到的报文转发给SIP进程.
 //所有的listen_to_neighbor线程都是在到邻居的TCP连接全部建立之后启动的. 
 void* listen_to_neighbor(void* arg) 
 {
 	int *idx = (int*)arg, n;
 	printf("SON: LISTENG THREAD TO NEIGHBOR[%d]\n", *idx);
+	if (nt[*idx].udp) {
+		listen_to_neighbor_udp(*idx);
+		pthread_exit(NULL);
+	}
+	// 较长的未压缩报文经过这些管道从邻居连接转发给SIP进程
+	splicepipe_t pipes[SON_SPLICE_PIPES];
+	for (int i = 0; i < SON_SPLICE_PIPES; i++) {
+		atomic_init(&pipes[i].busy, 0);
+		if (SON_SPLICE_MIN == 0 || pipe(pipes[i].fd) < 0)
+			pipes[i].fd[0] = pipes[i].fd[1] = -1;
+	}
 	sip_pkt_t pkt;
 	while (1) {
-		if ((n = recvpkt(&pkt, nt[*idx].conn)) > 0) {
-			if (forwardpktToSIP(&pkt, sip_conn) < 0)
-				sip_conn = -1;
-		} else if (n < 0) {
+		if ((n = recvpkthdr(&pkt, nt[*idx].conn)) > 0) {
+			atomic_store(&nt[*idx].heard, monotonicms());
+			splicepipe_t* sp = NULL;
+			if (!(pkt.header.type & PKT_COMPRESSED) && pkt.header.length >= SON_SPLICE_MIN)
+				sp = freepipe(pipes);
+			if (sp) {
+				if (splicepkt(&pkt, nt[*idx].conn, sp->fd) < 0) {
+					n = -1;
+				} else {
+					// 管道交给SIP连接的写线程, 它写出数据后释放管道
+					// 队列已满而丢弃报文时管道中还有数据, 与连接断开时一样置为-1, 由freepipe()重建
+					atomic_store(&sp->busy, 1);
+					int r = sip_conn > 0 ? pktqueue_splice(sipq, &pkt, sp) : -1;
+					if (r <= 0) {
+						if (r < 0)
+							sip_conn = -1;
+						atomic_store(&sp->busy, -1);
+					}
+					continue;
+				}
+			} else if ((n = recvpktdata(&pkt, nt[*idx].conn)) > 0) {
+				nbrforward(*idx, &pkt);
+				continue;
+			}
+		}
+		// 连接被对端关闭(或被keepalive线程关闭)时recvpkthdr()返回0, 与出错一样处理
+		if (n <= 0) {
 			printf("n:%d\n", n);
 			printf("SON: NEIGHBOR[%d] IS DISCONNECTED\n", *idx + 1);
-			nt[*idx].conn = -1;
+			nbrdown(*idx);
+			// 等待写线程取走管道中的数据后关闭管道
+			for (int i = 0; i < SON_SPLICE_PIPES; i++) {
+				while (atomic_load(&pipes[i].busy) == 1)
+					usleep(1000);
+				if (pipes[i].fd[0] >= 0) {
+					close(pipes[i].fd[0]);
+					close(pipes[i].fd[1]);
+				}
+			}
 			pthread_exit(NULL);
 		}
 	}
 }
 
+// 处理邻居idx上的一个接收完成事件
+static void nbrcomplete(uring_cqe_t* cqe)
+{
+	int idx = cqe->user_data;
+	char* data = uring_buf(ring, cqe);
+	sip_pkt_t pkt;
+	if (cqe->res > 0 && data) {
+		// UDP链路上每个数据报是一个完整的帧
+		if (nt[idx].udp)
+			pktstream_init(&streams[idx], nt[idx].conn, "NEXT_CONN");
+		for (int off = 0; off < cqe->res; ) {
+			off += pktstream_push(&streams[idx], data + off, cqe->res - off);
+			while (pktstream_next(&streams[idx], &pkt) > 0)
+				nbrforward(idx, &pkt);
+		}
+	}
+	uring_recycle(ring, cqe);
+	if (cqe->flags & IORING_CQE_F_MORE)
+		return;
+
+	// 多发接收请求已经结束
+	if (cqe->res == -EINVAL) {
+		// 内核不支持多发接收
+		printf("SON: IO_URING MULTISHOT RECV IS NOT SUPPORTED, USE A THREAD FOR NEIGHBOR[%d]\n", nt[idx].nodeID);
+		nbrlisten_thread(idx);
+	} else if (!atomic_load(&nt[idx].dead) && (cqe->res > 0 || cqe->res == -ENOBUFS || (nt[idx].udp && cqe->res != -EBADF))) {
+		// 缓冲池暂时用完了, 或者UDP链路上对端还没有启动, 重新提交
+		if (uring_recv_multishot(ring, nt[idx].conn, idx) < 0)
+			nbrlisten_thread(idx);
+	} else {
+		printf("SON: NEIGHBOR[%d] IS DISCONNECTED\n", nt[idx].nodeID);
+		nbrdown(idx);
+	}
+}
+
+// 把SIP进程交来的报文放入下一跳的出口合并缓冲区, 下一跳为BROADCAST_NODEID时发往所有邻居.
+// 每个发往邻居的帧都占用SIP进程的一个信用, 无法发送的帧立即返还信用.
+// 出口合并缓冲区能容纳SON_LINK_CREDITS个最大长度的帧, 所以SIP进程遵守信用时这个函数不会等待.
+static void sipforward(sip_pkt_t* pkt, int nextNode)
+{
+	int nbrNum = topology_getNbrNum();
+	if (pkt->header.dest_nodeID == BROADCAST_NODEID) {
+		printf("SON: BROADCAST\n");
+		// 广播的是路由更新报文, 不等待合并, 立即发送
+		for (int i = 0; i < nbrNum; i++) {
+			if (nt[i].conn > 0 && egress_sendpkt(nt[i].egress, pkt) > 0)
+				egress_flush(nt[i].egress);
+			else
+				son_returncredit(&nt[i], 1);
+		}
+	} else {
+		// 小帧在出口合并缓冲区中等待, 与其他帧合并为一次写操作
+		for (int i = 0; i < nbrNum; i++) {
+			if (nt[i].nodeID == nextNode) {
+				if (nt[i].conn <= 0 || egress_sendpkt(nt[i].egress, pkt) < 0)
+					son_returncredit(&nt[i], 1);
+				else if (pkt->header.type == ROUTE_UPDATE)
+					// 发给单个邻居的路由更新也不等待合并
+					egress_flush(nt[i].egress);
+			}
+		}
+	}
+}
+
+// 处理sip_conn上的一个接收完成事件, 把其中完整的报文帧发往下一跳
+static void sipcomplete(uring_cqe_t* cqe)
+{
+	int conn = (int)(cqe->user_data & 0xffffffff), nextNode;
+	char* data = uring_buf(ring, cqe);
+	sip_pkt_t pkt;
+	// 来自已经断开的旧连接的完成事件被忽略
+	if (conn == sip_conn && cqe->res > 0 && data) {
+		for (int off = 0; off < cqe->res; ) {
+			off += pktstream_push(&sipStream, data + off, cqe->res - off);
+			while (pktstream_nextsend(&sipStream, &pkt, &nextNode) > 0)
+				sipforward(&pkt, nextNode);
+		}
+	}
+	uring_recycle(ring, cqe);
+	if ((cqe->flags & IORING_CQE_F_MORE) || conn != sip_conn)
+		return;
+
+	// 多发接收请求已经结束
+	if (cqe->res == -EINVAL) {
+		printf("SON: IO_URING MULTISHOT RECV IS NOT SUPPORTED, RECEIVE FROM SIP PROCESS IN WAITSIP\n");
+		sipUring = 0;
+	} else if (cqe->res > 0 || cqe->res == -ENOBUFS) {
+		// 重新提交, 保留已经收到的部分报文帧
+		if (uring_recv_multishot(ring, conn, URING_SIP_TAG | conn) < 0)
+			sipUring = 0;
+	} else {
+		printf("SON: SIP PROCESS IS DISCONNECTED\n");
+		sip_conn = -1;
+		sipUring = 0;
+	}
+}
+
+// 这个线程代替所有listen_to_neighbor线程, 用io_uring接收所有邻居链路上的报文并转发给SIP进程,
+// 以及SIP进程交来的报文并发往下一跳. 每次系统调用收取一批完成事件.
+void* listen_to_neighbors_uring(void* arg)
+{
+	uring_cqe_t cqes[URING_BATCH];
+	int n;
+	printf("SON: LISTENING TO ALL NEIGHBORS WITH IO_URING\n");
+	while ((n = uring_wait(ring, cqes, URING_BATCH, 1000)) >= 0) {
+		for (int i = 0; i < n; i++) {
+			if (cqes[i].user_data == URING_CANCEL_DATA)
+				continue;
+			if (cqes[i].user_data & URING_SIP_TAG)
+				sipcomplete(&cqes[i]);
+			else if (cqes[i].user_data & URING_ARM_TAG)
+				nbrlisten((int)(cqes[i].user_data & 0xffffffff));
+			else
+				nbrcomplete(&cqes[i]);
+		}
+	}
+	printf("SON: IO_URING WAIT FAILED\n");
+	pthread_exit(NULL);
+}
+
 //这个函数打开TCP端口SON_PORT, 等待来自本地SIP进程的进入连接. 
 //在本地SIP进程连接之后, 这个函数持续接收来自SIP进程的sendpkt_arg_t结构, 并将报文发送到重叠网络中的下一跳. 
 //如果下一跳的节点ID为BROADCAST_NODEID, 报文应发送到所有邻居节点.
@@ -154,31 +508,39 @@ void waitSIP()
 			if (FD_ISSET(sip_listenfd, &readmask)) {
 				struct sockaddr_in client_addr;
 				socklen_t client_len = sizeof(client_addr);
-				if ((sip_conn = accept(sip_listenfd, (struct sockaddr *) &client_addr, &client_len)) < 0) {
+				int connfd;
+				if ((connfd = accept(sip_listenfd, (struct sockaddr *) &client_addr, &client_len)) < 0) {
 					printf("SON: SERVER ACCEPT FAILED\n");
 				} else {
 					printf("SON: SIP PROCESS IS ACCEPTED\n");
+					// 新连接的SIP进程对每个邻居都从SON_LINK_CREDITS个信用开始, 
+					// 仍在出口合并缓冲区中的帧写出后不再返还信用
+					pthread_mutex_lock(&son_mutex);
+					pktqueue_setconn(sipq, connfd);
+					sip_conn = connfd;
+					int nbrNum = topology_getNbrNum();
+					for (int i = 0; i < nbrNum; i++) {
+						nt[i].creditDebt = egress_inflight(nt[i].egress);
+						sendcredit(nt[i].nodeID, SON_LINK_CREDITS);
+					}
+					pthread_mutex_unlock(&son_mutex);
+					// 使用io_uring时SIP连接上的报文也由io_uring线程接收
+					if (ring) {
+						pktstream_init(&sipStream, connfd, "SIP_CONN");
+						sipUring = 1;
+						if (uring_recv_multishot(ring, connfd, URING_SIP_TAG | connfd) < 0)
+							sipUring = 0;
+					}
 				}
 			}
 		}
 		if (sip_conn <= 0) continue;
+		if (sipUring) {
+			select(0, NULL, NULL, NULL, &(struct timeval){.tv_usec = 1e5});
+			continue;
+		}
 		if ((n = getpktToSend(&pkt, &nextNode, sip_conn)) > 0) {
-			if (pkt.header.dest_nodeID == BROADCAST_NODEID) {
-				printf("SON: BROADCAST\n");
-				int nbrNum = topology_getNbrNum();
-				for (int i = 0; i < nbrNum; i++) {
-					if (nt[i].conn > 0)
-						if (sendpkt(&pkt, nt[i].conn) < 0)
-							nt[i].conn = -1;
-				}
-			} else {
-				int nbrNum = topology_getNbrNum();
-				for (int i = 0; i < nbrNum; i++) {
-					if (nt[i].nodeID == nextNode && nt[i].conn > 0)
-						if (sendpkt(&pkt, nt[i].conn) < 0)
-							nt[i].conn = -1;
-				}
-			}
+			sipforward(&pkt, nextNode);
 		} else if (n <= 0) {
 			printf("SON: SIP PROCESS IS DISCONNECTED\n");
 			sip_conn = -1;
@@ -187,19 +549,75 @@ void waitSIP()
 }
 
 
+void* keepalive(void* arg)
+{
+	sip_pkt_t hello;
+	memset(&hello.header, 0, sizeof(sip_hdr_t));
+	hello.header.src_nodeID = topology_getMyNodeID();
+	hello.header.type = HELLO;
+	hello.header.ttl = 1;
+	hello.header.length = 0;
+	int nbrNum = topology_getNbrNum();
+	while (1) {
+		usleep(SON_KEEPALIVE_INTERVAL * 1000);
+		long now = monotonicms();
+		for (int i = 0; i < nbrNum; i++) {
+			if (nt[i].conn <= 0 || atomic_load(&nt[i].dead))
+				continue;
+			long heard = atomic_load(&nt[i].heard);
+			if (heard > 0 && now - heard > SON_DEAD_INTERVAL) {
+				// 接收线程或io_uring线程发现链路断开后调用nbrdown()
+				printf("SON: NEIGHBOR[%d] IS SILENT FOR %ld MS, CLOSE THE LINK\n", nt[i].nodeID, now - heard);
+				atomic_store(&nt[i].dead, 1);
+				shutdown(nt[i].conn, SHUT_RDWR);
+				// UDP套接字上的io_uring接收请求不会因为shutdown()结束
+				if (ring && nt[i].udp)
+					uring_cancel(ring, i);
+				continue;
+			}
+			// 链路上有等待写出的帧时, 这些帧就能让邻居知道本节点还活着
+			if (egress_inflight(nt[i].egress) > 0)
+				continue;
+			// HELLO报文不占用SIP进程的信用, 写出后不返还信用
+			pthread_mutex_lock(&son_mutex);
+			nt[i].creditDebt++;
+			pthread_mutex_unlock(&son_mutex);
+			hello.header.dest_nodeID = nt[i].nodeID;
+			if (egress_sendpkt(nt[i].egress, &hello) < 0) {
+				pthread_mutex_lock(&son_mutex);
+				nt[i].creditDebt--;
+				pthread_mutex_unlock(&son_mutex);
+			}
+		}
+	}
+}
+
+
 void son_stop() 
 {
 	printf("SON: CLOSE SIP_CONN\n");
 	nt_destroy(nt);
+	pktqueue_print(sipq);
+	pktqueue_destroy(sipq);
 	close(sip_conn);
 	close(listenfd);
 	exit(0);
 }
 
 
-int main() 
+int main(int argc, char *argv[]) 
 {
-	
+	//命令行参数tcp/udp选择邻居链路使用的传输协议, uring/threads选择接收报文的方式
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "udp") == 0)
+			linkUDP = 1;
+		else if (strcmp(argv[i], "tcp") == 0)
+			linkUDP = 0;
+		else if (strcmp(argv[i], "uring") == 0)
+			useUring = 1;
+		else if (strcmp(argv[i], "threads") == 0)
+			useUring = 0;
+	}
 
 	//启动重叠网络初始化工作
 	printf("OVERLAY NETWORK: NODE[%d] INITIALIZING...\n", topology_getMyNodeID());	
@@ -208,12 +626,35 @@ int main()
     topology_parseTopoDat();
 
 	//创建一个邻居表
-	nt = nt_create();
+	if ((nt = nt_create()) == NULL && topology_getNbrNum() > 0) {
+		printf("SON: CAN'T RESOLVE NEIGHBOR ADDRESSES\n");
+		exit(1);
+	}
 	//将sip_conn初始化为-1, 即还未与SIP进程连接
 	sip_conn = -1;
+	//创建发往SIP进程的报文帧队列, SIP进程连接后设置它的连接
+	sipq = pktqueue_create(-1, "SIP_CONN");
 	//初始化全局变量访问锁
 	pthread_mutex_init(&son_mutex, NULL);
+	//出口合并缓冲区写出帧后返还信用给SIP进程
+	for (int i = 0; i < topology_getNbrNum(); i++)
+		nt[i].egress->sent = son_returncredit;
 	
+	//创建接收所有邻居链路的io_uring, 内核不支持时每个邻居使用一个listen_to_neighbor线程
+	if (useUring) {
+		if ((ring = uring_create(URING_ENTRIES, URING_BUFS, URING_BUF_SIZE)) != NULL) {
+			streams = (pktstream_t*)calloc(topology_getNbrNum(), sizeof(pktstream_t));
+			pthread_t uring_thread;
+			pthread_create(&uring_thread, NULL, listen_to_neighbors_uring, (void*)0);
+		} else {
+			printf("SON: IO_URING IS NOT AVAILABLE, USE ONE THREAD PER NEIGHBOR\n");
+		}
+	}
+
+	//启动keepalive线程, 它只检查已经建立的邻居链路
+	pthread_t keepalive_thread;
+	pthread_create(&keepalive_thread, NULL, keepalive, (void*)0);
+
 	//注册一个信号句柄, 用于终止进程
 	signal(SIGINT, son_stop);
 	signal(SIGKILL, son_stop);
@@ -225,6 +666,17 @@ int main()
 			i + 1, nt[i].nodeID, nt[i].nodeIP, nt[i].conn);
 	}
 
+	if (linkUDP) {
+		//UDP链路没有连接, 不需要等待其他节点启动
+		if (connectNbrs_udp() < 0) {
+			printf("SON: CAN'T CREATE UDP LINKS\n");
+			exit(1);
+		}
+		printf("OVERLAY NETWORK: NODE[%d] INITIALIZED...\n", topology_getMyNodeID());
+		printf("OVERLAY NETWORK: WAITING FOR CONNECTION FROM SIP PROCESSS...\n");
+		waitSIP();
+	}
+
 	//启动waitNbrs线程, 等待节点ID比自己大的所有邻居的进入连接
 	pthread_t waitNbrs_thread;
 	pthread_create(&waitNbrs_thread, NULL, waitNbrs, (void*)0);
@@ -32,11 +32,25 @@ void* waitNbrs(void* arg);
 int connectNbrs();
 
 
+/**
+ * @brief   这个函数在邻居链路使用UDP时代替waitNbrs()和connectNbrs().
+ *          它为每个邻居创建一个绑定到CONNECTION_PORT并连接到该邻居IP地址的UDP套接字,
+ *          并开始接收每个邻居的报文.
+ *          成功返回1, 否则返回-1.
+ * 
+ * @return int 
+ */
+int connectNbrs_udp();
+
+
 /**
  * @brief   这个函数打开TCP端口SON_PORT, 等待来自本地SIP进程的进入连接. 
  *          在本地SIP进程连接之后, 这个函数持续接收来自SIP进程的sendpkt_arg_t结构, 
  *          并将报文发送到重叠网络中的下一跳. 
  *          如果下一跳的节点ID为BROADCAST_NODEID, 报文应发送到所有邻居节点.
+ *          SIP进程连接后, 这个函数先给SIP进程每个邻居SON_LINK_CREDITS个信用.
+ *          使用io_uring时, SIP连接上的报文也由listen_to_neighbors_uring线程接收,
+ *          这个函数只等待SIP进程断开后的新连接.
  * 
  */
 void waitSIP();
@@ -44,6 +58,9 @@ void waitSIP();
 
 /**
  * @brief   每个listen_to_neighbor线程持续接收来自一个邻居的报文. 它将接收到的报文转发给SIP进程.
+ *          UDP链路上使用recvmmsg()批量接收.
+ *          TCP链路上数据长度不小于SON_SPLICE_MIN的未压缩报文只把首部读入用户空间,
+ *          报文数据经过一个管道用splice()从邻居连接移到SIP连接.
  *          所有的listen_to_neighbor线程都是在到邻居的TCP连接全部建立之后启动的.
  * 
  * @param arg 
@@ -52,6 +69,42 @@ void waitSIP();
 void* listen_to_neighbor(void* arg);
 
 
+/**
+ * @brief   使用io_uring时, 这个线程代替所有的listen_to_neighbor线程.
+ *          每个邻居连接建立后在它上面提交一个多发接收请求, 这个线程每次系统调用收取所有邻居上的一批完成事件,
+ *          从报文缓冲区中取出完整的报文帧, 转发给SIP进程.
+ *          SIP连接上也有一个多发接收请求, SIP进程交来的报文在这个线程中放入下一跳的出口合并缓冲区.
+ *          内核不支持多发接收时, 对应的邻居退回到listen_to_neighbor线程, SIP连接退回到waitSIP().
+ * 
+ * @param arg 
+ * @return void* 
+ */
+void* listen_to_neighbors_uring(void* arg);
+
+
+/**
+ * @brief   这个线程每SON_KEEPALIVE_INTERVAL毫秒向空闲的邻居链路发送一个HELLO报文,
+ *          并检查每个邻居最近一次发来帧的时刻. 邻居在SON_DEAD_INTERVAL毫秒内没有发来任何帧时,
+ *          这个线程关闭到它的链路, 接收这个邻居的线程随后发现链路断开, 向SIP进程发送链路断开报文.
+ *          这样UDP链路上失效的邻居, 以及没有关闭连接就停止响应的邻居也能被发现.
+ *          UDP链路在第一次收到邻居的帧后才开始计时, 还没有启动的邻居不会被认为失效.
+ * 
+ * @param arg 
+ * @return void* 
+ */
+void* keepalive(void* arg);
+
+
+/**
+ * @brief   这个函数由邻居的出口合并缓冲区在写出(或因连接断开而丢弃)frames个帧后调用.
+ *          它通过CREDIT报文把同样数量的发往该邻居的信用返还给SIP进程.
+ * 
+ * @param nbr 
+ * @param frames 
+ */
+void son_returncredit(nbr_entry_t* nbr, int frames);
+
+
 /**
  * @brief   这个函数停止重叠网络, 当接收到信号SIGINT时, 该函数被调用.
  *          它关闭所有的连接, 释放所有动态分配的内存.
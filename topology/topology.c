@@ -16,19 +16,38 @@
 #include "../common/constants.h"
 
 
-// 拓扑节点与IP对应关系
+// 实验环境中拓扑节点与IP的对应关系, 只在用getaddrinfo()不能解析主机名时使用
 const char* TOPO_HOST_IP[TOPO_HOST_NUM][2] = { 
         {"netlab_1", "192.168.163.201"}, 
         {"netlab_2", "192.168.163.202"},
         {"netlab_3", "192.168.163.203"},
         {"netlab_4", "192.168.163.204"},
     };
-int head[MAX_NODE_NUM], node_num, edge_cnt = 0;
-topo_edge_t edges[MAX_NODE_NUM * MAX_NODE_NUM];
+// 邻接表: head[nodeID]是节点的第一条边在edges中的下标, 0表示没有边. 两个数组在解析拓扑文件时按需增长
+int *head = NULL, head_cap = 0, node_num, edge_cnt = 0, edge_cap = 0;
+topo_edge_t* edges = NULL;
+// 节点ID到节点在topology_getNodeArray()中的下标的映射, 大小为head_cap, 不在重叠网络中时为-1
+int* nodeIndex = NULL;
+// 已经解析的节点IP地址, 下标是节点ID, 0表示还没有解析
+in_addr_t* hostIP = NULL;
+int hostIP_cap = 0;
 
 
 void add(int from, int to, int cost)
 {
+    if (from >= head_cap) {
+        int cap = head_cap ? head_cap : 64;
+        while (cap <= from)
+            cap *= 2;
+        head = (int*)realloc(head, sizeof(int) * cap);
+        memset(head + head_cap, 0, sizeof(int) * (cap - head_cap));
+        head_cap = cap;
+    }
+    if (edge_cnt + 1 >= edge_cap) {
+        // 下标0表示没有边, 所以edges[0]不使用
+        edge_cap = edge_cap ? edge_cap * 2 : 64;
+        edges = (topo_edge_t*)realloc(edges, sizeof(topo_edge_t) * edge_cap);
+    }
     edges[++edge_cnt].cost = cost;
     edges[edge_cnt].to = to;
     edges[edge_cnt].next = head[from];
@@ -36,6 +55,18 @@ void add(int from, int to, int cost)
 }
 
 
+// 重新统计有链路的节点数, 并重建节点ID到下标的映射
+static int countnodes()
+{
+    node_num = 0;
+    nodeIndex = (int*)realloc(nodeIndex, sizeof(int) * (head_cap > 0 ? head_cap : 1));
+    for (int i = 0; i < head_cap; i++) {
+        nodeIndex[i] = head[i] > 0 ? node_num++ : -1;
+    }
+    return node_num;
+}
+
+
 int topology_parseName(const char* hostname)
 {
     char hostnameCopy[256];
@@ -59,10 +90,9 @@ int topology_parseTopoDat()
         return -1;
     }
 
-    while (!feof(fp)) {
-        int node[2], linkcost;
-        char host[2][256];
-        fscanf(fp, "%s %s %d", host[0], host[1], &linkcost);
+    int node[2], linkcost;
+    char host[2][256];
+    while (fscanf(fp, "%255s %255s %d", host[0], host[1], &linkcost) == 3) {
         node[0] = topology_parseName(host[0]);
         node[1] = topology_parseName(host[1]);
         if (node[0] > 0 && node[1] > 0) {
@@ -71,11 +101,15 @@ int topology_parseTopoDat()
         }
     }
     fclose(fp);
+    return countnodes();
+}
 
-    for (int i = 0; i < MAX_NODE_NUM; i++) {
-        if (head[i] > 0) node_num++;
-    }
-    return node_num;
+
+void topology_addLink(int fromNodeID, int toNodeID, int cost)
+{
+    add(fromNodeID, toNodeID, cost);
+    add(toNodeID, fromNodeID, cost);
+    countnodes();
 }
 
 
@@ -89,6 +123,46 @@ const char* getIPfromName(const char* hostname)
 }
 
 
+// 解析节点nodeID的主机名netlab_<nodeID>的IPv4地址, 先用getaddrinfo(), 失败时查TOPO_HOST_IP.
+// 成功时把地址写入ip并返回1, 不能解析时返回-1. 解析的结果被缓存
+static int resolvenode(int nodeID, in_addr_t* ip)
+{
+    if (nodeID <= 0)
+        return -1;
+    if (nodeID < hostIP_cap && hostIP[nodeID] != 0) {
+        *ip = hostIP[nodeID];
+        return 1;
+    }
+
+    char hostname[32];
+    struct in_addr addr;
+    struct addrinfo hints, *res;
+    const char* str_addr;
+    snprintf(hostname, sizeof(hostname), "netlab_%d", nodeID);
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(hostname, NULL, &hints, &res) == 0) {
+        addr = ((struct sockaddr_in*)res->ai_addr)->sin_addr;
+        freeaddrinfo(res);
+    } else if ((str_addr = getIPfromName(hostname)) == NULL || inet_aton(str_addr, &addr) == 0) {
+        printf("TOPO ERROR: CAN'T RESOLVE %s\n", hostname);
+        return -1;
+    }
+
+    if (nodeID >= hostIP_cap) {
+        int cap = hostIP_cap ? hostIP_cap : 64;
+        while (cap <= nodeID)
+            cap *= 2;
+        hostIP = (in_addr_t*)realloc(hostIP, sizeof(in_addr_t) * cap);
+        memset(hostIP + hostIP_cap, 0, sizeof(in_addr_t) * (cap - hostIP_cap));
+        hostIP_cap = cap;
+    }
+    *ip = hostIP[nodeID] = addr.s_addr;
+    return 1;
+}
+
+
 int topology_getNodeIDfromName(char* hostname)
 {
     int nodeID;
@@ -100,27 +174,35 @@ int topology_getNodeIDfromName(char* hostname)
 
 int topology_getNodeIDfromIP(struct in_addr* addr)
 {
-    int nodeID;
-    char* str_addr = NULL;
-
-    str_addr = inet_ntoa(*addr);
-    if (str_addr) {
-        for (int i = 0; i < TOPO_HOST_NUM; i++) {
-            if (strcmp(str_addr, TOPO_HOST_IP[i][1]) == 0) {
-                if ((nodeID = topology_parseName(TOPO_HOST_IP[i][0])) > 0)
-                    return nodeID;
-            }
-        }
-    } 
+    in_addr_t ip;
+
+    // 只在拓扑中的节点里查找, 不能解析的节点被跳过
+    for (int i = 0; i < head_cap; i++) {
+        if (head[i] > 0 && resolvenode(i, &ip) > 0 && ip == addr->s_addr)
+            return i;
+    }
     return -1;
 }
 
 
+// 本机的节点ID, 还没有解析时为0
+static int myNodeID = 0;
+
+
+void topology_setMyNodeID(int nodeID)
+{
+    myNodeID = nodeID;
+}
+
+
 int topology_getMyNodeID()
 {
+    // 主机名不会改变, 只在第一次调用时解析
     char hostname[256];
+    if (myNodeID > 0)
+        return myNodeID;
     if (gethostname(hostname, 256) != -1) {
-        return topology_getNodeIDfromName(hostname);
+        return myNodeID = topology_getNodeIDfromName(hostname);
     } else {
         printf("TOPO ERROR: CAN'T GET HOSTNAME\n");
         return -1;
@@ -133,6 +215,8 @@ int topology_getNbrNum()
     int nodeID, nbrNum = 0;
 
     if ((nodeID = topology_getMyNodeID()) > 0) {
+        if (nodeID >= head_cap)
+            return 0;
         for (int e = head[nodeID]; e != 0; e = edges[e].next) {
             nbrNum++;
         }
@@ -153,19 +237,26 @@ int topology_getNodeNum()
 int* topology_getNodeArray()
 {
     int cnt = 0, *nodeArr;
-    nodeArr = (int*)malloc(sizeof(int) * MAX_NODE_NUM);
-    for (int i = 0; i < MAX_NODE_NUM; i++)
+    nodeArr = (int*)malloc(sizeof(int) * (node_num > 0 ? node_num : 1));
+    for (int i = 0; i < head_cap; i++)
         if (head[i] > 0) nodeArr[cnt++] = i;
     return nodeArr;
 }
 
 
+int topology_getNodeIndex(int nodeID)
+{
+    return nodeID >= 0 && nodeID < head_cap ? nodeIndex[nodeID] : -1;
+}
+
+
 int* topology_getNbrArray()
 {
     int nodeID, cnt = 0, *nodeArr;
-    nodeArr = (int*)malloc(sizeof(int) * MAX_NODE_NUM);
+    int nbrNum = topology_getNbrNum();
+    nodeArr = (int*)malloc(sizeof(int) * (nbrNum > 0 ? nbrNum : 1));
     if ((nodeID = topology_getMyNodeID()) > 0) {
-        for (int e = head[nodeID]; e != 0; e = edges[e].next) {
+        for (int e = nbrNum > 0 ? head[nodeID] : 0; e != 0; e = edges[e].next) {
             nodeArr[cnt++] = edges[e].to;
         }
         return nodeArr;
@@ -179,22 +270,21 @@ int* topology_getNbrArray()
 in_addr_t* topology_getNbrIPArray()
 {
     int nodeID, cnt = 0;
-    char nbrName[256] = "netlab_", nbrID[10];
-    struct in_addr ip;
     in_addr_t *nodeArr;
 
-    nodeArr = (in_addr_t*)malloc(sizeof(in_addr_t) * MAX_NODE_NUM);
+    int nbrNum = topology_getNbrNum();
+    nodeArr = (in_addr_t*)malloc(sizeof(in_addr_t) * (nbrNum > 0 ? nbrNum : 1));
     if ((nodeID = topology_getMyNodeID()) > 0) {
-        for (int e = head[nodeID]; e != 0; e = edges[e].next) {
-            nbrName[7] = 0;
-            sprintf(nbrID, "%d", edges[e].to);
-            strcat(nbrName, nbrID);
-            inet_aton(getIPfromName(nbrName), &ip);
-            nodeArr[cnt++] = ip.s_addr;
+        for (int e = nbrNum > 0 ? head[nodeID] : 0; e != 0; e = edges[e].next) {
+            if (resolvenode(edges[e].to, &nodeArr[cnt++]) < 0) {
+                free(nodeArr);
+                return NULL;
+            }
         }
         return nodeArr;
     } else {
         printf("TOPO ERROR: NODEID IS INVALID\n");
+        free(nodeArr);
         return NULL;
     }
 }
@@ -202,6 +292,8 @@ in_addr_t* topology_getNbrIPArray()
 
 unsigned int topology_getCost(int fromNodeID, int toNodeID)
 {
+    if (fromNodeID < 0 || fromNodeID >= head_cap)
+        return INFINITE_COST;
     for (int e = head[fromNodeID]; e != 0; e = edges[e].next) {
         if (edges[e].to == toNodeID)
             return edges[e].cost;
@@ -30,7 +30,7 @@ int topology_getNodeIDfromName(char* hostname);
 
 
 /**
- * @brief   这个函数返回指定的IP地址的节点ID.
+ * @brief   这个函数返回指定的IP地址的节点ID. 它在拓扑中的节点里查找主机名解析为这个地址的节点.
  *          如果不能获取节点ID, 返回-1.
  * 
  * @param addr 
@@ -48,6 +48,15 @@ int topology_getNodeIDfromIP(struct in_addr* addr);
 int topology_getMyNodeID();
 
 
+/**
+ * @brief   这个函数设置本机的节点ID, 之后topology_getMyNodeID()返回nodeID而不再解析主机名.
+ *          用于在一个进程中模拟多个节点(例如基准测试).
+ * 
+ * @param nodeID 
+ */
+void topology_setMyNodeID(int nodeID);
+
+
 /**
  * @brief   这个函数解析保存在文件topology.dat中的拓扑信息.
  *          返回邻居数.
@@ -75,6 +84,18 @@ int topology_getNodeNum();
 int* topology_getNodeArray(); 
 
 
+/**
+ * @brief   这个函数返回节点nodeID在topology_getNodeArray()返回的数组中的下标.
+ *          节点数组按节点ID从小到大排列, 所以所有节点得到相同的下标, 下标从0到节点数-1.
+ *          路由, 组播和暂存报文的各种表都用它把节点ID转换为稠密的下标, 查找是O(1)的.
+ *          节点不在重叠网络中时返回-1.
+ * 
+ * @param nodeID 
+ * @return int 
+ */
+int topology_getNodeIndex(int nodeID);
+
+
 /**
  * @brief   这个函数解析保存在文件topology.dat中的拓扑信息.
  *          返回一个动态分配的数组, 它包含所有邻居的节点ID.
@@ -88,6 +109,8 @@ int* topology_getNbrArray();
 /**
  * @brief   这个函数解析保存在文件topology.dat中的拓扑信息.
  *          返回一个动态分配的数组, 它包含所有邻居的节点IP.
+ *          节点netlab_<节点ID>的地址先用getaddrinfo()解析, 失败时查实验环境的地址表.
+ *          有邻居的地址不能解析时返回NULL.
  * 
  * @return in_addr_t* 
  */  
@@ -107,4 +130,15 @@ unsigned int topology_getCost(int fromNodeID, int toNodeID);
 int topology_parseTopoDat();
 int topology_parseName(const char* hostname);
 void add(int from, int to, int cost);
+
+
+/**
+ * @brief   这个函数在拓扑中加入两个节点之间的一条双向链路, 
+ *          用于不读取topology.dat而直接构造拓扑(例如基准测试).
+ * 
+ * @param fromNodeID 
+ * @param toNodeID 
+ * @param cost 
+ */
+void topology_addLink(int fromNodeID, int toNodeID, int cost);
 #endif
\ No newline at end of file